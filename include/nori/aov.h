@@ -0,0 +1,121 @@
+#pragma once
+
+#include <nori/bitmap.h>
+
+NORI_NAMESPACE_BEGIN
+
+struct Intersection;
+
+/**
+ * \brief Auxiliary output variables (AOVs) of a camera ray
+ *
+ * All values refer to the first surface that the ray hits, and keep
+ * their defaults when the ray escapes.
+ */
+struct AOVRecord {
+    /// Estimate of the surface's albedo (the weight of a BSDF sample)
+    Color3f albedo = Color3f(0.f);
+
+    /// Shading normal
+    Normal3f normal = Normal3f(0.f);
+
+    /// Distance along the ray
+    float depth = 0.f;
+
+    /// Index of the mesh in the order of the scene file (-1: no surface)
+    int meshId = -1;
+
+    /// Index of the triangle within its mesh (-1: no surface)
+    int primitiveId = -1;
+
+    /// Record the position of the surface hit by a camera ray, but not the albedo
+    void setSurface(const Ray3f &ray, const Intersection &its);
+
+    /**
+     * \brief Intersect a camera ray with the scene and record all AOVs
+     *
+     * \param sample  A uniformly distributed sample on \f$[0,1]^2\f$ for
+     *                the BSDF sample that estimates the albedo
+     */
+    void trace(const Scene *scene, const Ray3f &ray, const Point2f &sample);
+};
+
+/// AOVs that are accumulated in the film with the reconstruction filter of the image
+enum EFilteredAOV {
+    EAlbedoAOV = 0,
+    /// Stored as <tt>(n + 1) / 2</tt>, since the film only accepts non-negative values
+    ENormalAOV,
+    /// Stored in the first channel
+    EDepthAOV,
+    EFilteredAOVCount
+};
+
+/**
+ * \brief Per-pixel mesh and triangle IDs
+ *
+ * Averaging the IDs of different surfaces is meaningless, hence every
+ * pixel keeps the IDs of its first sample. Different pixels can be
+ * updated concurrently.
+ */
+class PixelIDs {
+public:
+    /// Allocate the IDs for an image of the specified size (all -1)
+    void init(const Vector2i &size);
+
+    /// Record the IDs of the first sample of a pixel
+    void put(const Point2i &pixel, const AOVRecord &aov) {
+        size_t i = index(pixel);
+        m_meshIds[i] = aov.meshId;
+        m_primitiveIds[i] = aov.primitiveId;
+    }
+
+    int getMeshId(const Point2i &pixel) const { return m_meshIds[index(pixel)]; }
+    int getPrimitiveId(const Point2i &pixel) const { return m_primitiveIds[index(pixel)]; }
+
+    /// Return the size of the image
+    const Vector2i &getSize() const { return m_size; }
+
+protected:
+    size_t index(const Point2i &pixel) const {
+        return (size_t) pixel.y() * m_size.x() + pixel.x();
+    }
+
+    Vector2i m_size = Vector2i(0, 0);
+    std::vector<int> m_meshIds;
+    std::vector<int> m_primitiveIds;
+};
+
+/// Film buffers that receive the AOVs of a tile in \ref renderBlock()
+struct AOVBlocks {
+    ImageBlock *filtered[EFilteredAOVCount];
+    PixelIDs *ids;
+};
+
+/**
+ * \brief Developed AOV images, which are written next to the image
+ * into a multi-layer OpenEXR file
+ *
+ * Single-valued AOVs are stored in the first channel of their bitmap.
+ */
+struct AOVImages {
+    Bitmap albedo, normal, depth;
+
+    /// Mesh ID (first channel) and triangle ID (second channel)
+    Bitmap ids;
+
+    /// Number of samples per pixel
+    Bitmap sampleCount;
+
+    /// Variance of the pixel estimates (of the luminance, i.e. divided by the sample count)
+    Bitmap variance;
+
+    /**
+     * \brief Write the image and the AOVs as one OpenEXR file
+     *
+     * The layers are \c albedo.RGB, \c normal.XYZ, \c depth.Z, \c id.mesh,
+     * \c id.primitive, \c sampleCount.Y and \c variance.Y.
+     */
+    void save(Bitmap &image, const std::string &filename) const;
+};
+
+NORI_NAMESPACE_END
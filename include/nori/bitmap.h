@@ -23,6 +23,18 @@
 
 NORI_NAMESPACE_BEGIN
 
+/**
+ * \brief Additional layer of a multi-layer OpenEXR file
+ *
+ * The channels <tt>name.channels[i]</tt> are taken from the components
+ * of \c bitmap in order (at most three).
+ */
+struct BitmapLayer {
+    std::string name;
+    const Bitmap *bitmap;
+    std::vector<std::string> channels;
+};
+
 /**
  * \brief Stores a RGB high dynamic-range bitmap
  *
@@ -44,9 +56,23 @@ public:
     /// Load an OpenEXR file with the specified filename
     Bitmap(const std::string &filename);
 
+    /**
+     * \brief Load specific channels of an OpenEXR file (e.g. of one layer)
+     *
+     * The channels are stored in the components of the bitmap in order.
+     * A single channel is replicated into all three components.
+     */
+    Bitmap(const std::string &filename, const std::vector<std::string> &channels);
+
     /// Save the bitmap as an EXR file with the specified filename
     void save(const std::string &filename);
 
+    /**
+     * \brief Save the bitmap as the R, G, B channels of a multi-layer EXR
+     * file, together with additional layers of the same resolution
+     */
+    void save(const std::string &filename, const std::vector<BitmapLayer> &layers);
+
     /// Save the bitmap as a PNG file with the specified filename
     void saveToLDR(const std::string &filename);
 };
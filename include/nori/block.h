@@ -24,12 +24,22 @@
 
 #include <nori/color.h>
 #include <nori/vector.h>
+#include <nori/bbox.h>
 #include <tbb/mutex.h>
+#include <memory>
+#include <atomic>
 
 #define NORI_BLOCK_SIZE 32 /* Block size used for parallelization */
 
 NORI_NAMESPACE_BEGIN
 
+/// Lock-free addition to an atomic float
+inline void atomicAdd(std::atomic<float> &target, float value) {
+    float current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+        ;
+}
+
 /**
  * \brief Weighted pixel storage for a rectangular subregion of an image
  *
@@ -46,6 +56,8 @@ NORI_NAMESPACE_BEGIN
  */
 class ImageBlock : public Eigen::Array<Color4f, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> {
 public:
+    typedef Eigen::Array<Color4f, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Base;
+
     /**
      * Create a new image block of the specified maximum size
      * \param size
@@ -96,6 +108,23 @@ public:
     /// Record a sample with the given position and radiance value
     void put(const Point2f &pos, const Color3f &value);
 
+    /**
+     * \brief Record a sample that only contributes to a single pixel
+     *
+     * This is used with filter importance sampling, where the sample
+     * position was drawn from the reconstruction filter of \c pixel
+     * (given in image coordinates) and \c weight is the associated
+     * filter weight. No reconstruction filter or border is needed.
+     */
+    void putPixel(const Point2i &pixel, const Color3f &value, float weight) {
+        if (!value.isValid()) {
+            cerr << "Integrator: computed an invalid radiance value: " << value.toString() << endl;
+            return;
+        }
+        coeffRef(pixel.y() - m_offset.y() + m_borderSize, pixel.x() - m_offset.x() + m_borderSize)
+            += Color4f(value) * weight;
+    }
+
     /**
      * \brief Merge another image block into this one
      *
@@ -125,6 +154,238 @@ protected:
     mutable tbb::mutex m_mutex;
 };
 
+/**
+ * \brief Film that is accumulated in independently owned tiles
+ *
+ * Every tile of the image accumulates its samples in a private image
+ * block that includes the border region covered by the reconstruction
+ * filter. A tile is only ever rendered by one worker at a time, so
+ * accumulation requires neither locks nor atomic operations, and the
+ * overlapping borders are only resolved when the full image is assembled.
+ *
+ * For display purposes, the worker that owns a tile periodically
+ * publishes a copy of it using \ref commitTile(), and \ref develop()
+ * assembles the full image from these published copies. Tiles are always
+ * summed in the same order, so the result does not depend on scheduling.
+ * The film keeps track of the tiles committed since the last display
+ * update, so that only the affected parts of the image need to be
+ * assembled again.
+ */
+class TiledFilm {
+public:
+    /// Split an image of the specified size into tiles
+    void init(const Vector2i &size, const ReconstructionFilter *filter, int tileSize) {
+        init(Point2i(0, 0), size, filter, tileSize);
+    }
+
+    /**
+     * \brief Split a rectangular part of an image (e.g. a crop window) into tiles
+     *
+     * The tiles match the blocks of a \ref BlockGenerator for the same region.
+     */
+    void init(const Point2i &offset, const Vector2i &size,
+              const ReconstructionFilter *filter, int tileSize);
+
+    /// Return the number of tiles
+    uint32_t getTileCount() const { return (uint32_t) m_tiles.size(); }
+
+    /**
+     * \brief Return the accumulation buffer of a tile
+     *
+     * The tile IDs match the block IDs assigned by \ref BlockGenerator.
+     * Only the worker currently rendering the tile may access it.
+     */
+    ImageBlock &getTile(uint32_t id) { return m_tiles[id]->accum; }
+
+    /// Publish the current contents of a tile for \ref develop()
+    void commitTile(uint32_t id);
+
+    /**
+     * \brief Reallocate the buffers of a tile from the calling thread
+     *
+     * With the usual first-touch policy of the operating system, the
+     * memory of the tile then resides on the NUMA node of the calling
+     * thread. Only the worker currently rendering the tile may call this.
+     */
+    void localizeTile(uint32_t id);
+
+    /**
+     * \brief Assemble the published tiles into a full-size image block
+     *
+     * \c target must have been initialized with the size and
+     * reconstruction filter of this film.
+     */
+    void develop(ImageBlock &target) const;
+
+    /**
+     * \brief Assemble the published tiles into a rectangular part of a
+     * full-size image block
+     *
+     * The pixels in <tt>[region.min, region.max)</tt> (in image
+     * coordinates) are recomputed, all other pixels are left untouched.
+     */
+    void develop(ImageBlock &target, const BoundingBox2i &region) const;
+
+    /// Append the IDs of all tiles committed since the last call to \c ids
+    void takeDirtyTiles(std::vector<uint32_t> &ids);
+
+    /**
+     * \brief Return the pixels <tt>[min, max)</tt> that a tile contributes to
+     *
+     * This includes the border region covered by the reconstruction filter,
+     * clipped to an image of the given size.
+     */
+    BoundingBox2i getTileFootprint(uint32_t id, const Vector2i &imageSize) const;
+
+    /// Write the published contents of a tile to a binary stream
+    void writeTile(uint32_t id, std::ostream &stream) const;
+
+    /// Restore the contents of a tile (accumulated and published) from a binary stream
+    void readTile(uint32_t id, std::istream &stream);
+
+protected:
+    struct Tile {
+        Tile(const Vector2i &size, const ReconstructionFilter *filter)
+            : accum(size, filter), published(size, filter), dirty(false) { }
+
+        ImageBlock accum;
+        ImageBlock published;
+        std::atomic<bool> dirty;
+    };
+
+    std::vector<std::unique_ptr<Tile>> m_tiles;
+    Point2i m_offset = Point2i(0, 0);
+    Vector2i m_numTiles = Vector2i(0, 0);
+    int m_tileSize = 0;
+    int m_borderSize = 0;
+};
+
+/**
+ * \brief Film for contributions that can land on any pixel of the image
+ *
+ * Light tracing connects paths to the camera, hence a sample that is
+ * rendered for one tile can contribute to an arbitrary pixel. Such splats
+ * are accumulated with lock-free atomic additions (and without a
+ * reconstruction filter) into a separate full-size image, which is added
+ * to the image assembled from the \ref TiledFilm for display and output.
+ */
+class SplatFilm {
+public:
+    /// Allocate a cleared film for an image of the specified size
+    void init(const Vector2i &size);
+
+    /// Record a splat at the given position (in fractional pixel coordinates)
+    void splat(const Point2f &pos, const Color3f &value) {
+        if (!value.isValid()) {
+            cerr << "Integrator: computed an invalid splat value: " << value.toString() << endl;
+            return;
+        }
+        int x = (int) pos.x(), y = (int) pos.y();
+        if (pos.x() < 0 || pos.y() < 0 || x >= m_size.x() || y >= m_size.y())
+            return;
+        std::atomic<float> *pixel = &m_data[3 * ((size_t) y * m_size.x() + x)];
+        for (int c = 0; c < 3; ++c)
+            atomicAdd(pixel[c], value[c]);
+    }
+
+    /**
+     * \brief Add the splats times \c scale to the pixels of a full-size image block
+     *
+     * The splats are weighted by the filter weights of the pixels, so that
+     * they are added to the normalized pixel values. Pixels without any
+     * weight (e.g. outside of the crop window) are left untouched.
+     */
+    void develop(ImageBlock &target, float scale) const;
+
+    /// Return the size of the image
+    const Vector2i &getSize() const { return m_size; }
+protected:
+    Vector2i m_size = Vector2i(0, 0);
+    std::unique_ptr<std::atomic<float>[]> m_data;
+};
+
+/**
+ * \brief Per-pixel sample statistics used for adaptive sampling
+ *
+ * Keeps track of the running mean and variance of the luminance of the
+ * samples taken in each pixel (using Welford's algorithm) and of the
+ * set of pixels that have not yet converged. Different pixels can be
+ * updated concurrently, which is the case when every image block only
+ * records statistics for its own pixels.
+ */
+class PixelStatistics {
+public:
+    /// Allocate statistics for an image of the specified size and mark all pixels active
+    void init(const Vector2i &size);
+
+    /// Record the luminance of a sample taken in the given pixel
+    void put(const Point2i &pixel, float value) {
+        size_t i = index(pixel);
+        uint32_t n = ++m_count[i];
+        float delta = value - m_mean[i];
+        m_mean[i] += delta / n;
+        m_m2[i] += delta * (value - m_mean[i]);
+    }
+
+    /// Does the given pixel still need more samples?
+    bool isActive(const Point2i &pixel) const { return m_active[index(pixel)] != 0; }
+
+    /// Return the number of samples taken in the given pixel
+    uint32_t getSampleCount(const Point2i &pixel) const { return m_count[index(pixel)]; }
+
+    /// Return the mean luminance of the given pixel
+    float getMean(const Point2i &pixel) const { return m_mean[index(pixel)]; }
+
+    /// Return the sample variance of the luminance of the given pixel
+    float getVariance(const Point2i &pixel) const {
+        size_t i = index(pixel);
+        return m_count[i] > 1 ? m_m2[i] / (m_count[i] - 1) : 0.f;
+    }
+
+    /**
+     * \brief Return the relative standard error of the given pixel's mean
+     *
+     * The denominator is clamped from below so that noise in almost black
+     * pixels does not prevent them from ever converging.
+     */
+    float getRelativeError(const Point2i &pixel) const {
+        size_t i = index(pixel);
+        if (m_count[i] < 2)
+            return std::numeric_limits<float>::infinity();
+        return std::sqrt(getVariance(pixel) / m_count[i]) / std::max(m_mean[i], 1e-2f);
+    }
+
+    /**
+     * \brief Deactivate the pixels of a rectangular region whose
+     * relative error is below \c threshold
+     *
+     * \param errorSum
+     *     Returns the sum of the relative errors of all pixels in the region
+     * \return
+     *     The number of pixels in the region that remain active
+     */
+    size_t update(const Point2i &offset, const Vector2i &size, float threshold, float &errorSum);
+
+    /// Write the statistics of a rectangular region to a binary stream
+    void serialize(const Point2i &offset, const Vector2i &size, std::ostream &stream) const;
+
+    /// Restore the statistics of a rectangular region from a binary stream
+    void unserialize(const Point2i &offset, const Vector2i &size, std::istream &stream);
+
+    /// Return the size of the image
+    const Vector2i &getSize() const { return m_size; }
+protected:
+    size_t index(const Point2i &pixel) const {
+        return (size_t) pixel.y() * m_size.x() + pixel.x();
+    }
+
+    Vector2i m_size = Vector2i(0, 0);
+    std::vector<uint32_t> m_count;
+    std::vector<float> m_mean;
+    std::vector<float> m_m2;
+    std::vector<uint8_t> m_active;
+};
+
 /**
  * \brief Spiraling block generator
  *
@@ -143,6 +404,18 @@ public:
      *      Maximum size of the individual blocks
      */
     BlockGenerator(const Vector2i &size, int blockSize);
+
+    /**
+     * \brief Create a block generator that only covers a rectangular
+     * part of the image (e.g. a crop window)
+     * \param offset
+     *      Upper left corner of the region
+     * \param size
+     *      Size of the region
+     * \param blockSize
+     *      Maximum size of the individual blocks
+     */
+    BlockGenerator(const Point2i &offset, const Vector2i &size, int blockSize);
     
     /**
      * \brief Return the next block to be rendered
@@ -167,6 +440,7 @@ protected:
 
     Point2i m_block;
     Vector2i m_numBlocks;
+    Point2i m_offset;
     Vector2i m_size;
     int m_blockSize;
     int m_numSteps;
@@ -22,6 +22,28 @@
 
 NORI_NAMESPACE_BEGIN
 
+/**
+ * \brief Data record for sampling a direction from a reference point
+ * towards the camera (e.g. to connect light paths to the camera)
+ */
+struct CameraQueryRecord {
+    /// Reference point from which the camera is sampled
+    Point3f ref;
+    /// Sampled position on the aperture of the camera
+    Point3f p;
+    /// Direction vector from 'ref' to 'p'
+    Vector3f wi;
+    /// Distance between 'ref' and 'p'
+    float dist;
+    /// Solid angle density of the sample wrt. 'ref'
+    float pdf;
+    /// Position on the film (in fractional pixel coordinates) that receives the sample
+    Point2f pixel;
+
+    /// Create a new query record that can be used to sample the camera
+    CameraQueryRecord(const Point3f &ref) : ref(ref) { }
+};
+
 /**
  * \brief Generic camera interface
  * 
@@ -48,6 +70,10 @@ public:
      *    A uniformly distributed 2D vector that is used to sample
      *    a position on the aperture of the sensor if necessary.
      *
+     * \param time
+     *    Time of the ray in [0, 1] (a sample of the shutter interval),
+     *    which is stored in the ray and used by animated cameras
+     *
      * \return
      *    An importance weight associated with the sampled ray.
      *    This accounts for the difference in the camera response
@@ -55,11 +81,85 @@ public:
      */
     virtual Color3f sampleRay(Ray3f &ray,
         const Point2f &samplePosition,
-        const Point2f &apertureSample) const = 0;
+        const Point2f &apertureSample,
+        float time) const = 0;
+
+    /**
+     * \brief Sample a position on the aperture that is visible from a
+     * reference point, and return the importance weight of the connection
+     *
+     * This is the adjoint of \ref sampleRay() that is needed to connect
+     * light paths to the camera.
+     *
+     * \param cRec
+     *    A camera query record (only \c ref is needed)
+     * \param sample
+     *    A uniformly distributed sample on \f$[0,1]^2\f$ (aperture)
+     *
+     * \return
+     *    The importance of the ray from \c cRec.p towards \c cRec.ref
+     *    divided by \c cRec.pdf. A zero value means that the reference
+     *    point is not seen by the camera.
+     */
+    virtual Color3f sampleDirection(CameraQueryRecord &cRec, const Point2f &sample) const {
+        throw NoriException("Camera::sampleDirection(): not supported by %s", toString());
+    }
+
+    /**
+     * \brief Compute the densities with which \ref sampleRay() generates a ray
+     *
+     * \param ray
+     *    A ray leaving the aperture of the camera
+     * \param pdfPos
+     *    Returns the density of the ray origin per unit area of the
+     *    aperture (1 for a pinhole camera)
+     * \param pdfDir
+     *    Returns the density of the ray direction per unit solid angle
+     *    (both are zero when the ray does not hit the film)
+     */
+    virtual void pdf(const Ray3f &ray, float &pdfPos, float &pdfDir) const {
+        throw NoriException("Camera::pdf(): not supported by %s", toString());
+    }
 
     /// Return the size of the output image in pixels
     const Vector2i &getOutputSize() const { return m_outputSize; }
 
+    /**
+     * \brief Change the size of the output image
+     *
+     * This re-runs \ref activate() so that derived quantities
+     * (e.g. the sample-to-camera transformation) are kept up to date.
+     */
+    void setOutputSize(const Vector2i &size) {
+        m_outputSize = size;
+        activate();
+    }
+
+    /**
+     * \brief Restrict rendering to a rectangular part of the output image
+     *
+     * A size with non-positive components selects the entire image.
+     */
+    void setCropWindow(const Point2i &offset, const Vector2i &size) {
+        m_cropOffset = offset;
+        m_cropSize = size;
+    }
+
+    /// Return the upper left corner of the crop window (clamped to the output image)
+    Point2i getCropOffset() const {
+        if (m_cropSize.x() <= 0 || m_cropSize.y() <= 0)
+            return Point2i(0, 0);
+        return Point2i(m_cropOffset.cwiseMax(0).cwiseMin(m_outputSize - Vector2i(1, 1)));
+    }
+
+    /// Return the size of the crop window (clamped to the output image)
+    Vector2i getCropSize() const {
+        if (m_cropSize.x() <= 0 || m_cropSize.y() <= 0)
+            return m_outputSize;
+        Point2i offset = getCropOffset();
+        return Vector2i(m_cropSize.cwiseMin(m_outputSize - offset));
+    }
+
     /// Return the camera's reconstruction filter in image space
     const ReconstructionFilter *getReconstructionFilter() const { return m_rfilter; }
 
@@ -69,7 +169,15 @@ public:
      * */
     virtual EClassType getClassType() const { return ECamera; }
 protected:
+    /// Read the optional crop window properties (cropX, cropY, cropWidth, cropHeight)
+    void loadCropWindow(const PropertyList &propList) {
+        m_cropOffset = Point2i(propList.getInteger("cropX", 0), propList.getInteger("cropY", 0));
+        m_cropSize = Vector2i(propList.getInteger("cropWidth", 0), propList.getInteger("cropHeight", 0));
+    }
+
     Vector2i m_outputSize;
+    Point2i m_cropOffset = Point2i(0, 0);
+    Vector2i m_cropSize = Vector2i(0, 0);
     ReconstructionFilter *m_rfilter;
 };
 
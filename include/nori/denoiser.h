@@ -0,0 +1,60 @@
+#pragma once
+
+#include <nori/bitmap.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Auxiliary buffers that guide the denoiser
+ *
+ * All buffers are optional, but must have the resolution of the image
+ * when given. Without a buffer, the corresponding edge-stopping term is
+ * disabled (the variance is then estimated from the image itself).
+ */
+struct DenoiserFeatures {
+    /// Reflectance of the first surface; the filter operates on the image divided by it
+    const Bitmap *albedo = nullptr;
+
+    /// Shading normal of the first surface (zero where nothing was hit)
+    const Bitmap *normal = nullptr;
+
+    /// Distance to the first surface (first channel)
+    const Bitmap *depth = nullptr;
+
+    /// Variance of the pixel estimates (luminance of each pixel)
+    const Bitmap *variance = nullptr;
+};
+
+/// Parameters of \ref denoise()
+struct DenoiserOptions {
+    /// Number of à-trous iterations, the filter footprint is 4 * 2^iterations pixels wide
+    int iterations = 5;
+
+    /// Luminance edge-stopping: allowed difference in standard deviations
+    float sigmaColor = 4.f;
+
+    /// Normal edge-stopping: weight exp(-sigmaNormal * (1 - cos))
+    float sigmaNormal = 64.f;
+
+    /// Depth edge-stopping: allowed difference relative to the local depth gradient
+    float sigmaDepth = 1.f;
+};
+
+/**
+ * \brief Edge-aware à-trous wavelet denoiser guided by feature buffers
+ *
+ * Implements the filter of Dammertz et al. 2010 with the variance-guided
+ * luminance weights of Schied et al. 2017 ("Spatiotemporal Variance-Guided
+ * Filtering"). Every iteration applies a 5x5 B3-spline kernel with holes
+ * of 2^i pixels, whose taps are weighted by the similarity of normals,
+ * depths and luminances, where the allowed luminance difference follows
+ * the filtered per-pixel variance. When an albedo buffer is given, the
+ * illumination (image / albedo) is filtered and textures remain sharp.
+ *
+ * The image is processed in tiles in parallel; within a tile, whole row
+ * segments are filtered at once with vectorized array operations.
+ */
+extern Bitmap denoise(const Bitmap &image, const DenoiserFeatures &features,
+                      const DenoiserOptions &options = DenoiserOptions());
+
+NORI_NAMESPACE_END
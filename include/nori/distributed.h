@@ -0,0 +1,85 @@
+#pragma once
+
+#include <nori/render.h>
+#include <nori/socket.h>
+#include <tbb/concurrent_queue.h>
+#include <memory>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Distributes the tiles of an image over several worker processes
+ *
+ * The coordinator loads the scene, listens for workers (see
+ * \ref runRenderWorker()) and hands out one tile at a time. Workers
+ * render all samples of a tile and stream the accumulated image block
+ * back, where it is stored in the tile's region of a \ref TiledFilm.
+ * Since every tile is rendered exactly as by the local renderer, the
+ * result does not depend on the number of workers. Tiles of workers that
+ * disconnect are handed out again.
+ *
+ * All processes must be able to open the scene file under the same path.
+ */
+class RenderCoordinator {
+public:
+    /// Load a scene and start listening for workers on the given port (0: any free port)
+    RenderCoordinator(const std::string &filename, const RenderOptions &options, int port);
+
+    /// Terminate all remaining workers
+    ~RenderCoordinator();
+
+    /// Return the port on which workers can connect
+    int getPort() const { return m_listener.getPort(); }
+
+    /**
+     * \brief Launch worker processes on this machine
+     *
+     * \param executable
+     *     Renderer executable which accepts the <tt>--worker</tt>
+     *     and <tt>--threads</tt> arguments
+     * \param count
+     *     Number of worker processes
+     * \param threadCount
+     *     Number of threads per worker process
+     */
+    void spawnWorkers(const std::string &executable, int count, int threadCount);
+
+    /// Hand out tiles until the image is complete and then save it
+    void run();
+
+protected:
+    /// Location of a tile within the image
+    struct TileInfo {
+        uint32_t id;
+        Point2i offset;
+        Vector2i size;
+    };
+
+    /// Serve a connected worker until all tiles are done (runs on its own thread)
+    void serveWorker(Socket socket);
+
+    /// Have all worker processes launched by \ref spawnWorkers() exited?
+    bool spawnedWorkersExited();
+
+    std::unique_ptr<Scene> m_scene;
+    const ReconstructionFilter *m_splatFilter = nullptr;
+    std::string m_outputName;
+    std::string m_config;
+    Socket m_listener;
+    TiledFilm m_film;
+    std::vector<TileInfo> m_tiles;
+    tbb::concurrent_queue<uint32_t> m_queue;
+    std::atomic<size_t> m_tilesLeft;
+    std::atomic<int> m_connections;
+    std::vector<int> m_processes;
+};
+
+/**
+ * \brief Connect to a \ref RenderCoordinator and render the tiles it
+ * hands out until the image is complete
+ *
+ * Every thread of the worker uses its own connection.
+ */
+extern void runRenderWorker(const std::string &host, int port, int threadCount);
+
+NORI_NAMESPACE_END
@@ -22,6 +22,8 @@
 
 NORI_NAMESPACE_BEGIN
 
+struct LightBounds;
+
 /**
  * \brief Data record for conveniently querying and sampling the
  * direct illumination technique implemented by a emitter
@@ -115,15 +117,60 @@ public:
      *     The emitter value, evaluated for each color channel
      */
     virtual Color3f eval(const EmitterQueryRecord &lRec) const = 0;
+
+    /**
+     * \brief Return an estimate of the total power emitted by the emitter
+     *
+     * Environment emitters have no finite area and instead return their
+     * radiance integrated over the sphere of directions, which the scene
+     * scales by the cross section of its bounding sphere.
+     */
+    virtual Color3f power() const = 0;
     
     /// Is this an environment emitter?
     virtual bool isEnvironmentEmitter() const { return false; }
 
-    /// Sample a photon
-    virtual Color3f samplePhoton(Ray3f &ray, const Point2f &sample1, const Point2f &sample2) const {
+    /**
+     * \brief Compute conservative bounds of the emitted light for the
+     * light hierarchy (see \ref LightBVH)
+     *
+     * \return \c false if the emission cannot be bounded spatially
+     *     (e.g. environment emitters), which is the default
+     */
+    virtual bool getLightBounds(LightBounds &bounds) const { return false; }
+
+    /// Is the emitter located at a single point (e.g. a point light)?
+    virtual bool isPointEmitter() const { return false; }
+
+    /**
+     * \brief Sample a photon leaving the emitter
+     *
+     * \param ray      Returns the photon ray
+     * \param n        Returns the surface normal at the origin of the ray
+     *                 (zero for emitters without a surface)
+     * \param sample1  A uniformly distributed sample on \f$[0,1]^2\f$ (position)
+     * \param sample2  A uniformly distributed sample on \f$[0,1]^2\f$ (direction)
+     *
+     * \return The emitted radiance times the cosine at the origin, divided
+     *     by the densities of the origin and the direction (see \ref pdfPhoton())
+     */
+    virtual Color3f samplePhoton(Ray3f &ray, Normal3f &n, const Point2f &sample1,
+                                 const Point2f &sample2) const {
         throw NoriException("Emitter::samplePhoton(): not implemented!");
     }
 
+    /**
+     * \brief Compute the densities with which \ref samplePhoton() generates
+     * a photon leaving \c lRec.p in direction \c -lRec.wi
+     *
+     * \param lRec    A record as passed to \ref eval()
+     * \param pdfPos  Returns the density of the origin (per unit area, 1 for point emitters)
+     * \param pdfDir  Returns the density of the direction (per unit solid angle)
+     */
+    virtual void pdfPhoton(const EmitterQueryRecord &lRec, float &pdfPos, float &pdfDir) const {
+        throw NoriException("Emitter::pdfPhoton(): not implemented!");
+    }
+
 
     /**
      * \brief Virtual destructor
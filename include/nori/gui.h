@@ -21,6 +21,7 @@
 #include <nori/common.h>
 #include <nanogui/screen.h>
 #include <nori/render.h>
+#include <nori/timer.h>
 
 NORI_NAMESPACE_BEGIN
 
@@ -31,21 +32,41 @@ public:
 
     virtual void drawContents();
 
+    virtual void draw(NVGcontext *ctx);
+
     virtual bool keyboardEvent(int key, int scancode, int action, int modifiers);
     virtual bool dropEvent(const std::vector<std::string> &filenames);
 
+    /// Drag with the left mouse button to select a crop window and render only that part
+    virtual bool mouseButtonEvent(const Eigen::Vector2i &p, int button, bool down, int modifiers);
+    virtual bool mouseMotionEvent(const Eigen::Vector2i &p, const Eigen::Vector2i &rel, int button, int modifiers);
+
     void openXML(const std::string & filename);
     void openEXR(const std::string & filename);
 
 private:
+    /// Restart rendering the current scene with the current options
+    void restartRendering();
+
+    /// Convert a window position into pixel coordinates of the image (clamped)
+    Vector2i toImagePosition(const Eigen::Vector2i &p) const;
+
     ImageBlock &m_block;
     nanogui::GLShader *m_shader = nullptr;
     nanogui::Slider *m_slider = nullptr;
     nanogui::ProgressBar *m_progressBar = nullptr;
     uint32_t m_texture = 0;
+    Vector2i m_textureSize = Vector2i(0, 0);
+    std::vector<BoundingBox2i> m_dirtyRegions;
+    Timer m_uploadTimer;
     float m_scale = 1.f;
     Widget *panel = nullptr;
 
+    std::string m_filename;
+    RenderOptions m_options;
+    bool m_dragging = false;
+    Vector2i m_dragStart, m_dragEnd;
+
     RenderThread m_renderThread;
 };
 
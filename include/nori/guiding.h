@@ -0,0 +1,144 @@
+#pragma once
+
+#include <nori/bbox.h>
+#include <atomic>
+#include <memory>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Adaptive quadtree over the sphere of directions (a "D-tree")
+ *
+ * Directions are mapped to the unit square by the area-preserving
+ * cylindrical mapping <tt>(cos(theta), phi)</tt>. Every node splits its
+ * square into four quadrants and stores the energy recorded in each of
+ * them, hence the tree is sampled by descending from the root and
+ * choosing every quadrant proportionally to its energy.
+ *
+ * Recording is lock-free (atomic adds), and may run concurrently with
+ * sampling and other recordings. Changing the structure (\ref build())
+ * is not thread-safe.
+ */
+class DTree {
+public:
+    /// Create a tree with a single node and no energy
+    DTree();
+
+    /// Add the energy \c value to all nodes along the direction \c d
+    void record(const Vector3f &d, float value);
+
+    /// Return the solid angle density of sampling the direction \c d
+    float pdf(const Vector3f &d) const;
+
+    /// Sample a direction proportionally to the energy of the tree
+    Vector3f sample(Point2f sample) const;
+
+    /// Return the total energy that was recorded
+    float getTotal() const;
+
+    /**
+     * \brief Replace the structure and energy of this tree by that of \c source,
+     * subdividing every quadrant that holds more than the fraction \c threshold
+     * of the total energy (up to a depth of \c maxDepth)
+     *
+     * Quadrants that are leaves of \c source but need to be subdivided
+     * distribute their energy uniformly among their children.
+     */
+    void build(const DTree &source, float threshold, int maxDepth);
+
+    /// Zero the energy of all nodes, but keep the structure
+    void clear();
+
+    /// Return the number of nodes
+    size_t getNodeCount() const { return m_nodes.size(); }
+
+private:
+    struct Node {
+        std::atomic<float> sum[4];
+        /// Child nodes of the quadrants (0: the quadrant is a leaf)
+        uint32_t children[4];
+
+        Node();
+        Node(const Node &other);
+        Node &operator=(const Node &other);
+
+        float getTotal() const {
+            return sum[0].load(std::memory_order_relaxed) + sum[1].load(std::memory_order_relaxed)
+                + sum[2].load(std::memory_order_relaxed) + sum[3].load(std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<Node> m_nodes;
+};
+
+/**
+ * \brief Spatial-directional tree of incident radiance for path guiding
+ * (Müller et al. 2017, "Practical Path Guiding for Efficient Light-Transport
+ * Simulation")
+ *
+ * A binary tree over the scene's bounding box, whose splitting axis
+ * alternates between x, y and z. Every leaf (a \ref Region) holds two
+ * \ref DTree instances: the \c sampling tree learned in the previous
+ * iteration, and the \c building tree that collects the radiance of the
+ * current iteration. \ref refine() splits regions that received many
+ * samples and turns the building trees into the new sampling trees.
+ */
+class SDTree {
+public:
+    /// Leaf of the spatial tree
+    struct Region {
+        DTree sampling;
+        DTree building;
+        std::atomic<uint32_t> sampleCount;
+
+        Region() : sampleCount(0) { }
+        Region(const Region &other)
+            : sampling(other.sampling), building(other.building),
+              sampleCount(other.sampleCount.load()) { }
+
+        /// Record the incident radiance estimate \c value (radiance / pdf) from direction \c d
+        void record(const Vector3f &d, float value) {
+            building.record(d, value);
+            sampleCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    /// Create a tree with a single region that covers \c bounds
+    SDTree(const BoundingBox3f &bounds);
+
+    /// Return the region that contains \c p
+    Region *lookup(const Point3f &p) const;
+
+    /**
+     * \brief Prepare the tree for the next iteration
+     *
+     * Splits every region that received more than \c splitThreshold
+     * samples (the children inherit its directional distributions), then
+     * rebuilds the directional trees of all regions from the energy
+     * recorded during the iteration (see \ref DTree::build()). Regions
+     * without any samples keep their sampling trees.
+     */
+    void refine(uint32_t splitThreshold, float threshold, int maxDepth);
+
+    /// Return the number of regions
+    size_t getRegionCount() const { return m_regions.size(); }
+
+    /// Return a human-readable string summary
+    std::string toString() const;
+
+private:
+    struct Node {
+        /// Splitting axis
+        int axis;
+        /// Child nodes (0: this node is a leaf)
+        uint32_t children[2];
+        /// Index of the region of a leaf
+        uint32_t region;
+    };
+
+    BoundingBox3f m_bounds;
+    std::vector<Node> m_nodes;
+    std::vector<std::unique_ptr<Region>> m_regions;
+};
+
+NORI_NAMESPACE_END
@@ -19,9 +19,30 @@
 #pragma once
 
 #include <nori/object.h>
+#include <nori/ray.h>
 
 NORI_NAMESPACE_BEGIN
 
+class ImageBlock;
+class SplatFilm;
+struct AOVRecord;
+
+/**
+ * \brief A camera ray together with the pixel sample that generated it
+ *
+ * Used to pass batches of camera rays to \ref Integrator::LiWavefront()
+ */
+struct CameraRaySample {
+    /// The camera ray
+    Ray3f ray;
+    /// Pixel that the ray belongs to
+    Point2i pixel;
+    /// Index of the pixel sample
+    uint32_t sampleIndex;
+    /// Number of sampler components consumed while generating the ray
+    uint32_t dimension;
+};
+
 /**
  * \brief Abstract integrator (i.e. a rendering technique)
  *
@@ -53,6 +74,91 @@ public:
      */
     virtual Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &ray) const = 0;
 
+    /**
+     * \brief Sample the incident radiance along a camera ray, and record
+     * the auxiliary output variables of its first intersection
+     *
+     * The default implementation calls \ref Li() and then intersects the
+     * ray once more. Integrators that find the first intersection anyway
+     * should override this to fill in \c aov along the way.
+     */
+    virtual Color3f LiAOV(const Scene *scene, Sampler *sampler, const Ray3f &ray, AOVRecord &aov) const;
+
+    /**
+     * \brief Does this integrator prefer to process all camera rays of
+     * an image block at once (see \ref LiWavefront())?
+     */
+    virtual bool isWavefront() const { return false; }
+
+    /**
+     * \brief Sample the incident radiance along a batch of camera rays
+     *
+     * Only used for integrators that return \c true in \ref isWavefront().
+     * Since the paths are advanced in an interleaved fashion, the sampler
+     * has to be positioned at the right pixel sample and component (see
+     * \ref Sampler::setDimension()) whenever a path requests samples.
+     *
+     * \param scene
+     *    A pointer to the underlying scene
+     * \param sampler
+     *    A pointer to a sample generator
+     * \param rays
+     *    The camera rays and their pixel samples
+     * \param result
+     *    Receives an estimate of the radiance along each ray
+     * \param count
+     *    The number of rays
+     */
+    virtual void LiWavefront(const Scene *scene, Sampler *sampler, const CameraRaySample *rays,
+                             Color3f *result, size_t count) const {
+        throw NoriException("Integrator::LiWavefront(): not supported by %s", toString());
+    }
+
+    /**
+     * \brief Does this integrator render the image in a sequence of passes
+     * over the entire crop window (see \ref renderPass())?
+     *
+     * Progressive integrators are not driven by \ref Li(); the renderer
+     * instead calls \ref renderPass() once per sample of the sampler and
+     * displays the image after every pass.
+     */
+    virtual bool isProgressive() const { return false; }
+
+    /**
+     * \brief Render one pass of a progressive integrator
+     *
+     * \param scene
+     *    A pointer to the underlying scene
+     * \param pass
+     *    Index of the pass, starting at zero
+     * \param block
+     *    Receives the estimate of the image after this pass. It covers
+     *    the entire output image and has been cleared; only the pixels
+     *    within the crop window of the camera need to be written.
+     */
+    virtual void renderPass(const Scene *scene, uint32_t pass, ImageBlock &block) {
+        throw NoriException("Integrator::renderPass(): not supported by %s", toString());
+    }
+
+    /**
+     * \brief Does this integrator also contribute to pixels other than
+     * the one whose sample is being rendered (e.g. by light tracing)?
+     *
+     * The renderer then provides a film for these contributions using
+     * \ref setSplatFilm(). One light path is assumed to be traced per
+     * pixel sample, and the splats are scaled accordingly.
+     */
+    virtual bool isSplatting() const { return false; }
+
+    /**
+     * \brief Set the film that receives the contributions to other pixels
+     *
+     * Only used for integrators that return \c true in \ref isSplatting().
+     * The film may be \c nullptr (e.g. while rendering a preview), in which
+     * case these contributions are skipped.
+     */
+    virtual void setSplatFilm(SplatFilm *film) { }
+
     /**
      * \brief Return the type of object (i.e. Mesh/BSDF/etc.) 
      * provided by this instance
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <nori/bbox.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Conservative bounds of the light emitted by an emitter
+ *
+ * The emitting positions lie within \c bounds, all emitting surface
+ * normals lie in the cone of directions around \c axis with the angle
+ * \c theta_o, and light is emitted at most \c theta_e beyond those
+ * normals (\c pi/2 for one-sided surfaces). \c phi is the emitted power.
+ */
+struct LightBounds {
+    BoundingBox3f bounds;
+    Vector3f axis = Vector3f(0.f, 0.f, 1.f);
+    float cosThetaO = -1.f;
+    float cosThetaE = 0.f;
+    float phi = 0.f;
+
+    /// Bounds that contain both arguments
+    static LightBounds merge(const LightBounds &a, const LightBounds &b);
+
+    /**
+     * \brief Estimate how much light the emitters within these bounds
+     * contribute at the point \c p
+     *
+     * The estimate is zero only if no emitter within the bounds can
+     * illuminate \c p.
+     */
+    float importance(const Point3f &p) const;
+
+    /// Return a human-readable string summary
+    std::string toString() const;
+};
+
+/**
+ * \brief Bounding volume hierarchy over the emitters of a scene
+ *
+ * Every node stores the \ref LightBounds of its emitters. An emitter is
+ * sampled by descending from the root and choosing each child with a
+ * probability proportional to its estimated importance for the shading
+ * point, so that distant, dim or backfacing emitters receive few
+ * samples. Emitters without bounds (e.g. environment emitters) are not
+ * part of the hierarchy and are chosen uniformly with a probability that
+ * treats the whole hierarchy as one additional emitter.
+ */
+class LightBVH {
+public:
+    /**
+     * \brief Build the hierarchy over a set of emitters
+     *
+     * The returned indices refer to the position in \c emitters.
+     */
+    void build(const std::vector<Emitter *> &emitters);
+
+    /**
+     * \brief Choose an emitter for the shading point \c p
+     *
+     * \param sample
+     *     A uniformly distributed sample on [0, 1). On return, it has
+     *     been rescaled to a fresh uniform sample that can be reused
+     * \param pmf
+     *     Returns the probability of the choice
+     * \return
+     *     The index of the emitter, or -1 if no emitter contributes at \c p
+     */
+    int sample(const Point3f &p, float &sample, float &pmf) const;
+
+    /// Return the probability of choosing an emitter with \ref sample()
+    float pmf(const Point3f &p, int index) const;
+
+    /// Return the number of emitters stored in the hierarchy
+    size_t getBoundedCount() const { return m_boundedCount; }
+
+protected:
+    struct Node {
+        LightBounds bounds;
+        /// Index of the second child (the first child follows the node), or of the emitter in leaves
+        uint32_t index;
+        bool leaf;
+    };
+
+    /// Recursively build the subtree for the emitters [begin, end) of \c lights
+    uint32_t buildRecursive(std::vector<std::pair<uint32_t, LightBounds>> &lights,
+                            size_t begin, size_t end, uint64_t trail, int depth);
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_infinite;
+    /// Path from the root to the leaf of every bounded emitter (bit i: child taken at depth i)
+    std::vector<uint64_t> m_trails;
+    /// Is the emitter part of the hierarchy?
+    std::vector<bool> m_bounded;
+    size_t m_boundedCount = 0;
+};
+
+NORI_NAMESPACE_END
@@ -72,6 +72,18 @@ public:
 
 	virtual float pdfFreePath(const MediumQueryRecord &mRec) const = 0;
 
+	/**
+	 * \brief Sample the distance to the next interaction along a ray segment
+	 *
+	 * Returns the distance from \c ray.o, or infinity if the path passes the
+	 * segment <tt>[ray.mint, ray.maxt]</tt> without an interaction. The
+	 * interaction is meant to be accounted for with \c albedo (see \ref sample()).
+	 */
+	virtual float sampleDistance(const Ray3f &ray, Sampler *sampler) const = 0;
+
+	/// Estimate the transmittance along the ray segment <tt>[ray.mint, ray.maxt]</tt>
+	virtual Color3f evalTransmittance(const Ray3f &ray, Sampler *sampler) const = 0;
+
 	virtual bool isHomogeneousMedium() const { return false; }
 
 	virtual bool isInMedium(Point3f o) const { return false; }
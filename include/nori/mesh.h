@@ -46,9 +46,13 @@ struct Intersection {
     Frame geoFrame;
     /// Pointer to the associated mesh
     const Mesh *mesh;
+    /// Index of the mesh within the scene's acceleration data structure
+    uint32_t meshIndex;
+    /// Index of the triangle within the mesh
+    uint32_t primIndex;
 
     /// Create an uninitialized intersection record
-    Intersection() : mesh(nullptr) { }
+    Intersection() : mesh(nullptr), meshIndex(0), primIndex(0) { }
 
     /// Transform a direction vector into the local shading frame
     Vector3f toLocal(const Vector3f &d) const {
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <nori/common.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Description of the NUMA nodes of the machine
+ *
+ * On Linux, the nodes and their CPUs are read from sysfs. On other
+ * platforms (or if this information is unavailable), the machine is
+ * treated as a single node.
+ */
+class NumaTopology {
+public:
+    /// Detect the NUMA topology of the machine
+    NumaTopology();
+
+    /// Return the number of NUMA nodes
+    int getNodeCount() const { return (int) m_cpus.size(); }
+
+    /// Return the CPUs that belong to a node
+    const std::vector<int> &getCpus(int node) const { return m_cpus[node]; }
+
+    /// Return a human-readable string summary
+    std::string toString() const;
+
+private:
+    std::vector<std::vector<int>> m_cpus;
+};
+
+/**
+ * \brief Restricts the calling thread to the CPUs of a NUMA node for
+ * the lifetime of this object
+ *
+ * Memory that the thread touches first while it is bound is then
+ * allocated on that node by the operating system. This has no effect
+ * on platforms without thread affinity support.
+ */
+class NumaThreadBinding {
+public:
+    NumaThreadBinding(const NumaTopology &topology, int node);
+
+    /// Restore the previous CPU affinity of the thread
+    ~NumaThreadBinding();
+
+private:
+    std::vector<int> m_previousCpus;
+};
+
+NORI_NAMESPACE_END
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <nori/kdtree.h>
+#include <nori/dpdf.h>
+#include <nori/color.h>
+#include <nori/ray.h>
+#include <unordered_map>
+
+NORI_NAMESPACE_BEGIN
+
+/// Data record of a photon stored in a \ref PhotonMap
+struct PhotonData {
+    /// Direction towards the previous vertex of the photon path
+    Vector3f direction;
+    /// Power carried by the photon
+    Color3f power;
+
+    PhotonData() : direction(0.0f), power(0.0f) { }
+    PhotonData(const Vector3f &direction, const Color3f &power)
+        : direction(direction), power(power) { }
+};
+
+/// A photon is a kd-tree node with a position and a \ref PhotonData record
+typedef GenericKDTreeNode<Point3f, PhotonData> Photon;
+
+/// kd-tree over photons for density estimation
+typedef PointKDTree<Photon> PhotonMap;
+
+/**
+ * \brief Chooses the emitters of photon paths proportionally to their power
+ *
+ * Environment emitters are weighted by the cross section of the scene's
+ * bounding sphere, like in \ref Scene::sampleDirect().
+ */
+class PhotonEmission {
+public:
+    PhotonEmission(const Scene *scene);
+
+    /**
+     * \brief Sample an emitter and the initial ray of a photon leaving it
+     *
+     * \param ray      Returns the photon ray
+     * \param sample   A uniformly distributed sample on [0, 1) that chooses the emitter
+     * \param sample1  A uniformly distributed sample on \f$[0,1]^2\f$ (position)
+     * \param sample2  A uniformly distributed sample on \f$[0,1]^2\f$ (direction)
+     *
+     * \return The power of the photon, i.e. the weight returned by \ref
+     *     Emitter::samplePhoton() divided by the probability of the emitter
+     */
+    Color3f sample(Ray3f &ray, float sample, const Point2f &sample1, const Point2f &sample2) const;
+
+    /**
+     * \brief Choose an emitter proportionally to its power
+     *
+     * \param sample  A uniformly distributed sample on [0, 1)
+     * \param pdf     Returns the probability of the chosen emitter
+     */
+    const Emitter *sampleEmitter(float sample, float &pdf) const {
+        return m_emitters[m_distr.sample(sample, pdf)];
+    }
+
+    /// Return the probability with which \ref sampleEmitter() chooses the given emitter
+    float pdfEmitter(const Emitter *emitter) const {
+        auto it = m_index.find(emitter);
+        return it != m_index.end() ? m_distr[it->second] : 0.0f;
+    }
+
+private:
+    std::vector<const Emitter *> m_emitters;
+    DiscretePDF m_distr;
+    /// Position of every emitter in \ref m_emitters
+    std::unordered_map<const Emitter *, size_t> m_index;
+};
+
+NORI_NAMESPACE_END
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <nori/vector.h>
+#include <cstdint>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Helper functions for quasi-Monte Carlo sample generation
+ *
+ * The samplers built on top of these functions use the first two
+ * dimensions of the Sobol sequence, which form a (0,2)-sequence in base 2:
+ * every power-of-two prefix is stratified with respect to all elementary
+ * intervals. Higher dimensions are obtained by "padding", i.e. by drawing
+ * additional 2D points from independently shuffled and scrambled copies
+ * of this sequence. The randomization uses the hash-based nested uniform
+ * (Owen) scrambling described in
+ *
+ *   "Practical Hash-based Owen Scrambling" by Brent Burley, JCGT 2020
+ *
+ * which preserves the stratification of the underlying sequence.
+ */
+namespace qmc {
+    /// Reverse the bits of a 32-bit integer
+    inline uint32_t reverseBits(uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+        x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    /// Well-distributed 32-bit integer hash function
+    inline uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    /// Combine a hash value with another integer
+    inline uint32_t hashCombine(uint32_t seed, uint32_t value) {
+        return seed ^ (hash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+    }
+
+    /// First dimension of the Sobol sequence (van der Corput sequence)
+    inline uint32_t sobol0(uint32_t index) {
+        return reverseBits(index);
+    }
+
+    /// Second dimension of the Sobol sequence
+    inline uint32_t sobol1(uint32_t index) {
+        uint32_t result = 0;
+        for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+            if (index & 1)
+                result ^= v;
+        }
+        return result;
+    }
+
+    /// Laine-Karras style permutation operating on bit-reversed integers
+    inline uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    /// Nested uniform (Owen) scrambling of a 32-bit fixed point value
+    inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+        return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+    }
+
+    /// Convert a 32-bit fixed point value into a float on <tt>[0, 1)</tt>
+    inline float toFloat(uint32_t x) {
+        /* Keep the 24 most significant bits so that the conversion is exact
+           and cannot round a value into the neighboring stratum */
+        return (x >> 8) * 5.9604644775390625e-8f /* 2^-24 */;
+    }
+
+    /**
+     * \brief Return the point with index \c index of a shuffled and
+     * Owen-scrambled (0,2)-sequence as a pair of 32-bit fixed point values
+     *
+     * Different seeds produce statistically independent sequences.
+     */
+    inline void sobol2D(uint32_t index, uint32_t seed, uint32_t &x, uint32_t &y) {
+        index = nestedUniformScramble(index, hashCombine(seed, 0));
+        x = nestedUniformScramble(sobol0(index), hashCombine(seed, 1));
+        y = nestedUniformScramble(sobol1(index), hashCombine(seed, 2));
+    }
+
+    /// Floating point version of \ref sobol2D()
+    inline Point2f sobol2D(uint32_t index, uint32_t seed) {
+        uint32_t x, y;
+        sobol2D(index, seed, x, y);
+        return Point2f(toFloat(x), toFloat(y));
+    }
+
+    /// One-dimensional shuffled and Owen-scrambled van der Corput sequence
+    inline float sobol1D(uint32_t index, uint32_t seed) {
+        index = nestedUniformScramble(index, hashCombine(seed, 0));
+        return toFloat(nestedUniformScramble(sobol0(index), hashCombine(seed, 1)));
+    }
+}
+
+NORI_NAMESPACE_END
@@ -44,39 +44,32 @@ template <typename _PointType, typename _VectorType> struct TRay {
     VectorType dRcp; ///< Componentwise reciprocals of the ray direction
     Scalar mint;     ///< Minimum position on the ray segment
     Scalar maxt;     ///< Maximum position on the ray segment
-	float time;		 ///time parameter in [0, 1]
+	float time;		 ///time parameter in [0, 1] (0 unless set by the caller)
 
     /// Construct a new ray
     TRay() : mint(Epsilon), 
-        maxt(std::numeric_limits<Scalar>::infinity()) {
-		//srand(time(NULL));
-		time = ((float)rand() / (RAND_MAX));
-	}
+        maxt(std::numeric_limits<Scalar>::infinity()), time(0.f) { }
     
     /// Construct a new ray
     TRay(const PointType &o, const VectorType &d) : o(o), d(d), 
-            mint(Epsilon), maxt(std::numeric_limits<Scalar>::infinity()) {
-		//srand(time(NULL));
-		time = ((float)rand() / (RAND_MAX));
+            mint(Epsilon), maxt(std::numeric_limits<Scalar>::infinity()), time(0.f) {
         update();
     }
 
     /// Construct a new ray
     TRay(const PointType &o, const VectorType &d, 
-        Scalar mint, Scalar maxt) : o(o), d(d), mint(mint), maxt(maxt) {
-		//srand(time(NULL));
-		time = ((float)rand() / (RAND_MAX));
+        Scalar mint, Scalar maxt) : o(o), d(d), mint(mint), maxt(maxt), time(0.f) {
         update();
     }
 
     /// Copy constructor
     TRay(const TRay &ray) 
      : o(ray.o), d(ray.d), dRcp(ray.dRcp),
-       mint(ray.mint), maxt(ray.maxt) { }
+       mint(ray.mint), maxt(ray.maxt), time(ray.time) { }
 
     /// Copy a ray, but change the covered segment of the copy
     TRay(const TRay &ray, Scalar mint, Scalar maxt) 
-     : o(ray.o), d(ray.d), dRcp(ray.dRcp), mint(mint), maxt(maxt) { }
+     : o(ray.o), d(ray.d), dRcp(ray.dRcp), mint(mint), maxt(maxt), time(ray.time) { }
 
     /// Update the reciprocal ray directions after changing 'd'
     void update() {
@@ -91,6 +84,7 @@ template <typename _PointType, typename _VectorType> struct TRay {
         TRay result;
         result.o = o; result.d = -d; result.dRcp = -dRcp;
         result.mint = mint; result.maxt = maxt;
+        result.time = time;
         return result;
     }
 
@@ -20,31 +20,251 @@
 #define __NORI_RENDER_H
 
 #include <nori/common.h>
+#include <nori/vector.h>
 #include <thread>
 #include <nori/block.h>
+#include <nori/aov.h>
 #include <atomic>
 
 NORI_NAMESPACE_BEGIN
 
+struct RenderTile;
+
+/**
+ * \brief Settings that override the values specified in a scene file
+ *
+ * Negative numbers and empty strings leave the corresponding
+ * setting of the scene untouched.
+ */
+struct RenderOptions {
+    /// Number of worker threads (default: one per core)
+    int threadCount = -1;
+
+    /**
+     * \brief NUMA-aware scheduling
+     *
+     * Distributes the workers over the NUMA nodes of the machine and
+     * pins them there. Every node preferably renders its own horizontal
+     * band of tiles, whose film memory then resides on that node.
+     */
+    bool numa = false;
+
+    /// Number of samples per pixel
+    int sampleCount = -1;
+
+    /// Resolution of the output image in pixels
+    Vector2i resolution = Vector2i(-1, -1);
+
+    /// Output file name (default: scene file name with an .exr extension)
+    std::string outputName;
+
+    /// Upper left corner of the crop window in pixels
+    Point2i cropOffset = Point2i(0, 0);
+
+    /// Size of the crop window in pixels (non-positive: keep the crop window of the scene)
+    Vector2i cropSize = Vector2i(-1, -1);
+
+    /**
+     * \brief Enable adaptive sampling
+     *
+     * The configured sample count then acts as an upper bound
+     * per pixel: after \ref minSampleCount samples, pixels whose relative
+     * standard error drops below \ref errorThreshold stop receiving
+     * samples, and rendering ends early once all pixels have converged or
+     * the error averaged over the image falls below \ref errorTarget.
+     */
+    bool adaptive = false;
+
+    /// Number of samples every pixel receives in adaptive mode
+    int minSampleCount = 16;
+
+    /// Per-pixel relative error below which a pixel is considered converged
+    float errorThreshold = 0.01f;
+
+    /// Image-wide mean relative error at which rendering stops (0: disabled)
+    float errorTarget = 0.f;
+
+    /**
+     * \brief Maximum number of samples per pixel that a worker renders
+     * for a tile before handing it back to the scheduler
+     */
+    int samplesPerChunk = 16;
+
+    /// Milliseconds between two snapshots of the film for display (0: disabled)
+    int displayInterval = 250;
+
+    /**
+     * \brief Display quick previews at 1/8, 1/4 and 1/2 of the output
+     * resolution before the first full-resolution pass is complete
+     *
+     * Only used when the film is displayed (see \ref displayInterval)
+     */
+    bool preview = true;
+
+    /**
+     * \brief Filter importance sampling
+     *
+     * Draws the camera sample positions from the reconstruction filter
+     * instead of splatting samples into all pixels within its radius.
+     * Every sample then lands in exactly one pixel, so the film needs no
+     * border regions and tiles become fully independent.
+     */
+    bool filterImportanceSampling = false;
+
+    /// Seconds between two checkpoints of the render state (0: disabled)
+    int checkpointInterval = 0;
+
+    /// Checkpoint file name (default: output file name with a .ckpt extension)
+    std::string checkpointName;
+
+    /**
+     * \brief Continue rendering from the checkpoint file
+     *
+     * The scene and all settings that affect the sampling of the image
+     * must be the same as in the run that wrote the checkpoint.
+     */
+    bool resume = false;
+
+    /**
+     * \brief Accumulate auxiliary output variables (see \ref AOVImages)
+     *
+     * They are written into the output file as additional layers, which
+     * requires an OpenEXR output file.
+     */
+    bool aovs = false;
+};
+
+/**
+ * \brief Load a scene from an XML file and prepare it for rendering
+ *
+ * Applies the overrides of \c options and runs the preprocessing step
+ * of the integrator.
+ *
+ * \return The scene, or \c nullptr if the file did not describe a scene
+ */
+extern Scene *loadScene(const std::string &filename, const RenderOptions &options);
+
+/// Return the output file name for a scene file (the scene name with an .exr extension by default)
+extern std::string getOutputName(const std::string &filename, const RenderOptions &options);
+
+/**
+ * \brief Save an image block as an OpenEXR file, or as a PNG file when \c filename ends in .png
+ *
+ * When \c aovs is given, they are written as additional layers of the OpenEXR file.
+ */
+extern void saveImage(const ImageBlock &block, const std::string &filename,
+                      const AOVImages *aovs = nullptr);
+
+/**
+ * \brief Render one sample for every pixel of a block
+ *
+ * When per-pixel statistics are provided (adaptive sampling), converged
+ * pixels are skipped and the luminance of the new samples is recorded.
+ * When a filter is passed in \c fisFilter, the sample positions are
+ * importance sampled from it and every sample is only recorded in the
+ * pixel it was generated for. When \c aovs is given, the AOVs of every
+ * sample are recorded as well (together with the IDs of the first sample).
+ */
+extern void renderBlock(const Scene *scene, Sampler *sampler, ImageBlock &block,
+                        uint32_t sampleIndex, PixelStatistics *statistics,
+                        const ReconstructionFilter *fisFilter,
+                        const AOVBlocks *aovs = nullptr);
+
 class RenderThread {
 
 public:
     RenderThread(ImageBlock & block);
     ~RenderThread();
 
-    void renderScene(const std::string & filename);
+    /**
+     * \brief Load a scene and start rendering it asynchronously
+     *
+     * \return \c false if the file did not describe a scene
+     */
+    bool renderScene(const std::string & filename,
+                     const RenderOptions & options = RenderOptions());
 
     bool isBusy();
     void stopRendering();
 
     float getProgress();
 
+    /// Did the most recent rendering fail with an error?
+    bool hasFailed() const { return m_failed; }
+
+    /**
+     * \brief Return the regions <tt>[min, max)</tt> of the output block that
+     * changed since the last call, e.g. to update a texture incrementally
+     *
+     * Must be called while holding the lock of the output block.
+     *
+     * \return \c true if the entire block must be considered as changed
+     *     (in which case no regions are returned)
+     */
+    bool takeDirtyRegions(std::vector<BoundingBox2i> &regions);
+
 protected:
+    /// Render the loaded scene into the output block (runs on the render thread)
+    void render();
+
+    /**
+     * \brief Assemble the film into the back buffer and copy the
+     * changed parts into the output block
+     *
+     * \param full
+     *     Assemble the entire film instead of only the tiles
+     *     committed since the last call (always the case for
+     *     splatting integrators, see \ref Integrator::isSplatting())
+     */
+    void publish(bool full);
+
+    /**
+     * \brief Render the loaded scene with a progressive integrator (see
+     * \ref Integrator::isProgressive()), displaying the image after every pass
+     *
+     * Adaptive sampling and checkpoints are not supported.
+     */
+    void renderProgressive();
+
+    /// Assemble the AOV films and statistics into \ref m_aovImages
+    void developAOVs();
+
+    /// Render and display low-resolution previews of the given tiles
+    void renderPreview(const std::vector<std::unique_ptr<RenderTile>> &tiles);
+
+    /// Load the state of all tiles from the checkpoint file
+    void loadCheckpoint(std::vector<std::unique_ptr<RenderTile>> &tiles);
+
+    /// Atomically replace the checkpoint file with the current state of all tiles
+    void saveCheckpoint(const std::vector<std::unique_ptr<RenderTile>> &tiles);
+
     Scene* m_scene = nullptr;
+    RenderOptions m_options;
     ImageBlock & m_block;
+    std::string m_checkpointName;
+    ImageBlock m_backBuffer;
+    TiledFilm m_film;
     std::thread m_render_thread;
     std::atomic<int> m_render_status; // 0: free, 1: busy, 2: interruption, 3: done
     std::atomic<float> m_progress;
+    std::atomic<bool> m_failed;
+    PixelStatistics m_statistics;
+
+    /* Auxiliary output variables (also recorded in m_statistics) */
+    TiledFilm m_aovFilms[EFilteredAOVCount];
+    PixelIDs m_ids;
+    AOVImages m_aovImages;
+
+    /* Contributions of splatting integrators, and the number of pixel
+       samples (i.e. light paths) that they were computed from */
+    bool m_splatting = false;
+    SplatFilm m_splats;
+    std::atomic<uint64_t> m_pixelSamples;
+
+    /* Changes of the output block since the last call to takeDirtyRegions()
+       (protected by the lock of the output block) */
+    std::vector<BoundingBox2i> m_dirtyRegions;
+    bool m_fullUpdate = true;
 
 };
 
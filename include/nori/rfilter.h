@@ -19,10 +19,14 @@
 #pragma once
 
 #include <nori/object.h>
+#include <nori/dpdf.h>
 
 /// Reconstruction filters will be tabulated at this resolution
 #define NORI_FILTER_RESOLUTION 32
 
+/// Number of bins per unit radius of the tabulated filter sampling distribution
+#define NORI_FILTER_SAMPLING_RESOLUTION 64
+
 NORI_NAMESPACE_BEGIN
 
 /**
@@ -45,6 +49,30 @@ public:
     /// Evaluate the filter function
     virtual float eval(float x) const = 0;
 
+    /**
+     * \brief Tabulate the magnitude of the filter for \ref sample()
+     *
+     * Subclasses that override this function must call it.
+     */
+    virtual void activate();
+
+    /**
+     * \brief Sample a 1D offset proportionally to the magnitude of the filter
+     *
+     * This is used by filter importance sampling, where the camera sample
+     * position is drawn from the filter and every sample only contributes
+     * to the pixel whose filter was sampled.
+     *
+     * \param sample
+     *     A uniformly distributed sample on <tt>[0, 1)</tt>
+     * \param weight
+     *     Returns the filter value divided by the sampling density,
+     *     which is negative in negative lobes of the filter
+     * \return
+     *     An offset in <tt>[-radius, radius]</tt>
+     */
+    float sample(float sample, float &weight) const;
+
     /**
      * \brief Return the type of object (i.e. Mesh/Camera/etc.) 
      * provided by this instance
@@ -52,6 +80,7 @@ public:
     virtual EClassType getClassType() const { return EReconstructionFilter; }
 protected:
     float m_radius;
+    DiscretePDF m_distr;
 };
 
 NORI_NAMESPACE_END
@@ -20,6 +20,7 @@
 
 #include <nori/object.h>
 #include <memory>
+#include <iosfwd>
 
 NORI_NAMESPACE_BEGIN
 
@@ -88,6 +89,34 @@ public:
     /// Advance to the next sample
     virtual void advance() = 0;
 
+    /**
+     * \brief Prepare to generate the components of a specific pixel sample
+     *
+     * The renderer calls this function before computing sample number
+     * \c sampleIndex of the pixel at position \c pixel. Since the samples
+     * of a pixel are not necessarily computed in succession, samplers based
+     * on deterministic sequences (e.g. Sobol) use this information to jump
+     * to the right point of their sequence. The default implementation
+     * does nothing.
+     */
+    virtual void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) { }
+
+    /**
+     * \brief Return the number of components that were requested from the
+     * current pixel sample so far
+     *
+     * Together with \ref setDimension(), this allows integrators that
+     * advance many paths in an interleaved fashion (see
+     * \ref Integrator::isWavefront()) to suspend and later resume the
+     * pixel sample of each path. Samplers whose components are
+     * statistically independent need not keep track of this; the default
+     * implementation returns zero.
+     */
+    virtual uint32_t getDimension() const { return 0; }
+
+    /// Continue the current pixel sample at the given component (see \ref getDimension())
+    virtual void setDimension(uint32_t dimension) { }
+
     /// Retrieve the next component value from the current sample
     virtual float next1D() = 0;
 
@@ -97,6 +126,25 @@ public:
     /// Return the number of configured pixel samples
     virtual size_t getSampleCount() const { return m_sampleCount; }
 
+    /// Override the number of pixel samples
+    virtual void setSampleCount(size_t sampleCount) { m_sampleCount = sampleCount; }
+
+    /**
+     * \brief Write the current state of the sample generator to a binary stream
+     *
+     * Together with \ref unserialize(), this allows a render checkpoint to
+     * continue the random number streams exactly where they were
+     * interrupted. The default implementation throws an exception.
+     */
+    virtual void serialize(std::ostream &stream) const {
+        throw NoriException("Sampler::serialize(): not supported by %s", toString());
+    }
+
+    /// Restore a state previously written by \ref serialize()
+    virtual void unserialize(std::istream &stream) {
+        throw NoriException("Sampler::unserialize(): not supported by %s", toString());
+    }
+
     /**
      * \brief Return the type of object (i.e. Mesh/Sampler/etc.) 
      * provided by this instance
@@ -20,9 +20,12 @@
 
 #include <nori/bvh.h>
 #include <nori/emitter.h>
+#include <unordered_map>
 
 NORI_NAMESPACE_BEGIN
 
+class LightBVH;
+
 /**
  * \brief Main scene data structure
  *
@@ -50,6 +53,9 @@ public:
     /// Return a pointer to the scene's camera
     const Camera *getCamera() const { return m_camera; }
 
+    /// Return a pointer to the scene's camera
+    Camera *getCamera() { return m_camera; }
+
     /// Return a pointer to the scene's sample generator (const version)
     const Sampler *getSampler() const { return m_sampler; }
     
@@ -121,7 +127,16 @@ public:
         return m_bvh->rayIntersect(ray, its, true);
     }
     
-    /// Uniformly pick a emitter and invoke its direct illumination sampling method
+    /**
+     * \brief Pick an emitter and invoke its direct illumination sampling method
+     *
+     * Depending on the \c lightSampling parameter, the emitter is chosen
+     * uniformly (\c "uniform"), proportionally to its emitted power
+     * (\c "power", see \ref Emitter::power()) or by its estimated
+     * contribution at \c lRec.ref using a \ref LightBVH (\c "bvh", the
+     * default). When no emitter can contribute, \c lRec.emitter is set
+     * to \c nullptr and a zero value is returned.
+     */
     Color3f sampleDirect(EmitterQueryRecord &lRec, const Point2f &sample) const;
 
     /// Compute the density of \ref sampleDirect()
@@ -161,6 +176,18 @@ private:
 	Medium *m_medium = nullptr;
 
 	DiscretePDF distr;
+
+    /// Emitter selection strategy of \ref sampleDirect()
+    enum ELightSampling {
+        EUniformLightSampling = 0,
+        EPowerLightSampling,
+        EBVHLightSampling
+    };
+
+    ELightSampling m_lightSampling;
+    LightBVH *m_lightBVH = nullptr;
+    /// Position of every emitter in \ref m_emitters
+    std::unordered_map<const Emitter *, uint32_t> m_emitterIndex;
 };
 
 NORI_NAMESPACE_END
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <nori/common.h>
+#include <iostream>
+
+NORI_NAMESPACE_BEGIN
+
+/* =======================================================================
+ *   Helper functions for reading and writing binary files (e.g. render
+ *   checkpoints). Values are stored using their in-memory representation,
+ *   hence the files are only meant to be read on the same platform.
+ * ======================================================================= */
+
+/// Write a plain old data value to a binary stream
+template <typename T> void writeBinary(std::ostream &stream, const T &value) {
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/// Write an array of plain old data values to a binary stream
+template <typename T> void writeBinary(std::ostream &stream, const T *values, size_t count) {
+    stream.write(reinterpret_cast<const char *>(values), sizeof(T) * count);
+}
+
+/// Read a plain old data value from a binary stream
+template <typename T> void readBinary(std::istream &stream, T &value) {
+    stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+    if (!stream)
+        throw NoriException("readBinary(): unexpected end of stream!");
+}
+
+/// Read an array of plain old data values from a binary stream
+template <typename T> void readBinary(std::istream &stream, T *values, size_t count) {
+    stream.read(reinterpret_cast<char *>(values), sizeof(T) * count);
+    if (!stream)
+        throw NoriException("readBinary(): unexpected end of stream!");
+}
+
+NORI_NAMESPACE_END
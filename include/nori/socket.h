@@ -0,0 +1,69 @@
+#pragma once
+
+#include <nori/common.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Minimal TCP socket for exchanging messages between processes
+ *
+ * Messages are arbitrary byte strings that are transmitted with a length
+ * prefix, so that the receiver always obtains them in one piece. All
+ * errors (including a closed connection) are reported as exceptions.
+ * Only POSIX platforms are supported.
+ */
+class Socket {
+public:
+    /// Create an invalid socket
+    Socket() { }
+
+    /// Take ownership of a socket descriptor
+    explicit Socket(int fd) : m_fd(fd) { }
+
+    Socket(Socket &&other) : m_fd(other.m_fd) { other.m_fd = -1; }
+
+    Socket &operator=(Socket &&other);
+
+    /// Close the socket
+    ~Socket() { close(); }
+
+    /// Create a socket that listens for connections on the given port (0: any free port)
+    static Socket listen(int port);
+
+    /// Connect to a listening socket
+    static Socket connect(const std::string &host, int port);
+
+    /**
+     * \brief Accept a connection on a listening socket
+     *
+     * \return An invalid socket if no connection arrived
+     *     within \c timeout milliseconds
+     */
+    Socket accept(int timeout);
+
+    /// Send a message
+    void sendMessage(const std::string &message);
+
+    /// Receive a message, blocking until it has arrived completely
+    std::string receiveMessage();
+
+    /// Return the local port of the socket
+    int getPort() const;
+
+    /// Does this instance refer to an open socket?
+    bool isValid() const { return m_fd >= 0; }
+
+    /// Close the socket
+    void close();
+
+protected:
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+
+    void send(const void *data, size_t size);
+    void receive(void *data, size_t size);
+
+    int m_fd = -1;
+};
+
+NORI_NAMESPACE_END
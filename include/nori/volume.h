@@ -0,0 +1,177 @@
+#pragma once
+
+#include <nori/bbox.h>
+#include <memory>
+
+NORI_NAMESPACE_BEGIN
+
+/// Read-only memory mapping of an entire file
+class MappedFile {
+public:
+    /// Map the specified file into memory
+    MappedFile(const std::string &filename);
+
+    /// Unmap the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// Return a pointer to the contents of the file
+    const char *getData() const { return m_data; }
+
+    /// Return the size of the file in bytes
+    size_t getSize() const { return m_size; }
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void *m_file = nullptr, *m_mapping = nullptr;
+#endif
+};
+
+/**
+ * \brief Scalar density grid backed by a memory-mapped volume file, with
+ * a coarse grid of majorants for free-path sampling
+ *
+ * Two formats are supported (little-endian throughout):
+ *
+ * - Dense grids in the format of Mitsuba's \c gridvolume: the bytes
+ *   <tt>VOL</tt> and the version 3, the encoding (int32, 1 = float32), the
+ *   resolution (3 x int32) and channel count (int32, 1), the bounding box
+ *   (min. and max., 6 x float32) and the voxels, with x varying fastest.
+ * - Sparse bricks: the bytes <tt>NVB</tt> and the version 1, the resolution
+ *   (3 x int32), the edge length of a brick in voxels (int32), the bounding
+ *   box (6 x float32) and the number of stored bricks (int32). This is
+ *   followed by one int32 per brick of the grid (x fastest), which is the
+ *   index of its stored brick or -1 if the brick is empty, and finally the
+ *   voxels of the stored bricks (x fastest within a brick).
+ *
+ * The voxels are read directly from the mapping, hence only the parts of
+ * the file that rays actually pass through are paged in. Densities are
+ * interpolated trilinearly between the voxel centers.
+ *
+ * Positions are given in grid coordinates, where voxel <tt>(i, j, k)</tt>
+ * covers <tt>[i, i+1] x [j, j+1] x [k, k+1]</tt>. The majorant grid holds
+ * the maximum density of every block of \ref MajorantCellSize^3 voxels,
+ * including the neighboring voxels that the interpolation reaches.
+ */
+class DensityGrid {
+public:
+    /// Edge length of a majorant cell in voxels
+    static const int MajorantCellSize = 8;
+
+    /// Load a volume file and compute the majorant grid
+    DensityGrid(const std::string &filename);
+
+    /// Return the resolution of the grid in voxels
+    const Vector3i &getResolution() const { return m_res; }
+
+    /// Return the bounding box of the grid as specified by the file
+    const BoundingBox3f &getBoundingBox() const { return m_bbox; }
+
+    /// Return the largest density of the grid
+    float getMaxDensity() const { return m_maxDensity; }
+
+    /// Return the density of a voxel (coordinates are clamped to the grid)
+    float voxel(int x, int y, int z) const {
+        x = clamp(x, 0, m_res.x() - 1);
+        y = clamp(y, 0, m_res.y() - 1);
+        z = clamp(z, 0, m_res.z() - 1);
+        if (!m_brickIndex)
+            return m_voxels[((size_t) z * m_res.y() + y) * m_res.x() + x];
+
+        int brick = m_brickIndex[((size_t) (z / m_brickSize) * m_brickRes.y() + y / m_brickSize)
+            * m_brickRes.x() + x / m_brickSize];
+        if (brick < 0)
+            return 0.f;
+        return m_voxels[(size_t) brick * m_brickSize * m_brickSize * m_brickSize
+            + ((size_t) (z % m_brickSize) * m_brickSize + y % m_brickSize) * m_brickSize + x % m_brickSize];
+    }
+
+    /// Return the interpolated density at a position in grid coordinates
+    float lookup(const Point3f &p) const;
+
+    /**
+     * \brief Traverse the majorant cells along a ray in grid coordinates
+     * (3D-DDA of Amanatides and Woo)
+     *
+     * \c func is called with the ray segment <tt>[t0, t1]</tt> of every cell
+     * within <tt>[mint, maxt]</tt> in front-to-back order, and its majorant.
+     * The traversal stops early when \c func returns false.
+     */
+    template <typename Func> void traverse(const Point3f &o, const Vector3f &d,
+                                           float mint, float maxt, const Func &func) const {
+        BoundingBox3f bounds(Point3f(0.f), m_res.cast<float>());
+        float nearT, farT;
+        if (!bounds.rayIntersect(Ray3f(o, d, mint, maxt), nearT, farT))
+            return;
+        mint = std::max(mint, nearT);
+        maxt = std::min(maxt, farT);
+        if (!(mint < maxt))
+            return;
+
+        const float size = (float) MajorantCellSize;
+        Point3f p = o + mint * d;
+        Vector3i cell, step, exit;
+        Vector3f nextT, deltaT;
+        for (int i = 0; i < 3; ++i) {
+            cell[i] = clamp((int) (p[i] / size), 0, m_cellRes[i] - 1);
+            if (d[i] == 0) {
+                nextT[i] = std::numeric_limits<float>::infinity();
+                deltaT[i] = 0.f;
+                step[i] = 0;
+                exit[i] = -1;
+            } else if (d[i] > 0) {
+                nextT[i] = mint + ((cell[i] + 1) * size - p[i]) / d[i];
+                deltaT[i] = size / d[i];
+                step[i] = 1;
+                exit[i] = m_cellRes[i];
+            } else {
+                nextT[i] = mint + (cell[i] * size - p[i]) / d[i];
+                deltaT[i] = -size / d[i];
+                step[i] = -1;
+                exit[i] = -1;
+            }
+        }
+
+        float t = mint;
+        while (t < maxt) {
+            int axis = nextT.x() < nextT.y()
+                ? (nextT.x() < nextT.z() ? 0 : 2) : (nextT.y() < nextT.z() ? 1 : 2);
+            float t1 = std::min(nextT[axis], maxt);
+            if (t1 > t && !func(t, t1, m_majorants[((size_t) cell.z() * m_cellRes.y()
+                    + cell.y()) * m_cellRes.x() + cell.x()]))
+                return;
+            t = t1;
+            cell[axis] += step[axis];
+            if (cell[axis] == exit[axis])
+                return;
+            nextT[axis] += deltaT[axis];
+        }
+    }
+
+    /// Return a human-readable string summary
+    std::string toString() const;
+
+private:
+    void computeMajorants();
+
+    std::string m_filename;
+    std::unique_ptr<MappedFile> m_file;
+    Vector3i m_res;
+    BoundingBox3f m_bbox;
+    const float *m_voxels = nullptr;
+
+    /// Sparse bricks (\c m_brickIndex is null for dense grids)
+    const int32_t *m_brickIndex = nullptr;
+    int m_brickSize = 0;
+    Vector3i m_brickRes = Vector3i(0);
+
+    Vector3i m_cellRes;
+    std::vector<float> m_majorants;
+    float m_maxDensity = 0.f;
+};
+
+NORI_NAMESPACE_END
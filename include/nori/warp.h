@@ -101,6 +101,19 @@ public:
 
 	static float squareToHenyeyGreensteinPdf(const Vector3f &v, float g);
 
+	/**
+	 * \brief Map a point of the unit square to the unit sphere using the
+	 * equal-area octahedral mapping (Clarberg 2008)
+	 *
+	 * Regions of the square and their images on the sphere have
+	 * proportional areas, hence uniform samples are mapped to uniformly
+	 * distributed directions (with density 1/(4 pi)).
+	 */
+	static Vector3f squareToEqualAreaSphere(const Point2f &sample);
+
+	/// Inverse of \ref squareToEqualAreaSphere() (the argument must be normalized)
+	static Point2f equalAreaSphereToSquare(const Vector3f &v);
+
 
 };
 
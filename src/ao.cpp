@@ -22,7 +22,7 @@ public:
 		/* for a sample ambient light source, add the illumination */
 		Vector3f light = Warp::squareToCosineHemisphere(sampler->next2D());
 		Vector3f worldLight = its.toWorld(light);
-		if (VisibilityTester(scene, its, &worldLight)) {
+		if (VisibilityTester(scene, its, &worldLight, ray.time)) {
 			float cosTheta = Frame::cosTheta(light);
 			result += cosTheta / M_PI;
 		}
@@ -31,8 +31,9 @@ public:
 	}
 
 	/// check the visibility of the point being rendered, is it not in shadow? 
-	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir) const {
+	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float time) const {
 		Ray3f ray(its.p, *dir);
+		ray.time = time;
 		// Ray3f ray(TRay<Point3f, Vector3f>(its.p, *dir), Epsilon, INFINITY);
 		return !scene->rayIntersect(ray);
 	}
@@ -0,0 +1,52 @@
+#include <nori/aov.h>
+#include <nori/integrator.h>
+#include <nori/scene.h>
+#include <nori/bsdf.h>
+#include <nori/sampler.h>
+
+NORI_NAMESPACE_BEGIN
+
+void AOVRecord::setSurface(const Ray3f &ray, const Intersection &its) {
+    normal = its.shFrame.n;
+    depth = its.t * ray.d.norm();
+    meshId = (int) its.meshIndex;
+    primitiveId = (int) its.primIndex;
+}
+
+void AOVRecord::trace(const Scene *scene, const Ray3f &ray, const Point2f &sample) {
+    Intersection its;
+    if (!scene->rayIntersect(ray, its))
+        return;
+    setSurface(ray, its);
+
+    BSDFQueryRecord bRec(its.toLocal(-ray.d));
+    bRec.uv = its.uv;
+    bRec.p = its.p;
+    albedo = its.mesh->getBSDF()->sample(bRec, sample);
+}
+
+Color3f Integrator::LiAOV(const Scene *scene, Sampler *sampler, const Ray3f &ray, AOVRecord &aov) const {
+    Color3f value = Li(scene, sampler, ray);
+    aov.trace(scene, ray, sampler->next2D());
+    return value;
+}
+
+void PixelIDs::init(const Vector2i &size) {
+    size_t n = (size_t) size.x() * size.y();
+    m_size = size;
+    m_meshIds.assign(n, -1);
+    m_primitiveIds.assign(n, -1);
+}
+
+void AOVImages::save(Bitmap &image, const std::string &filename) const {
+    image.save(filename, {
+        { "albedo", &albedo, { "R", "G", "B" } },
+        { "normal", &normal, { "X", "Y", "Z" } },
+        { "depth", &depth, { "Z" } },
+        { "id", &ids, { "mesh", "primitive" } },
+        { "sampleCount", &sampleCount, { "Y" } },
+        { "variance", &variance, { "Y" } }
+    });
+}
+
+NORI_NAMESPACE_END
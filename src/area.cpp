@@ -6,6 +6,7 @@
 #include <nori/emitter.h>
 #include <nori/mesh.h>
 #include <nori/warp.h>
+#include <nori/lightbvh.h>
 
 NORI_NAMESPACE_BEGIN
 
@@ -42,6 +43,61 @@ public:
 		return m_mesh->pdf() * lRec.dist * lRec.dist / fabs(lRec.n.dot(-lRec.wi));
     }
 
+	/// Uniformly distributed position, cosine-weighted direction around its normal
+	Color3f samplePhoton(Ray3f &ray, Normal3f &n, const Point2f &sample1, const Point2f &sample2) const {
+		Point3f p;
+		m_mesh->samplePosition(sample1, p, n);
+		ray = Ray3f(p, Frame(n).toWorld(Warp::squareToCosineHemisphere(sample2)));
+		return power();
+	}
+
+	void pdfPhoton(const EmitterQueryRecord &lRec, float &pdfPos, float &pdfDir) const {
+		pdfPos = m_mesh->pdf();
+		pdfDir = std::max(0.0f, lRec.n.dot(-lRec.wi)) * INV_PI;
+	}
+
+	/// One-sided Lambertian emission: radiance times pi times the surface area
+	Color3f power() const {
+		return m_radiance * M_PI / m_mesh->pdf();
+	}
+
+	bool getLightBounds(LightBounds &bounds) const {
+		const MatrixXf &V = m_mesh->getVertexPositions();
+		const MatrixXf &N = m_mesh->getVertexNormals();
+		const MatrixXu &F = m_mesh->getIndices();
+
+		/* Both the geometric and the interpolated shading normals can
+		   appear as the emitter normal */
+		std::vector<Vector3f> normals;
+		Vector3f axis(0.0f);
+		bounds.bounds.reset();
+		for (uint32_t i = 0; i < m_mesh->getTriangleCount(); ++i) {
+			bounds.bounds.expandBy(m_mesh->getBoundingBox(i));
+			Vector3f p0 = V.col(F(0, i)), p1 = V.col(F(1, i)), p2 = V.col(F(2, i));
+			Vector3f n = (p1 - p0).cross(p2 - p0);
+			if (n.squaredNorm() > 0) {
+				axis += n;
+				normals.push_back(n.normalized());
+			}
+		}
+		for (int i = 0; i < N.cols(); ++i)
+			normals.push_back(Vector3f(N.col(i)).normalized());
+
+		bounds.cosThetaO = -1.0f;
+		bounds.axis = Vector3f(0.0f, 0.0f, 1.0f);
+		if (axis.squaredNorm() > 0) {
+			bounds.axis = axis.normalized();
+			bounds.cosThetaO = 1.0f;
+			for (const Vector3f &n : normals)
+				bounds.cosThetaO = std::min(bounds.cosThetaO, bounds.axis.dot(n));
+		}
+
+		/* One-sided emission into the hemisphere around the normal */
+		bounds.cosThetaE = 0.0f;
+		bounds.phi = power().getLuminance();
+		return true;
+	}
+
 	void setParent(NoriObject *object) {
 		if (object->getClassType() != EMesh)
 			throw NoriException("AreaEmitter: attached to a non-mesh object!");
@@ -0,0 +1,551 @@
+#include <nori/integrator.h>
+#include <nori/sampler.h>
+#include <nori/emitter.h>
+#include <nori/camera.h>
+#include <nori/bsdf.h>
+#include <nori/scene.h>
+#include <nori/block.h>
+#include <nori/photon.h>
+
+NORI_NAMESPACE_BEGIN
+
+/// Assigns a new value to a variable and restores the old one when going out of scope
+template <typename T> class ScopedAssignment {
+public:
+    /// Does nothing if \c target is \c nullptr
+    ScopedAssignment(T *target, const T &value) : m_target(target) {
+        if (m_target) {
+            m_backup = *m_target;
+            *m_target = value;
+        }
+    }
+
+    ~ScopedAssignment() {
+        if (m_target)
+            *m_target = m_backup;
+    }
+
+    ScopedAssignment(const ScopedAssignment &) = delete;
+    ScopedAssignment &operator=(const ScopedAssignment &) = delete;
+private:
+    T *m_target;
+    T m_backup;
+};
+
+/**
+ * \brief Bidirectional path tracer (Veach 1997)
+ *
+ * Every pixel sample traces a camera subpath and a light subpath, and
+ * every pair of their prefixes is combined into a full path. The resulting
+ * strategies for a path with \c s light and \c t camera vertices are
+ * - <tt>s = 0</tt>: the camera subpath hits an emitter,
+ * - <tt>s = 1</tt>: emitter sampling at the last camera subpath vertex,
+ * - <tt>t = 1</tt>: light tracing, i.e. connecting the last light subpath
+ *   vertex to the camera (see \ref Camera::sampleDirection()). These
+ *   contributions land on arbitrary pixels and are splatted into the
+ *   \ref SplatFilm provided by the renderer, without any lock.
+ * - otherwise, the last vertices of both subpaths are connected by a shadow ray.
+ *
+ * All strategies that can generate a path are combined with multiple
+ * importance sampling (balance heuristic). Light subpaths start at an
+ * emitter chosen proportionally to its power (see \ref PhotonEmission),
+ * and so do the emitter samples of <tt>s = 1</tt>, since the weights
+ * assume that both strategies choose emitters with the same probability.
+ * Participating media are ignored.
+ */
+class BDPT : public Integrator {
+public:
+    BDPT(const PropertyList &propList) {
+        /* Maximum number of bounces of the combined paths */
+        m_maxDepth = propList.getInteger("maxDepth", 10);
+        /* Number of bounces before Russian roulette starts on the subpaths */
+        m_rrDepth = propList.getInteger("rrDepth", 5);
+    }
+
+    void preprocess(const Scene *scene) {
+        m_emission.reset(new PhotonEmission(scene));
+    }
+
+    bool isSplatting() const { return true; }
+
+    void setSplatFilm(SplatFilm *film) { m_splats = film; }
+
+    Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &ray) const {
+        std::vector<Vertex> camera, light;
+        camera.reserve(m_maxDepth + 2);
+        light.reserve(m_maxDepth + 1);
+        generateCameraSubpath(scene, sampler, ray, camera);
+        generateLightSubpath(scene, sampler, ray.time, light);
+
+        Color3f result(0.0f);
+        for (int t = 1; t <= (int) camera.size(); ++t) {
+            for (int s = 0; s <= (int) light.size(); ++s) {
+                /* Emitters seen directly are only found by the camera subpath */
+                int depth = s + t - 2;
+                if ((s == 1 && t == 1) || depth < 0 || depth > m_maxDepth)
+                    continue;
+                if (t == 1 && !m_splats)
+                    continue;
+
+                Point2f pixel;
+                Color3f value = connect(scene, sampler, light, camera, s, t, ray.time, pixel);
+                if (t == 1) {
+                    if ((value.array() != 0).any())
+                        m_splats->splat(pixel, value);
+                } else {
+                    result += value;
+                }
+            }
+        }
+        return result;
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "BDPT[\n"
+            "  maxDepth = %i,\n"
+            "  rrDepth = %i\n"
+            "]",
+            m_maxDepth, m_rrDepth);
+    }
+
+protected:
+    enum EVertexType {
+        ECameraVertex = 0,
+        /// Point on an emitter with a position (area emitter or point light)
+        ELightVertex,
+        /// Direction towards the environment emitter
+        EEnvironmentVertex,
+        ESurfaceVertex
+    };
+
+    /// Vertex of a camera or light subpath
+    struct Vertex {
+        EVertexType type;
+        /// Throughput of the subpath up to this vertex
+        Color3f beta;
+        /// Density of sampling the vertex from its predecessor (per unit area, or solid angle for the environment)
+        float pdfFwd = 0.0f;
+        /// Density of sampling the vertex from its successor, i.e. in the reverse direction
+        float pdfRev = 0.0f;
+        /// Was the direction towards the successor sampled from a discrete distribution?
+        bool delta = false;
+        Point3f p;
+        /// Geometric normal of vertices on surfaces. For the environment: the direction of the emitted light
+        Normal3f n = Normal3f(0.0f);
+        /// Surface vertices: intersection and direction towards the predecessor (local coordinates)
+        Intersection its;
+        Vector3f wi;
+        /// Emitter of light vertices and of surface vertices on emitters
+        const Emitter *emitter = nullptr;
+
+        bool isOnSurface() const {
+            return type == ESurfaceVertex || (type == ELightVertex && !emitter->isPointEmitter());
+        }
+
+        bool isLight() const {
+            return type == ELightVertex || type == EEnvironmentVertex
+                || (type == ESurfaceVertex && emitter);
+        }
+
+        /// Normal that determines the cosine factors of connections
+        Normal3f ns() const { return type == ESurfaceVertex ? its.shFrame.n : n; }
+    };
+
+    void generateCameraSubpath(const Scene *scene, Sampler *sampler, const Ray3f &ray,
+                               std::vector<Vertex> &path) const {
+        Vertex vertex;
+        vertex.type = ECameraVertex;
+        vertex.beta = Color3f(1.0f);
+        vertex.p = ray.o;
+        path.push_back(vertex);
+
+        float pdfPos, pdfDir;
+        scene->getCamera()->pdf(ray, pdfPos, pdfDir);
+        randomWalk(scene, sampler, ray, Color3f(1.0f), pdfDir, m_maxDepth + 1, true, path);
+    }
+
+    void generateLightSubpath(const Scene *scene, Sampler *sampler, float time,
+                              std::vector<Vertex> &path) const {
+        float emitterPdf;
+        const Emitter *emitter = m_emission->sampleEmitter(sampler->next1D(), emitterPdf);
+        Point2f positionSample = sampler->next2D();
+        Point2f directionSample = sampler->next2D();
+        Ray3f ray;
+        Normal3f n;
+        Color3f weight = emitter->samplePhoton(ray, n, positionSample, directionSample);
+        if ((weight.array() == 0).all())
+            return;
+        ray.time = time;
+
+        float pdfPos, pdfDir;
+        emitter->pdfPhoton(EmitterQueryRecord(emitter, ray.o + ray.d, ray.o, n), pdfPos, pdfDir);
+
+        /* The throughput of the first vertex is never used, since
+           connections to emitters sample a new position */
+        Vertex vertex;
+        vertex.emitter = emitter;
+        vertex.p = ray.o;
+        if (emitter->isEnvironmentEmitter()) {
+            vertex.type = EEnvironmentVertex;
+            vertex.n = Normal3f(ray.d);
+            vertex.pdfFwd = emitterPdf * pdfDir;
+        } else {
+            vertex.type = ELightVertex;
+            vertex.n = n;
+            vertex.pdfFwd = emitterPdf * pdfPos;
+        }
+        vertex.beta = Color3f(0.0f);
+        path.push_back(vertex);
+
+        randomWalk(scene, sampler, ray, weight / emitterPdf, pdfDir, m_maxDepth, false, path);
+
+        /* Photons from the environment travel along parallel rays, hence the
+           position on the disk determines the density of the first hit */
+        if (vertex.type == EEnvironmentVertex && path.size() > 1)
+            path[1].pdfFwd = pdfPos * std::abs(path[1].n.dot(ray.d));
+    }
+
+    /**
+     * \brief Extend a subpath by sampling the BSDFs of its vertices
+     *
+     * \param pdf
+     *    Solid angle density of the direction of \c ray
+     * \param maxVertices
+     *    Maximum number of vertices that are appended
+     * \param radiance
+     *    Is this a camera subpath (otherwise, the subpath transports importance)?
+     */
+    void randomWalk(const Scene *scene, Sampler *sampler, Ray3f ray, Color3f beta, float pdf,
+                    int maxVertices, bool radiance, std::vector<Vertex> &path) const {
+        float pdfFwd = pdf;
+        for (int bounces = 0; bounces < maxVertices; ++bounces) {
+            Vertex vertex;
+            vertex.beta = beta;
+            Intersection its;
+            if (!scene->rayIntersect(ray, its)) {
+                /* Camera subpaths end on the environment emitter */
+                if (radiance && scene->hasEnvEmitter()) {
+                    vertex.type = EEnvironmentVertex;
+                    vertex.emitter = scene->getEnvEmitter();
+                    vertex.p = ray.o + ray.d;
+                    vertex.n = Normal3f(-ray.d);
+                    vertex.pdfFwd = pdfFwd;
+                    path.push_back(vertex);
+                }
+                break;
+            }
+
+            vertex.type = ESurfaceVertex;
+            vertex.its = its;
+            vertex.p = its.p;
+            vertex.n = its.geoFrame.n;
+            vertex.wi = its.toLocal(-ray.d);
+            vertex.emitter = its.mesh->isEmitter() ? its.mesh->getEmitter() : nullptr;
+            vertex.pdfFwd = convertDensity(path.back(), pdfFwd, vertex);
+            path.push_back(vertex);
+            if (bounces + 1 >= maxVertices)
+                break;
+
+            const BSDF *bsdf = its.mesh->getBSDF();
+            BSDFQueryRecord bRec(vertex.wi);
+            bRec.uv = its.uv;
+            bRec.p = its.p;
+            Color3f f = bsdf->sample(bRec, sampler->next2D());
+            if ((f.array() == 0).all())
+                break;
+            Vector3f wo = its.toWorld(bRec.wo);
+
+            float pdfRev;
+            if (bRec.measure == EDiscrete) {
+                path.back().delta = true;
+                pdfFwd = pdfRev = 0.0f;
+            } else {
+                pdfFwd = bsdf->pdf(bRec);
+                BSDFQueryRecord rRec(bRec.wo, bRec.wi, ESolidAngle);
+                rRec.uv = its.uv;
+                rRec.p = its.p;
+                pdfRev = bsdf->pdf(rRec);
+            }
+
+            beta *= f;
+            if (!radiance)
+                beta *= shadingNormalCorrection(its, -ray.d, wo);
+            path[path.size() - 2].pdfRev = convertDensity(path.back(), pdfRev, path[path.size() - 2]);
+
+            if (bounces >= m_rrDepth) {
+                float q = std::min(f.maxCoeff(), 0.99f);
+                if (sampler->next1D() >= q)
+                    break;
+                beta /= q;
+            }
+
+            float time = ray.time;
+            ray = Ray3f(its.p, wo);
+            ray.time = time;
+        }
+    }
+
+    /**
+     * \brief Compute the contribution of the path with \c s light and \c t
+     * camera subpath vertices, including its MIS weight
+     *
+     * \param pixel
+     *    Returns the position on the film for light tracing (<tt>t = 1</tt>)
+     */
+    Color3f connect(const Scene *scene, Sampler *sampler, std::vector<Vertex> &light,
+                    std::vector<Vertex> &camera, int s, int t, float time, Point2f &pixel) const {
+        const Vertex &pt = camera[t - 1];
+        if (t > 1 && s != 0 && pt.type == EEnvironmentVertex)
+            return Color3f(0.0f);
+
+        Color3f value(0.0f);
+        Vertex sampled;
+        if (s == 0) {
+            /* The camera subpath hits an emitter */
+            if (!pt.isLight())
+                return Color3f(0.0f);
+            value = pt.beta * Le(pt, camera[t - 2]);
+        } else if (t == 1) {
+            /* Connect the light subpath to the camera */
+            const Vertex &qs = light[s - 1];
+            CameraQueryRecord cRec(qs.p);
+            Color3f importance = scene->getCamera()->sampleDirection(cRec, sampler->next2D());
+            if ((importance.array() == 0).all())
+                return Color3f(0.0f);
+
+            sampled.type = ECameraVertex;
+            sampled.beta = importance;
+            sampled.p = cRec.p;
+            pixel = cRec.pixel;
+            value = qs.beta * f(qs, sampled, false) * importance * std::abs(cRec.wi.dot(qs.ns()));
+            if ((value.array() != 0).any() && !isVisible(scene, qs.p, cRec.p, time))
+                return Color3f(0.0f);
+        } else if (s == 1) {
+            /* Emitter sampling at the last vertex of the camera subpath. The emitter
+               is chosen like the origin of a light subpath (not by scene->sampleDirect()),
+               which is the density that pdfLightOrigin() assumes. */
+            float emitterSample = sampler->next1D();
+            Point2f positionSample = sampler->next2D();
+            float emitterPdf;
+            const Emitter *emitter = m_emission->sampleEmitter(emitterSample, emitterPdf);
+            if (emitterPdf <= 0)
+                return Color3f(0.0f);
+            EmitterQueryRecord lRec(pt.p);
+            lRec.emitter = emitter;
+            Color3f direct = emitter->sample(lRec, positionSample) / emitterPdf;
+            if ((direct.array() == 0).all())
+                return Color3f(0.0f);
+
+            sampled.emitter = lRec.emitter;
+            if (lRec.emitter->isEnvironmentEmitter()) {
+                sampled.type = EEnvironmentVertex;
+                sampled.p = pt.p + lRec.wi;
+                sampled.n = Normal3f(-lRec.wi);
+            } else {
+                sampled.type = ELightVertex;
+                sampled.p = lRec.p;
+                sampled.n = lRec.emitter->isPointEmitter() ? Normal3f(0.0f) : lRec.n;
+            }
+            sampled.beta = direct;
+            sampled.pdfFwd = pdfLightOrigin(sampled, pt);
+            value = pt.beta * f(pt, sampled, true) * direct * std::abs(lRec.wi.dot(pt.ns()));
+            if ((value.array() != 0).any()) {
+                Ray3f shadowRay(pt.p, lRec.wi, Epsilon, lRec.dist - Epsilon);
+                shadowRay.time = time;
+                if (scene->rayIntersect(shadowRay))
+                    return Color3f(0.0f);
+            }
+        } else {
+            /* Connect the last vertices of both subpaths */
+            const Vertex &qs = light[s - 1];
+            value = qs.beta * f(qs, pt, false) * f(pt, qs, true) * pt.beta;
+            if ((value.array() != 0).any()) {
+                Vector3f d = qs.p - pt.p;
+                float dist2 = d.squaredNorm();
+                d /= std::sqrt(dist2);
+                value *= std::abs(qs.ns().dot(d)) * std::abs(pt.ns().dot(d)) / dist2;
+                if (!isVisible(scene, pt.p, qs.p, time))
+                    return Color3f(0.0f);
+            }
+        }
+
+        if ((value.array() == 0).all())
+            return Color3f(0.0f);
+        return value * misWeight(scene, light, camera, sampled, s, t);
+    }
+
+    /**
+     * \brief Balance heuristic weight of the strategy with \c s light and
+     * \c t camera vertices among all strategies that generate the same path
+     *
+     * Follows the iterative formulation of Veach, where the densities of
+     * the other strategies are obtained from ratios of the forward and
+     * reverse densities of the vertices.
+     */
+    float misWeight(const Scene *scene, std::vector<Vertex> &light, std::vector<Vertex> &camera,
+                    const Vertex &sampled, int s, int t) const {
+        if (s + t == 2)
+            return 1.0f;
+
+        /* Substitute the vertex that was sampled for the connection */
+        ScopedAssignment<Vertex> a1(s == 1 ? &light[0] : nullptr, sampled);
+        ScopedAssignment<Vertex> a2(t == 1 ? &camera[0] : nullptr, sampled);
+
+        Vertex *qs = s > 0 ? &light[s - 1] : nullptr, *pt = &camera[t - 1];
+        Vertex *qsMinus = s > 1 ? &light[s - 2] : nullptr, *ptMinus = t > 1 ? &camera[t - 2] : nullptr;
+
+        /* The connection vertices are never degenerate, and their reverse
+           densities (and those of their predecessors) follow from the connection */
+        ScopedAssignment<bool> a3(&pt->delta, false);
+        ScopedAssignment<bool> a4(qs ? &qs->delta : nullptr, false);
+        ScopedAssignment<float> a5(&pt->pdfRev, s > 0
+            ? pdfVertex(scene, *qs, qsMinus, *pt) : pdfLightOrigin(*pt, *ptMinus));
+        ScopedAssignment<float> a6(ptMinus ? &ptMinus->pdfRev : nullptr, !ptMinus ? 0.0f
+            : (s > 0 ? pdfVertex(scene, *pt, qs, *ptMinus) : pdfLight(*pt, *ptMinus)));
+        ScopedAssignment<float> a7(qs ? &qs->pdfRev : nullptr,
+            qs ? pdfVertex(scene, *pt, ptMinus, *qs) : 0.0f);
+        ScopedAssignment<float> a8(qsMinus ? &qsMinus->pdfRev : nullptr,
+            qsMinus ? pdfVertex(scene, *qs, pt, *qsMinus) : 0.0f);
+
+        /* Densities of delta distributions are stored as zero */
+        auto remap0 = [](float f) { return f != 0 ? f : 1.0f; };
+
+        float sumRi = 0.0f, ri = 1.0f;
+        for (int i = t - 1; i > 0; --i) {
+            ri *= remap0(camera[i].pdfRev) / remap0(camera[i].pdfFwd);
+            if (!camera[i].delta && !camera[i - 1].delta)
+                sumRi += ri;
+        }
+
+        ri = 1.0f;
+        for (int i = s - 1; i >= 0; --i) {
+            ri *= remap0(light[i].pdfRev) / remap0(light[i].pdfFwd);
+            bool deltaLight = i > 0 ? light[i - 1].delta
+                : light[0].type == ELightVertex && light[0].emitter->isPointEmitter();
+            if (!light[i].delta && !deltaLight)
+                sumRi += ri;
+        }
+
+        return 1.0f / (1.0f + sumRi);
+    }
+
+    /// Direction from one vertex towards another
+    static Vector3f direction(const Vertex &from, const Vertex &to) {
+        if (to.type == EEnvironmentVertex)
+            return Vector3f(-to.n);
+        return (to.p - from.p).normalized();
+    }
+
+    /// Convert a solid angle density at \c from into a density per unit area at \c to
+    static float convertDensity(const Vertex &from, float pdf, const Vertex &to) {
+        if (to.type == EEnvironmentVertex)
+            return pdf;
+        Vector3f w = to.p - from.p;
+        float dist2 = w.squaredNorm();
+        if (dist2 == 0)
+            return 0.0f;
+        pdf /= dist2;
+        if (to.isOnSurface())
+            pdf *= std::abs(to.n.dot(w)) / std::sqrt(dist2);
+        return pdf;
+    }
+
+    /**
+     * \brief Density of sampling \c next from \c v, when \c v was reached
+     * from \c prev (which is only needed for surface vertices)
+     */
+    float pdfVertex(const Scene *scene, const Vertex &v, const Vertex *prev, const Vertex &next) const {
+        if (v.type == ELightVertex || v.type == EEnvironmentVertex)
+            return pdfLight(v, next);
+
+        Vector3f wn = direction(v, next);
+        float pdf;
+        if (v.type == ECameraVertex) {
+            float pdfPos;
+            scene->getCamera()->pdf(Ray3f(v.p, wn), pdfPos, pdf);
+        } else {
+            BSDFQueryRecord bRec(v.its.toLocal(direction(v, *prev)), v.its.toLocal(wn), ESolidAngle);
+            bRec.uv = v.its.uv;
+            bRec.p = v.its.p;
+            pdf = v.its.mesh->getBSDF()->pdf(bRec);
+        }
+        return convertDensity(v, pdf, next);
+    }
+
+    /// Density of a light subpath leaving the emitter vertex \c v towards \c next
+    float pdfLight(const Vertex &v, const Vertex &next) const {
+        float pdfPos, pdfDir;
+        if (v.type == EEnvironmentVertex) {
+            /* Parallel rays through a disk covering the scene */
+            v.emitter->pdfPhoton(EmitterQueryRecord(v.emitter, Ray3f(next.p, Vector3f(-v.n))), pdfPos, pdfDir);
+            return next.isOnSurface() ? pdfPos * std::abs(next.n.dot(v.n)) : pdfPos;
+        }
+
+        v.emitter->pdfPhoton(EmitterQueryRecord(v.emitter, next.p, v.p, v.ns()), pdfPos, pdfDir);
+        return convertDensity(v, pdfDir, next);
+    }
+
+    /// Density of a light subpath starting at the emitter vertex \c v (seen from \c next)
+    float pdfLightOrigin(const Vertex &v, const Vertex &next) const {
+        float emitterPdf = m_emission->pdfEmitter(v.emitter);
+        if (v.type == EEnvironmentVertex)
+            return emitterPdf * v.emitter->pdf(EmitterQueryRecord(v.emitter, Ray3f(next.p, Vector3f(-v.n))));
+
+        float pdfPos, pdfDir;
+        v.emitter->pdfPhoton(EmitterQueryRecord(v.emitter, next.p, v.p, v.ns()), pdfPos, pdfDir);
+        return emitterPdf * pdfPos;
+    }
+
+    /// Radiance emitted from the emitter vertex \c v towards \c prev
+    Color3f Le(const Vertex &v, const Vertex &prev) const {
+        if (v.type == EEnvironmentVertex)
+            return v.emitter->eval(EmitterQueryRecord(v.emitter, Ray3f(prev.p, Vector3f(-v.n))));
+        return v.emitter->eval(EmitterQueryRecord(v.emitter, prev.p, v.p, v.ns()));
+    }
+
+    /// BSDF of the surface vertex \c v for scattering towards \c next
+    Color3f f(const Vertex &v, const Vertex &next, bool radiance) const {
+        if (v.type != ESurfaceVertex)
+            return Color3f(0.0f);
+        Vector3f wo = direction(v, next);
+        BSDFQueryRecord bRec(v.wi, v.its.toLocal(wo), ESolidAngle);
+        bRec.uv = v.its.uv;
+        bRec.p = v.its.p;
+        Color3f value = v.its.mesh->getBSDF()->eval(bRec);
+        if (!radiance)
+            value *= shadingNormalCorrection(v.its, v.its.toWorld(v.wi), wo);
+        return value;
+    }
+
+    /**
+     * \brief Correction of the adjoint BSDF for importance transport with
+     * shading normals (Veach 1997, Section 5.3)
+     *
+     * \param wo  Direction towards the previous vertex of the light subpath
+     * \param wi  Direction towards the next vertex of the light subpath
+     */
+    static float shadingNormalCorrection(const Intersection &its, const Vector3f &wo, const Vector3f &wi) {
+        float denominator = std::abs(wo.dot(its.geoFrame.n)) * std::abs(wi.dot(its.shFrame.n));
+        if (denominator == 0)
+            return 0.0f;
+        return std::abs(wo.dot(its.shFrame.n)) * std::abs(wi.dot(its.geoFrame.n)) / denominator;
+    }
+
+    /// Is the segment between two points unoccluded?
+    static bool isVisible(const Scene *scene, const Point3f &p0, const Point3f &p1, float time) {
+        Vector3f d = p1 - p0;
+        float dist = d.norm();
+        Ray3f shadowRay(p0, d / dist, Epsilon, dist - Epsilon);
+        shadowRay.time = time;
+        return !scene->rayIntersect(shadowRay);
+    }
+
+    int m_maxDepth;
+    int m_rrDepth;
+    std::unique_ptr<PhotonEmission> m_emission;
+    SplatFilm *m_splats = nullptr;
+};
+
+NORI_REGISTER_CLASS(BDPT, "bdpt");
+NORI_NAMESPACE_END
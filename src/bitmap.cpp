@@ -79,7 +79,45 @@ Bitmap::Bitmap(const std::string &filename) {
     file.readPixels(dw.min.y, dw.max.y);
 }
 
+Bitmap::Bitmap(const std::string &filename, const std::vector<std::string> &channelNames) {
+    if (channelNames.empty() || channelNames.size() > 3)
+        throw NoriException("Bitmap: expected one to three channel names");
+
+    Imf::InputFile file(filename.c_str());
+    const Imf::ChannelList &channels = file.header().channels();
+    for (auto const &name : channelNames) {
+        if (!channels.findChannel(name.c_str()))
+            throw NoriException("\"%s\" has no channel \"%s\"", filename, name);
+    }
+
+    Imath::Box2i dw = file.header().dataWindow();
+    resize(dw.max.y - dw.min.y + 1, dw.max.x - dw.min.x + 1);
+    setConstant(Color3f(0.f));
+
+    size_t compStride = sizeof(float),
+           pixelStride = 3 * compStride,
+           rowStride = pixelStride * cols();
+
+    char *ptr = reinterpret_cast<char *>(data());
+    Imf::FrameBuffer frameBuffer;
+    for (size_t i = 0; i < channelNames.size(); ++i)
+        frameBuffer.insert(channelNames[i].c_str(),
+            Imf::Slice(Imf::FLOAT, ptr + i * compStride, pixelStride, rowStride));
+    file.setFrameBuffer(frameBuffer);
+    file.readPixels(dw.min.y, dw.max.y);
+
+    if (channelNames.size() == 1) {
+        for (int y = 0; y < rows(); ++y)
+            for (int x = 0; x < cols(); ++x)
+                coeffRef(y, x) = Color3f(coeff(y, x).r());
+    }
+}
+
 void Bitmap::save(const std::string &filename) {
+    save(filename, std::vector<BitmapLayer>());
+}
+
+void Bitmap::save(const std::string &filename, const std::vector<BitmapLayer> &layers) {
     cout << "Writing a " << cols() << "x" << rows() 
          << " OpenEXR file to \"" << filename << "\"" << endl;
 
@@ -101,6 +139,18 @@ void Bitmap::save(const std::string &filename) {
     frameBuffer.insert("G", Imf::Slice(Imf::FLOAT, ptr, pixelStride, rowStride)); ptr += compStride;
     frameBuffer.insert("B", Imf::Slice(Imf::FLOAT, ptr, pixelStride, rowStride)); 
 
+    for (auto const &layer : layers) {
+        if (layer.bitmap->cols() != cols() || layer.bitmap->rows() != rows())
+            throw NoriException("Bitmap: the layer \"%s\" has a different resolution", layer.name);
+        const char *layerPtr = reinterpret_cast<const char *>(layer.bitmap->data());
+        for (size_t i = 0; i < layer.channels.size() && i < 3; ++i) {
+            std::string name = layer.name + "." + layer.channels[i];
+            channels.insert(name, Imf::Channel(Imf::FLOAT));
+            frameBuffer.insert(name, Imf::Slice(Imf::FLOAT,
+                const_cast<char *>(layerPtr + i * compStride), pixelStride, rowStride));
+        }
+    }
+
     Imf::OutputFile file(filename.c_str(), header);
     file.setFrameBuffer(frameBuffer);
     file.writePixels((int) rows());
@@ -20,6 +20,7 @@
 #include <nori/bitmap.h>
 #include <nori/rfilter.h>
 #include <nori/bbox.h>
+#include <nori/serialization.h>
 #include <tbb/tbb.h>
 
 NORI_NAMESPACE_BEGIN
@@ -137,8 +138,196 @@ std::string ImageBlock::toString() const {
         m_offset.toString(), m_size.toString());
 }
 
+void TiledFilm::init(const Point2i &offset, const Vector2i &size,
+                     const ReconstructionFilter *filter, int tileSize) {
+    m_tiles.clear();
+    m_offset = offset;
+    m_tileSize = tileSize;
+    m_numTiles = Vector2i(
+        (size.x() + tileSize - 1) / tileSize,
+        (size.y() + tileSize - 1) / tileSize);
+
+    for (int y=0; y<m_numTiles.y(); ++y) {
+        for (int x=0; x<m_numTiles.x(); ++x) {
+            Vector2i pos(x * tileSize, y * tileSize);
+            Vector2i tileSizeClipped = (size - pos).cwiseMin(Vector2i::Constant(tileSize));
+            std::unique_ptr<Tile> tile(new Tile(tileSizeClipped, filter));
+            Point2i tileOffset = offset + pos;
+            tile->accum.setOffset(tileOffset);
+            tile->accum.setBlockId((uint32_t) m_tiles.size());
+            tile->accum.clear();
+            tile->published.setOffset(tileOffset);
+            tile->published.clear();
+            m_borderSize = tile->accum.getBorderSize();
+            m_tiles.push_back(std::move(tile));
+        }
+    }
+}
+
+void TiledFilm::commitTile(uint32_t id) {
+    Tile &tile = *m_tiles[id];
+    tile.published.lock();
+    static_cast<ImageBlock::Base &>(tile.published) = tile.accum;
+    tile.published.unlock();
+    tile.dirty = true;
+}
+
+void TiledFilm::localizeTile(uint32_t id) {
+    Tile &tile = *m_tiles[id];
+    ImageBlock::Base accum(tile.accum);
+    static_cast<ImageBlock::Base &>(tile.accum).swap(accum);
+
+    ImageBlock::Base published(tile.published);
+    tile.published.lock();
+    static_cast<ImageBlock::Base &>(tile.published).swap(published);
+    tile.published.unlock();
+}
+
+void TiledFilm::develop(ImageBlock &target) const {
+    target.clear();
+    for (auto const &tile : m_tiles) {
+        tile->published.lock();
+        target.put(tile->published);
+        tile->published.unlock();
+    }
+}
+
+void TiledFilm::develop(ImageBlock &target, const BoundingBox2i &region) const {
+    Vector2i regionSize = region.max - region.min;
+    if ((regionSize.array() <= 0).any())
+        return;
+
+    int targetBorder = target.getBorderSize();
+    target.block(region.min.y() + targetBorder, region.min.x() + targetBorder,
+                 regionSize.y(), regionSize.x()).setConstant(Color4f());
+
+    /* Range of tiles whose footprint (including the border) overlaps the region */
+    Vector2i first((((region.min - m_offset).array() - m_borderSize).max(0) / m_tileSize).matrix());
+    Vector2i last((((region.max - m_offset).array() + m_borderSize - 1) / m_tileSize).matrix());
+    last = last.cwiseMin(m_numTiles - Vector2i(1, 1));
+
+    /* Sum the tiles in the same order as the full version of develop() */
+    for (int ty = first.y(); ty <= last.y(); ++ty) {
+        for (int tx = first.x(); tx <= last.x(); ++tx) {
+            const ImageBlock &block = m_tiles[ty * m_numTiles.x() + tx]->published;
+            Point2i origin = block.getOffset() - Vector2i::Constant(m_borderSize);
+            Point2i start = origin.cwiseMax(region.min);
+            Point2i end = (origin + block.getSize() + Vector2i::Constant(2 * m_borderSize)).cwiseMin(region.max);
+            Vector2i size = end - start;
+            if ((size.array() <= 0).any())
+                continue;
+
+            block.lock();
+            target.block(start.y() + targetBorder, start.x() + targetBorder, size.y(), size.x())
+                += block.block(start.y() - origin.y(), start.x() - origin.x(), size.y(), size.x());
+            block.unlock();
+        }
+    }
+}
+
+void TiledFilm::takeDirtyTiles(std::vector<uint32_t> &ids) {
+    for (uint32_t i = 0; i < (uint32_t) m_tiles.size(); ++i) {
+        if (m_tiles[i]->dirty.exchange(false))
+            ids.push_back(i);
+    }
+}
+
+BoundingBox2i TiledFilm::getTileFootprint(uint32_t id, const Vector2i &imageSize) const {
+    const ImageBlock &block = m_tiles[id]->accum;
+    Point2i min = block.getOffset() - Vector2i::Constant(m_borderSize);
+    Point2i max = block.getOffset() + block.getSize() + Vector2i::Constant(m_borderSize);
+    return BoundingBox2i(min.cwiseMax(Point2i(0, 0)), max.cwiseMin(Point2i(imageSize)));
+}
+
+void TiledFilm::writeTile(uint32_t id, std::ostream &stream) const {
+    const ImageBlock &block = m_tiles[id]->published;
+    block.lock();
+    writeBinary(stream, block.data(), (size_t) block.size());
+    block.unlock();
+}
+
+void TiledFilm::readTile(uint32_t id, std::istream &stream) {
+    Tile &tile = *m_tiles[id];
+    readBinary(stream, tile.accum.data(), (size_t) tile.accum.size());
+    commitTile(id);
+}
+
+void SplatFilm::init(const Vector2i &size) {
+    size_t n = 3 * (size_t) size.x() * size.y();
+    m_size = size;
+    m_data.reset(new std::atomic<float>[n]);
+    for (size_t i = 0; i < n; ++i)
+        m_data[i] = 0.f;
+}
+
+void SplatFilm::develop(ImageBlock &target, float scale) const {
+    int borderSize = target.getBorderSize();
+    for (int y = 0; y < m_size.y(); ++y) {
+        for (int x = 0; x < m_size.x(); ++x) {
+            Color4f &pixel = target.coeffRef(y + borderSize, x + borderSize);
+            const std::atomic<float> *splat = &m_data[3 * ((size_t) y * m_size.x() + x)];
+            float weight = pixel.w() * scale;
+            if (weight > 0)
+                pixel += Color4f(splat[0] * weight, splat[1] * weight, splat[2] * weight, 0.f);
+        }
+    }
+}
+
+void PixelStatistics::init(const Vector2i &size) {
+    size_t n = (size_t) size.x() * size.y();
+    m_size = size;
+    m_count.assign(n, 0);
+    m_mean.assign(n, 0.f);
+    m_m2.assign(n, 0.f);
+    m_active.assign(n, 1);
+}
+
+size_t PixelStatistics::update(const Point2i &offset, const Vector2i &size,
+                               float threshold, float &errorSum) {
+    size_t active = 0;
+    errorSum = 0;
+    for (int y=offset.y(); y<offset.y() + size.y(); ++y) {
+        for (int x=offset.x(); x<offset.x() + size.x(); ++x) {
+            Point2i pixel(x, y);
+            float error = getRelativeError(pixel);
+            /* Pixels with a single sample count as fully uncertain */
+            errorSum += std::isfinite(error) ? error : 1.f;
+            if (m_active[index(pixel)] && error <= threshold)
+                m_active[index(pixel)] = 0;
+            if (m_active[index(pixel)])
+                ++active;
+        }
+    }
+    return active;
+}
+
+void PixelStatistics::serialize(const Point2i &offset, const Vector2i &size,
+                                std::ostream &stream) const {
+    for (int y=offset.y(); y<offset.y() + size.y(); ++y) {
+        size_t i = index(Point2i(offset.x(), y));
+        writeBinary(stream, &m_count[i], size.x());
+        writeBinary(stream, &m_mean[i], size.x());
+        writeBinary(stream, &m_m2[i], size.x());
+        writeBinary(stream, &m_active[i], size.x());
+    }
+}
+
+void PixelStatistics::unserialize(const Point2i &offset, const Vector2i &size,
+                                  std::istream &stream) {
+    for (int y=offset.y(); y<offset.y() + size.y(); ++y) {
+        size_t i = index(Point2i(offset.x(), y));
+        readBinary(stream, &m_count[i], size.x());
+        readBinary(stream, &m_mean[i], size.x());
+        readBinary(stream, &m_m2[i], size.x());
+        readBinary(stream, &m_active[i], size.x());
+    }
+}
+
 BlockGenerator::BlockGenerator(const Vector2i &size, int blockSize)
-        : m_size(size), m_blockSize(blockSize) {
+        : BlockGenerator(Point2i(0, 0), size, blockSize) { }
+
+BlockGenerator::BlockGenerator(const Point2i &offset, const Vector2i &size, int blockSize)
+        : m_offset(offset), m_size(size), m_blockSize(blockSize) {
     m_numBlocks = Vector2i(
         (int) std::ceil(size.x() / (float) blockSize),
         (int) std::ceil(size.y() / (float) blockSize));
@@ -159,8 +348,8 @@ bool BlockGenerator::next(ImageBlock &block) {
     if (m_blocksLeft == 0)
         return false;
 
-    Point2i pos = m_block * m_blockSize;
-    block.setOffset(pos);
+    Vector2i pos = m_block * m_blockSize;
+    block.setOffset(m_offset + pos);
     block.setSize((m_size - pos).cwiseMin(Vector2i::Constant(m_blockSize)));
     block.setBlockId(m_block.y() * m_numBlocks.x() + m_block.x());
 
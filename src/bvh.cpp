@@ -434,7 +434,8 @@ bool BVH::rayIntersect(const Ray3f &_ray, Intersection &its, bool shadowRay) con
         } else {
             for (uint32_t i = node.start(), end = node.end(); i < end; ++i) {
                 uint32_t idx = m_indices[i];
-                const Mesh *mesh = m_meshes[findMesh(idx)];
+                uint32_t meshIndex = findMesh(idx);
+                const Mesh *mesh = m_meshes[meshIndex];
 
                 float u, v, t;
                 if (mesh->rayIntersect(idx, ray, u, v, t)) {
@@ -444,6 +445,7 @@ bool BVH::rayIntersect(const Ray3f &_ray, Intersection &its, bool shadowRay) con
                     ray.maxt = its.t = t;
                     its.uv = Point2f(u, v);
                     its.mesh = mesh;
+                    its.meshIndex = meshIndex;
                     f = idx;
                 }
             }
@@ -455,6 +457,8 @@ bool BVH::rayIntersect(const Ray3f &_ray, Intersection &its, bool shadowRay) con
     }
 
     if (foundIntersection) {
+        its.primIndex = f;
+
         /* Find the barycentric coordinates */
         Vector3f bary;
         bary << 1-its.uv.sum(), its.uv;
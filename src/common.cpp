@@ -26,6 +26,10 @@
 #include <malloc.h>
 #endif
 
+#if !defined(PLATFORM_WINDOWS)
+#include <unistd.h>
+#endif
+
 #if defined(PLATFORM_WINDOWS)
 #include <windows.h>
 #endif
@@ -54,6 +58,22 @@ std::string indent(const std::string &string, int amount) {
     return oss.str();
 }
 
+int getCoreCount() {
+#if defined(PLATFORM_WINDOWS)
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    return sys_info.dwNumberOfProcessors;
+#elif defined(PLATFORM_MACOS)
+    int nprocs;
+    size_t nprocsSize = sizeof(int);
+    if (sysctlbyname("hw.activecpu", &nprocs, &nprocsSize, NULL, 0))
+        throw NoriException("Could not detect the number of processors!");
+    return (int) nprocs;
+#else
+    return sysconf(_SC_NPROCESSORS_CONF);
+#endif
+}
+
 bool endsWith(const std::string &value, const std::string &ending) {
     if (ending.size() > value.size())
         return false;
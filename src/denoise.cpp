@@ -0,0 +1,126 @@
+#include <nori/denoiser.h>
+#include <nori/timer.h>
+#include <filesystem/path.h>
+#include <memory>
+
+using namespace nori;
+
+static void help(const char *name) {
+    DenoiserOptions defaults;
+    cout << "Syntax: " << name << " [options] <input.exr> -o <output.exr>" << endl
+         << "Removes the residual noise of a rendering with an edge-aware a-trous filter," << endl
+         << "guided by optional feature buffers of the same resolution." << endl
+         << "Options:" << endl
+         << "   --albedo <file>          Surface reflectance (.exr)" << endl
+         << "   --normal <file>          Shading normals (.exr)" << endl
+         << "   --depth <file>           Distance to the first surface (.exr, first channel)" << endl
+         << "   --variance <file>        Variance of the pixel estimates (.exr)" << endl
+         << "   --aovs                   Take the albedo, normal, depth and variance from the" << endl
+         << "                            AOV layers of the input (see nori_headless --aovs)" << endl
+         << "   -i, --iterations <count> Filter iterations (default: " << defaults.iterations << ")" << endl
+         << "   --sigma-color <value>    Luminance edge-stopping (default: " << defaults.sigmaColor << ")" << endl
+         << "   --sigma-normal <value>   Normal edge-stopping (default: " << defaults.sigmaNormal << ")" << endl
+         << "   --sigma-depth <value>    Depth edge-stopping (default: " << defaults.sigmaDepth << ")" << endl
+         << "   -o, --output <file>      Output file (.exr or .png)" << endl;
+}
+
+static std::unique_ptr<Bitmap> loadFeature(const std::string &filename) {
+    if (filename.empty())
+        return nullptr;
+    if (filesystem::path(filename).extension() != "exr")
+        throw NoriException("\"%s\": expected an OpenEXR file", filename);
+    return std::unique_ptr<Bitmap>(new Bitmap(filename));
+}
+
+int main(int argc, char **argv) {
+    std::string inputName, outputName, albedoName, normalName, depthName, varianceName;
+    DenoiserOptions options;
+    bool aovs = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "-h" || arg == "--help") {
+                help(argv[0]);
+                return 0;
+            } else if (arg == "--albedo" && hasValue) {
+                albedoName = argv[++i];
+            } else if (arg == "--normal" && hasValue) {
+                normalName = argv[++i];
+            } else if (arg == "--depth" && hasValue) {
+                depthName = argv[++i];
+            } else if (arg == "--variance" && hasValue) {
+                varianceName = argv[++i];
+            } else if (arg == "--aovs") {
+                aovs = true;
+            } else if ((arg == "-i" || arg == "--iterations") && hasValue) {
+                options.iterations = toInt(argv[++i]);
+                if (options.iterations < 1 || options.iterations > 10)
+                    throw NoriException("Invalid iteration count \"%s\"", argv[i]);
+            } else if (arg == "--sigma-color" && hasValue) {
+                options.sigmaColor = toFloat(argv[++i]);
+            } else if (arg == "--sigma-normal" && hasValue) {
+                options.sigmaNormal = toFloat(argv[++i]);
+            } else if (arg == "--sigma-depth" && hasValue) {
+                options.sigmaDepth = toFloat(argv[++i]);
+            } else if ((arg == "-o" || arg == "--output") && hasValue) {
+                outputName = argv[++i];
+            } else if (arg[0] != '-' && inputName.empty()) {
+                inputName = arg;
+            } else {
+                throw NoriException("Invalid argument \"%s\"", arg);
+            }
+        }
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        help(argv[0]);
+        return 1;
+    }
+
+    if (inputName.empty() || outputName.empty()) {
+        help(argv[0]);
+        return 1;
+    }
+
+    try {
+        if (filesystem::path(inputName).extension() != "exr")
+            throw NoriException("\"%s\": expected an OpenEXR file", inputName);
+        Bitmap image(inputName);
+        std::unique_ptr<Bitmap> albedo = loadFeature(albedoName), normal = loadFeature(normalName),
+                                depth = loadFeature(depthName), variance = loadFeature(varianceName);
+
+        /* Layers written by the renderer (see AOVImages), unless given explicitly */
+        if (aovs) {
+            if (!albedo)
+                albedo.reset(new Bitmap(inputName, { "albedo.R", "albedo.G", "albedo.B" }));
+            if (!normal)
+                normal.reset(new Bitmap(inputName, { "normal.X", "normal.Y", "normal.Z" }));
+            if (!depth)
+                depth.reset(new Bitmap(inputName, { "depth.Z" }));
+            if (!variance)
+                variance.reset(new Bitmap(inputName, { "variance.Y" }));
+        }
+
+        DenoiserFeatures features;
+        features.albedo = albedo.get();
+        features.normal = normal.get();
+        features.depth = depth.get();
+        features.variance = variance.get();
+
+        Timer timer;
+        Bitmap result = denoise(image, features, options);
+        cout << "Denoised \"" << inputName << "\" in " << timer.elapsedString() << endl;
+
+        if (filesystem::path(outputName).extension() == "png")
+            result.saveToLDR(outputName);
+        else
+            result.save(outputName);
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 2;
+    }
+
+    return 0;
+}
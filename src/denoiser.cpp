@@ -0,0 +1,240 @@
+#include <nori/denoiser.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/blocked_range2d.h>
+
+NORI_NAMESPACE_BEGIN
+
+namespace {
+
+/**
+ * \brief Single-channel image surrounded by a border of zeros
+ *
+ * The border is wide enough for the largest filter footprint, hence
+ * the taps of every row segment are contiguous arrays.
+ */
+class Plane {
+public:
+    Plane(const Vector2i &size, int border)
+        : m_border(border), m_stride(size.x() + 2 * border),
+          m_data((size_t) m_stride * (size.y() + 2 * border), 0.f) { }
+
+    float &operator()(int x, int y) { return row(y)[x]; }
+    float operator()(int x, int y) const { return row(y)[x]; }
+
+    /// Row segment of \c n pixels starting at (x, y)
+    Eigen::Map<Eigen::ArrayXf> segment(int x, int y, int n) {
+        return Eigen::Map<Eigen::ArrayXf>(row(y) + x, n);
+    }
+
+    Eigen::Map<const Eigen::ArrayXf> segment(int x, int y, int n) const {
+        return Eigen::Map<const Eigen::ArrayXf>(row(y) + x, n);
+    }
+
+    void swap(Plane &other) { m_data.swap(other.m_data); }
+
+private:
+    float *row(int y) { return &m_data[(size_t) (y + m_border) * m_stride + m_border]; }
+    const float *row(int y) const { return &m_data[(size_t) (y + m_border) * m_stride + m_border]; }
+
+    int m_border, m_stride;
+    std::vector<float> m_data;
+};
+
+/// Weights of the B3-spline kernel, indexed by the absolute tap offset
+const float B3Spline[3] = { 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+/// Apply \c func to tiles (2D blocked ranges) of the image in parallel
+template <typename Func> void forEachTile(const Vector2i &size, const Func &func) {
+    tbb::parallel_for(tbb::blocked_range2d<int>(0, size.y(), 16, 0, size.x(), 128),
+        [&](const tbb::blocked_range2d<int> &range) {
+            for (int y = range.rows().begin(); y != range.rows().end(); ++y)
+                func(y, range.cols().begin(), range.cols().end() - range.cols().begin());
+        });
+}
+
+void checkSize(const Bitmap *bitmap, const Bitmap &image, const char *name) {
+    if (bitmap && (bitmap->cols() != image.cols() || bitmap->rows() != image.rows()))
+        throw NoriException("denoise(): the %s buffer has a resolution of %ix%i, expected %ix%i",
+            name, bitmap->cols(), bitmap->rows(), image.cols(), image.rows());
+}
+
+}
+
+Bitmap denoise(const Bitmap &image, const DenoiserFeatures &features, const DenoiserOptions &options) {
+    checkSize(features.albedo, image, "albedo");
+    checkSize(features.normal, image, "normal");
+    checkSize(features.depth, image, "depth");
+    checkSize(features.variance, image, "variance");
+
+    const Vector2i size((int) image.cols(), (int) image.rows());
+    const int iterations = std::max(options.iterations, 0);
+    /* The outermost taps of the last iteration lie 2 * 2^(iterations - 1) pixels away */
+    const int border = std::max(1 << iterations, 2);
+    const bool useNormal = features.normal != nullptr;
+    const bool useDepth = features.depth != nullptr;
+
+    Plane mask(size, border), luminance(size, border), variance(size, border),
+          varianceOut(size, border), varianceBlur(size, border),
+          depth(size, border), gradient(size, border);
+    std::vector<Plane> color(3, Plane(size, border)), colorOut(3, Plane(size, border));
+    std::vector<Plane> normal(useNormal ? 4 : 0, Plane(size, border));
+    Bitmap modulation(size);
+
+    /* Demodulate the albedo and convert the inputs into planes. The fourth
+       normal component marks pixels without a surface, so that those are
+       similar to each other but not to surfaces. */
+    tbb::parallel_for(tbb::blocked_range<int>(0, size.y()),
+        [&](const tbb::blocked_range<int> &range) {
+            for (int y = range.begin(); y != range.end(); ++y) {
+                for (int x = 0; x < size.x(); ++x) {
+                    Color3f factor(1.f);
+                    if (features.albedo) {
+                        const Color3f &albedo = features.albedo->coeff(y, x);
+                        for (int c = 0; c < 3; ++c)
+                            factor[c] = albedo[c] > 1e-3f ? albedo[c] : 1.f;
+                    }
+                    modulation.coeffRef(y, x) = factor;
+
+                    const Color3f &value = image.coeff(y, x);
+                    for (int c = 0; c < 3; ++c)
+                        color[c](x, y) = value[c] / factor[c];
+                    mask(x, y) = 1.f;
+
+                    if (features.variance) {
+                        float scale = factor.getLuminance();
+                        variance(x, y) = std::max(0.f, features.variance->coeff(y, x).getLuminance())
+                            / (scale * scale);
+                    }
+                    if (useNormal) {
+                        Vector3f n(features.normal->coeff(y, x).r(),
+                                   features.normal->coeff(y, x).g(),
+                                   features.normal->coeff(y, x).b());
+                        float length = n.norm();
+                        bool valid = length > 0.5f && std::isfinite(length);
+                        for (int k = 0; k < 3; ++k)
+                            normal[k](x, y) = valid ? n[k] / length : 0.f;
+                        normal[3](x, y) = valid ? 0.f : 1.f;
+                    }
+                    if (useDepth) {
+                        float z = features.depth->coeff(y, x).r();
+                        depth(x, y) = std::isfinite(z) ? z : 0.f;
+                    }
+                }
+            }
+        });
+
+    /* Depth gradients (central differences within the image), and the
+       variance estimated from the 3x3 neighborhood if none was given */
+    tbb::parallel_for(tbb::blocked_range<int>(0, size.y()),
+        [&](const tbb::blocked_range<int> &range) {
+            for (int y = range.begin(); y != range.end(); ++y) {
+                for (int x = 0; x < size.x(); ++x) {
+                    if (useDepth) {
+                        int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, size.x() - 1);
+                        int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, size.y() - 1);
+                        float dx = std::abs(depth(x1, y) - depth(x0, y)) / std::max(x1 - x0, 1);
+                        float dy = std::abs(depth(x, y1) - depth(x, y0)) / std::max(y1 - y0, 1);
+                        gradient(x, y) = std::max(dx, dy);
+                    }
+                    if (!features.variance) {
+                        float sum = 0.f, sum2 = 0.f, count = 0.f;
+                        for (int dy = -1; dy <= 1; ++dy) {
+                            for (int dx = -1; dx <= 1; ++dx) {
+                                float m = mask(x + dx, y + dy);
+                                float l = Color3f(color[0](x + dx, y + dy), color[1](x + dx, y + dy),
+                                                  color[2](x + dx, y + dy)).getLuminance();
+                                sum += m * l;
+                                sum2 += m * l * l;
+                                count += m;
+                            }
+                        }
+                        float mean = sum / count;
+                        variance(x, y) = std::max(0.f, sum2 / count - mean * mean);
+                    }
+                }
+            }
+        });
+
+    const float eps = 1e-4f;
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        const int step = 1 << iteration;
+
+        /* Luminance of the current image, and the variance blurred by a 3x3
+           Gaussian, which makes the luminance weights more robust */
+        forEachTile(size, [&](int y, int x, int n) {
+            luminance.segment(x, y, n) = color[0].segment(x, y, n) * 0.212671f
+                + color[1].segment(x, y, n) * 0.715160f + color[2].segment(x, y, n) * 0.072169f;
+        });
+        forEachTile(size, [&](int y, int x, int n) {
+            Eigen::ArrayXf sum = Eigen::ArrayXf::Zero(n), weight = Eigen::ArrayXf::Zero(n);
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    float h = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                    sum += h * mask.segment(x + dx, y + dy, n) * variance.segment(x + dx, y + dy, n);
+                    weight += h * mask.segment(x + dx, y + dy, n);
+                }
+            }
+            varianceBlur.segment(x, y, n) = sum / weight;
+        });
+
+        forEachTile(size, [&](int y, int x, int n) {
+            Eigen::ArrayXf sum[3] = { Eigen::ArrayXf::Zero(n), Eigen::ArrayXf::Zero(n), Eigen::ArrayXf::Zero(n) };
+            Eigen::ArrayXf weightSum = Eigen::ArrayXf::Zero(n), varianceSum = Eigen::ArrayXf::Zero(n);
+            Eigen::ArrayXf exponent(n), weight(n), cosine(n);
+
+            Eigen::ArrayXf lumScale = 1.f / (options.sigmaColor * varianceBlur.segment(x, y, n).sqrt() + eps);
+            auto lp = luminance.segment(x, y, n);
+            auto zp = depth.segment(x, y, n);
+            auto gp = gradient.segment(x, y, n);
+
+            for (int dy = -2; dy <= 2; ++dy) {
+                for (int dx = -2; dx <= 2; ++dx) {
+                    int qx = x + dx * step, qy = y + dy * step;
+                    float h = B3Spline[std::abs(dx)] * B3Spline[std::abs(dy)];
+
+                    exponent = -(lp - luminance.segment(qx, qy, n)).abs() * lumScale;
+                    if (useNormal) {
+                        cosine = normal[0].segment(x, y, n) * normal[0].segment(qx, qy, n);
+                        for (int k = 1; k < 4; ++k)
+                            cosine += normal[k].segment(x, y, n) * normal[k].segment(qx, qy, n);
+                        exponent -= options.sigmaNormal * (1.f - cosine).max(0.f);
+                    }
+                    if (useDepth && (dx != 0 || dy != 0)) {
+                        float distance = step * std::sqrt((float) (dx * dx + dy * dy));
+                        exponent -= (zp - depth.segment(qx, qy, n)).abs()
+                            / (options.sigmaDepth * distance * gp + eps);
+                    }
+
+                    weight = h * mask.segment(qx, qy, n) * exponent.exp();
+                    for (int c = 0; c < 3; ++c)
+                        sum[c] += weight * color[c].segment(qx, qy, n);
+                    weightSum += weight;
+                    varianceSum += weight.square() * variance.segment(qx, qy, n);
+                }
+            }
+
+            /* The center tap always has a positive weight */
+            for (int c = 0; c < 3; ++c)
+                colorOut[c].segment(x, y, n) = sum[c] / weightSum;
+            varianceOut.segment(x, y, n) = varianceSum / weightSum.square();
+        });
+
+        for (int c = 0; c < 3; ++c)
+            color[c].swap(colorOut[c]);
+        variance.swap(varianceOut);
+    }
+
+    /* Remodulate the albedo */
+    Bitmap result(size);
+    tbb::parallel_for(tbb::blocked_range<int>(0, size.y()),
+        [&](const tbb::blocked_range<int> &range) {
+            for (int y = range.begin(); y != range.end(); ++y)
+                for (int x = 0; x < size.x(); ++x)
+                    result.coeffRef(y, x) = Color3f(color[0](x, y), color[1](x, y), color[2](x, y))
+                        * modulation.coeff(y, x);
+        });
+    return result;
+}
+
+NORI_NAMESPACE_END
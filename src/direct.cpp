@@ -35,7 +35,7 @@ public:
 			Vector3f LocalWi = its.toLocal(eRec.wi);
 			Vector3f LocalWo = its.toLocal(eRec.wi);
 			/* check the visibility of the point being rendered, is it not in shadow? */
-			if (VisibilityTester(scene, its, &eRec.wi, &eRec.dist)) {
+			if (VisibilityTester(scene, its, &eRec.wi, &eRec.dist, ray.time)) {
 				/*if not in shadow, get the BSDF and computer the illumination*/
 				float cosTheta = its.shFrame.cosTheta(LocalWi);
 				BSDFQueryRecord bRec(LocalWi, LocalWo, ESolidAngle);
@@ -48,8 +48,9 @@ public:
 	}
 
 	/// check the visibility of the point being rendered, is it not in shadow? 
-	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float *dist) const {
+	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float *dist, float time) const {
 		Ray3f ray(TRay<Point3f, Vector3f>(its.p, *dir), Epsilon, *dist);
+		ray.time = time;
 		return !scene->rayIntersect(ray);
 	}
 
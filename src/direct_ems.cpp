@@ -38,7 +38,7 @@ public:
 		// if ray hits a mesh, sample a light and compute its contribution 
 		EmitterQueryRecord dirRec(its.p);
 		Color3f direct = scene->sampleDirect(dirRec, sampler->next2D());
-		int v = VisibilityTester(scene, its, &dirRec.wi, &dirRec.dist);
+		int v = VisibilityTester(scene, its, &dirRec.wi, &dirRec.dist, ray.time);
 		BSDFQueryRecord bRec(its.toLocal(-ray.d), its.toLocal(dirRec.wi), ESolidAngle);
 		const BSDF *bsdf = its.mesh->getBSDF();
 		Color3f bsdfDiff = bsdf->eval(bRec);
@@ -49,8 +49,9 @@ public:
 	}
 
 	/// check the visibility of the point being rendered, is it not in shadow? 
-	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float *dist) const {
+	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float *dist, float time) const {
 		Ray3f ray(TRay<Point3f, Vector3f>(its.p, *dir), Epsilon, *dist - Epsilon);
+		ray.time = time;
 		return !scene->rayIntersect(ray);
 	}
 
@@ -41,6 +41,7 @@ public:
 		Color3f bsdfDiff = bsdf->sample(bRec, sampler->next2D());
 		//Color3f bsdfDiff = bsdf->eval(bRec) / bsdf->pdf(bRec); // = bsdf-sample / cosTheta
 		Ray3f newRay = Ray3f(its.p, its.toWorld(bRec.wo));
+		newRay.time = ray.time;
 
 		// check if new ray hit anything, if not, check the environment emitter 
 		Intersection its_newRay;
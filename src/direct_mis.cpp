@@ -58,7 +58,7 @@ public:
 		EmitterQueryRecord dirRec(its.p);
 		Color3f direct = scene->sampleDirect(dirRec, sampler->next2D());
 		pdf_em_wem = scene->pdfDirect(dirRec);
-		int v = VisibilityTester(scene, its, &dirRec.wi, &dirRec.dist);
+		int v = VisibilityTester(scene, its, &dirRec.wi, &dirRec.dist, ray.time);
 		BSDFQueryRecord bRec_em(its.toLocal(-ray.d), its.toLocal(dirRec.wi), ESolidAngle);
 		bRec_em.uv = its.uv;
 		const BSDF *bsdf_em = its.mesh->getBSDF();
@@ -77,6 +77,7 @@ public:
 		pdf_mat_wmat = bsdf_mat->pdf(bRec_mats);
 		pdf_mat_wem = bsdf_mat->pdf(bRec_em);
 		Ray3f newRay = Ray3f(its.p, its.toWorld(bRec_mats.wo));
+		newRay.time = ray.time;
 
 		// check if new ray hit anything, if not, check the environment emitter 
 		Intersection its_newRay;
@@ -110,8 +111,9 @@ public:
 
 
 	/// check the visibility of the point being rendered, is it not in shadow? 
-	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float *dist) const {
+	bool VisibilityTester(const Scene *scene, Intersection its, Vector3f *dir, float *dist, float time) const {
 		Ray3f ray(TRay<Point3f, Vector3f>(its.p, *dir), Epsilon, *dist - Epsilon);
+		ray.time = time;
 		return !scene->rayIntersect(ray);
 	}
 
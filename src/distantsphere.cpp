@@ -43,6 +43,11 @@ public:
 		return Warp::squareToUniformSphereCapPdf((m_toLocal * lRec.wi), cos(m_angle));
 	}
 
+	/// Constant radiance integrated over the solid angle of the cap
+	Color3f power() const {
+		return m_radiance * 2 * M_PI * (1 - cos(m_angle));
+	}
+
 	bool isEnvironmentEmitter() const { return true; }
 
 	void setParent(NoriObject *object) {
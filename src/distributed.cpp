@@ -0,0 +1,311 @@
+#include <nori/distributed.h>
+#include <nori/scene.h>
+#include <nori/camera.h>
+#include <nori/integrator.h>
+#include <nori/sampler.h>
+#include <nori/timer.h>
+#include <nori/serialization.h>
+#include <filesystem/path.h>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+NORI_NAMESPACE_BEGIN
+
+/* Messages exchanged between the coordinator and its workers:
+
+   coordinator -> worker:  configuration (once, right after connecting),
+                           tile assignments, empty message when done
+   worker -> coordinator:  rendered tiles */
+
+static std::string writeString(const std::string &value) {
+    std::ostringstream stream;
+    writeBinary(stream, (uint32_t) value.length());
+    writeBinary(stream, value.data(), value.length());
+    return stream.str();
+}
+
+static std::string readString(std::istream &stream) {
+    uint32_t length;
+    readBinary(stream, length);
+    std::string value(length, '\0');
+    readBinary(stream, &value[0], length);
+    return value;
+}
+
+RenderCoordinator::RenderCoordinator(const std::string &filename, const RenderOptions &options, int port) {
+    m_tilesLeft = 0;
+    m_connections = 0;
+
+    /* Workers render the tiles in their own order, and adaptive sampling
+       requires a view of the entire image to decide when to stop */
+    if (options.adaptive || options.errorTarget > 0)
+        throw NoriException("Adaptive sampling is not supported by distributed rendering");
+    if (options.aovs)
+        throw NoriException("AOVs are not supported by distributed rendering");
+
+    /* The workers load the scene on their own, possibly from another working directory */
+    filesystem::path path = filesystem::path(filename).make_absolute();
+    m_scene.reset(loadScene(path.str(), options));
+    if (!m_scene)
+        throw NoriException("\"%s\" does not describe a scene", filename);
+    if (m_scene->getIntegrator()->isProgressive())
+        throw NoriException("Progressive integrators are not supported by distributed rendering");
+    if (m_scene->getIntegrator()->isSplatting())
+        throw NoriException("Splatting integrators are not supported by distributed rendering");
+    m_outputName = getOutputName(filename, options);
+
+    const Camera *camera = m_scene->getCamera();
+    Vector2i outputSize = camera->getOutputSize();
+    Point2i cropOffset = camera->getCropOffset();
+    Vector2i cropSize = camera->getCropSize();
+    m_splatFilter = options.filterImportanceSampling
+        ? nullptr : camera->getReconstructionFilter();
+    m_film.init(cropOffset, cropSize, m_splatFilter, NORI_BLOCK_SIZE);
+
+    /* Workers apply the effective settings of the coordinator */
+    std::ostringstream config;
+    config << writeString(path.str());
+    writeBinary(config, (uint32_t) m_scene->getSampler()->getSampleCount());
+    writeBinary(config, outputSize.x());
+    writeBinary(config, outputSize.y());
+    writeBinary(config, cropOffset.x());
+    writeBinary(config, cropOffset.y());
+    writeBinary(config, cropSize.x());
+    writeBinary(config, cropSize.y());
+    writeBinary(config, (uint8_t) options.filterImportanceSampling);
+    m_config = config.str();
+
+    /* Hand out the tiles in a spiral order, so that the center is rendered first */
+    BlockGenerator blockGenerator(cropOffset, cropSize, NORI_BLOCK_SIZE);
+    ImageBlock tileBlock(Vector2i(NORI_BLOCK_SIZE), nullptr);
+    while (blockGenerator.next(tileBlock)) {
+        TileInfo tile;
+        tile.id = tileBlock.getBlockId();
+        tile.offset = tileBlock.getOffset();
+        tile.size = tileBlock.getSize();
+        m_queue.push((uint32_t) m_tiles.size());
+        m_tiles.push_back(tile);
+    }
+    m_tilesLeft = m_tiles.size();
+
+    m_listener = Socket::listen(port);
+}
+
+RenderCoordinator::~RenderCoordinator() {
+    for (int pid : m_processes) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+void RenderCoordinator::spawnWorkers(const std::string &executable, int count, int threadCount) {
+    std::string address = tfm::format("127.0.0.1:%i", getPort());
+    std::string threads = std::to_string(threadCount);
+
+    for (int i = 0; i < count; ++i) {
+        int pid = fork();
+        if (pid < 0)
+            throw NoriException("Unable to launch a worker process: %s", strerror(errno));
+
+        if (pid == 0) {
+            const char *args[] = { executable.c_str(), "--worker", address.c_str(),
+                                   "--threads", threads.c_str(), nullptr };
+            execvp(args[0], (char * const *) args);
+            _exit(127);
+        }
+        m_processes.push_back(pid);
+    }
+}
+
+bool RenderCoordinator::spawnedWorkersExited() {
+    for (auto it = m_processes.begin(); it != m_processes.end(); ) {
+        if (waitpid(*it, nullptr, WNOHANG) == *it)
+            it = m_processes.erase(it);
+        else
+            ++it;
+    }
+    return m_processes.empty();
+}
+
+void RenderCoordinator::serveWorker(Socket socket) {
+    try {
+        socket.sendMessage(m_config);
+
+        while (true) {
+            uint32_t index;
+            if (!m_queue.try_pop(index)) {
+                /* Tiles that are still being rendered elsewhere may come back */
+                if (m_tilesLeft == 0)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            const TileInfo &tile = m_tiles[index];
+            try {
+                std::ostringstream assignment;
+                writeBinary(assignment, tile.id);
+                writeBinary(assignment, tile.offset.x());
+                writeBinary(assignment, tile.offset.y());
+                writeBinary(assignment, tile.size.x());
+                writeBinary(assignment, tile.size.y());
+                socket.sendMessage(assignment.str());
+
+                std::istringstream result(socket.receiveMessage());
+                uint32_t id;
+                readBinary(result, id);
+                if (id != tile.id)
+                    throw NoriException("Received tile %i instead of tile %i", id, tile.id);
+                m_film.readTile(id, result);
+                if (result.peek() != std::char_traits<char>::eof())
+                    throw NoriException("Received a tile of the wrong size");
+            } catch (...) {
+                m_queue.push(index);
+                throw;
+            }
+            --m_tilesLeft;
+        }
+
+        socket.sendMessage(std::string());
+    } catch (const std::exception &e) {
+        if (m_tilesLeft > 0)
+            cerr << "Warning: lost a worker (" << e.what() << ")" << endl;
+    }
+    --m_connections;
+}
+
+void RenderCoordinator::run() {
+    std::vector<std::thread> threads;
+    Timer timer;
+    int lastPercent = -1;
+
+    cout << "Rendering " << m_tiles.size() << " tiles .." << endl;
+
+    while (m_tilesLeft > 0) {
+        Socket socket = m_listener.accept(100);
+        if (socket.isValid()) {
+            ++m_connections;
+            threads.emplace_back(&RenderCoordinator::serveWorker, this, std::move(socket));
+        } else if (m_connections == 0 && !m_processes.empty() && spawnedWorkersExited()) {
+            for (auto &thread : threads)
+                thread.join();
+            throw NoriException("All worker processes exited before the image was complete");
+        }
+
+        int percent = (int) (100 * (m_tiles.size() - m_tilesLeft) / m_tiles.size());
+        if (percent != lastPercent) {
+            cout << "Progress: " << percent << "% (" << timer.elapsedString()
+                 << ", " << m_connections << " connections)" << endl;
+            lastPercent = percent;
+        }
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    cout << "done. (took " << timer.elapsedString() << ")" << endl;
+
+    ImageBlock image(m_scene->getCamera()->getOutputSize(), m_splatFilter);
+    m_film.develop(image);
+    saveImage(image, m_outputName);
+}
+
+void runRenderWorker(const std::string &host, int port, int threadCount) {
+    if (threadCount <= 0)
+        threadCount = getCoreCount();
+
+    /* The first connection provides the configuration for loading the scene */
+    std::vector<Socket> sockets;
+    sockets.push_back(Socket::connect(host, port));
+    std::istringstream config(sockets[0].receiveMessage());
+
+    RenderOptions options;
+    std::string filename = readString(config);
+    uint32_t sampleCount;
+    uint8_t fis;
+    readBinary(config, sampleCount);
+    readBinary(config, options.resolution.x());
+    readBinary(config, options.resolution.y());
+    readBinary(config, options.cropOffset.x());
+    readBinary(config, options.cropOffset.y());
+    readBinary(config, options.cropSize.x());
+    readBinary(config, options.cropSize.y());
+    readBinary(config, fis);
+    options.sampleCount = (int) sampleCount;
+    options.filterImportanceSampling = fis != 0;
+
+    std::unique_ptr<Scene> scene(loadScene(filename, options));
+    if (!scene)
+        throw NoriException("\"%s\" does not describe a scene", filename);
+
+    const Camera *camera = scene->getCamera();
+    const ReconstructionFilter *fisFilter = nullptr, *splatFilter = camera->getReconstructionFilter();
+    if (options.filterImportanceSampling)
+        std::swap(fisFilter, splatFilter);
+
+    for (int i = 1; i < threadCount; ++i) {
+        sockets.push_back(Socket::connect(host, port));
+        sockets.back().receiveMessage();
+    }
+
+    std::atomic<int> tilesRendered(0);
+    std::atomic<bool> failed(false);
+    auto serve = [&](Socket &socket) {
+        try {
+            while (true) {
+                std::string message = socket.receiveMessage();
+                if (message.empty())
+                    break;
+
+                std::istringstream assignment(message);
+                uint32_t id;
+                Point2i offset;
+                Vector2i size;
+                readBinary(assignment, id);
+                readBinary(assignment, offset.x());
+                readBinary(assignment, offset.y());
+                readBinary(assignment, size.x());
+                readBinary(assignment, size.y());
+
+                /* Render all samples of the tile, like the local renderer */
+                ImageBlock block(size, splatFilter);
+                block.setOffset(offset);
+                block.setBlockId(id);
+                block.clear();
+
+                std::unique_ptr<Sampler> sampler(scene->getSampler()->clone());
+                sampler->prepare(block);
+                for (uint32_t i = 0; i < sampleCount; ++i)
+                    renderBlock(scene.get(), sampler.get(), block, i, nullptr, fisFilter);
+
+                std::ostringstream result;
+                writeBinary(result, id);
+                writeBinary(result, block.data(), (size_t) block.size());
+                socket.sendMessage(result.str());
+                ++tilesRendered;
+            }
+        } catch (const std::exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i)
+        threads.emplace_back(serve, std::ref(sockets[i]));
+    serve(sockets[0]);
+    for (auto &thread : threads)
+        thread.join();
+
+    cout << "Rendered " << tilesRendered << " tiles" << endl;
+    if (failed)
+        throw NoriException("Lost the connection to the coordinator");
+}
+
+NORI_NAMESPACE_END
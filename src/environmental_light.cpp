@@ -3,11 +3,21 @@
 #include <nori/warp.h>
 #include <nori/texture.h>
 #include <nori/dpdf.h>
+#include <nori/scene.h>
 
 NORI_NAMESPACE_BEGIN
 
 /**
-* \brief Simple area emitter with uniform emittance
+* \brief Environment emitter with a constant or textured radiance
+*
+* A texture is parameterized by latitude (rows) and longitude (columns).
+* When the emitter is activated, it is resampled into an equal-area
+* octahedral map (see \ref Warp::squareToEqualAreaSphere()), which is
+* looked up with bilinear filtering and needs no trigonometric functions
+* to find the texels of a direction. As all texels of this map cover the
+* same solid angle, directions are importance sampled using a marginal
+* distribution over the rows and a conditional distribution over the
+* columns of every row that are proportional to the luminance.
 */
 class EnvironmentalLight : public Emitter {
 public:
@@ -19,10 +29,58 @@ public:
 		m_toLocal = m_toWorld.inverse();
 	}
 
+	virtual void activate() override {
+		if (!m_texture)
+			return;
+
+		const Bitmap texture = m_texture->getBitmap();
+		if (texture.rows() == 0 || texture.cols() == 0)
+			throw NoriException("EnvironmentalLight: the texture is empty!");
+
+		/* Resample the latitude-longitude texture into an octahedral map with
+		   about the same number of texels, using 2x2 samples per texel */
+		int res = std::max(1, (int) std::ceil(std::sqrt((float) texture.rows() * texture.cols())));
+		m_envmap.resize(res, res);
+		for (int i = 0; i < res; ++i) {
+			for (int j = 0; j < res; ++j) {
+				Color3f value(0.0f);
+				for (int k = 0; k < 4; ++k) {
+					Point2f p((j + 0.25f + 0.5f * (k & 1)) / res, (i + 0.25f + 0.5f * (k >> 1)) / res);
+					value += lookupLatLong(texture, getPixel(Warp::squareToEqualAreaSphere(p)));
+				}
+				m_envmap(i, j) = value / 4;
+			}
+		}
+
+		/* A bilinear lookup within a texel also depends on its neighbors, so
+		   they must contribute to the sampling weight of the texel to avoid
+		   assigning a zero density to directions with nonzero radiance */
+		m_rowDistr.clear();
+		m_colDistr.assign(res, DiscretePDF(res));
+		for (int i = 0; i < res; ++i) {
+			for (int j = 0; j < res; ++j) {
+				float weight = 0.0f;
+				for (int di = -1; di <= 1; ++di)
+					for (int dj = -1; dj <= 1; ++dj)
+						weight += std::max(0.0f, texel(i + di, j + dj).getLuminance());
+				m_colDistr[i].append(weight);
+			}
+			m_rowDistr.append(m_colDistr[i].normalize());
+		}
+		if (m_rowDistr.normalize() == 0)
+			throw NoriException("EnvironmentalLight: the texture does not emit any light!");
+	}
+
 	Color3f eval(const EmitterQueryRecord &lRec) const {
 		if ((m_toLocal * lRec.wi).z() > cos(m_angle)) {
 			if (m_texture) {
-				return m_texture->sample(getPixel(lRec.wi));
+				/* Bilinear interpolation between the four closest texel centers */
+				Point2f uv = Warp::equalAreaSphereToSquare(lRec.wi.normalized());
+				float x = uv.x() * m_envmap.cols() - 0.5f, y = uv.y() * m_envmap.rows() - 0.5f;
+				int x0 = (int) std::floor(x), y0 = (int) std::floor(y);
+				float fx = x - x0, fy = y - y0;
+				return (texel(y0, x0) * (1 - fx) + texel(y0, x0 + 1) * fx) * (1 - fy)
+					+ (texel(y0 + 1, x0) * (1 - fx) + texel(y0 + 1, x0 + 1) * fx) * fy;
 			}
 			return m_radiance;
 		}
@@ -33,23 +91,79 @@ public:
 
 
 	Color3f sample(EmitterQueryRecord &lRec, const Point2f &sample) const {
-		//Point2f s = sample;
-		//size_t index = distr.sampleReuse(s.x());
-
-		lRec.wi = m_toWorld * Warp::squareToUniformSphereCap(sample, cos(m_angle));
-		lRec.pdf = Warp::squareToUniformSphereCapPdf((m_toLocal * lRec.wi), cos(m_angle));
 		lRec.dist = INFINITY;
+		if (!m_texture) {
+			lRec.wi = m_toWorld * Warp::squareToUniformSphereCap(sample, cos(m_angle));
+			lRec.pdf = pdf(lRec);
+		} else {
+			/* Choose a texel, then a uniformly distributed point within it */
+			Point2f s = sample;
+			size_t row = m_rowDistr.sampleReuse(s.x());
+			size_t col = m_colDistr[row].sampleReuse(s.y());
+			lRec.wi = Warp::squareToEqualAreaSphere(
+				Point2f((col + s.y()) / m_envmap.cols(), (row + s.x()) / m_envmap.rows()));
+			lRec.pdf = texelPdf(row, col);
+		}
 		if (lRec.pdf == 0) {
 			return Color3f(0.0f);
 		}
-		return eval(lRec) / pdf(lRec);
+		return eval(lRec) / lRec.pdf;
 	}
 
 
 
 	float pdf(const EmitterQueryRecord &lRec) const {
-		return Warp::squareToUniformSphereCapPdf((m_toLocal * lRec.wi), cos(m_angle));
-		//return 1.0f / distr.getSum();
+		if (!m_texture)
+			return Warp::squareToUniformSphereCapPdf((m_toLocal * lRec.wi), cos(m_angle));
+		Point2f uv = Warp::equalAreaSphereToSquare(lRec.wi.normalized());
+		size_t row = std::min((size_t) (uv.y() * m_envmap.rows()), (size_t) m_envmap.rows() - 1);
+		size_t col = std::min((size_t) (uv.x() * m_envmap.cols()), (size_t) m_envmap.cols() - 1);
+		return texelPdf(row, col);
+	}
+
+	/// Radiance integrated over the sphere of directions
+	Color3f power() const {
+		if (!m_texture)
+			return m_radiance * 2 * M_PI * (1 - cos(m_angle));
+
+		/* Midpoint rule over the texel centers of the octahedral map, which
+		   all cover the same solid angle */
+		Color3f result(0.0f);
+		EmitterQueryRecord lRec;
+		for (int i = 0; i < m_envmap.rows(); ++i) {
+			for (int j = 0; j < m_envmap.cols(); ++j) {
+				lRec.wi = Warp::squareToEqualAreaSphere(
+					Point2f((j + 0.5f) / m_envmap.cols(), (i + 0.5f) / m_envmap.rows()));
+				result += eval(lRec);
+			}
+		}
+		return result * 4 * M_PI / m_envmap.size();
+	}
+
+	/**
+	* \brief Sample a direction towards the emitter, and a photon that arrives
+	* from there through a disk covering the cross section of the scene
+	*/
+	Color3f samplePhoton(Ray3f &ray, Normal3f &n, const Point2f &sample1, const Point2f &sample2) const {
+		EmitterQueryRecord lRec(Point3f(0.0f));
+		Color3f value = sample(lRec, sample1);
+		if ((value.array() == 0).all())
+			return Color3f(0.0f);
+
+		const BoundingBox3f &bbox = m_scene->getBoundingBox();
+		float radius = bbox.getExtents().norm() / 2;
+		Frame frame(lRec.wi);
+		Point2f disk = Warp::squareToUniformDisk(sample2) * radius;
+		Point3f origin = bbox.getCenter() + (lRec.wi * radius + frame.s * disk.x() + frame.t * disk.y());
+		ray = Ray3f(origin, -lRec.wi);
+		n = Normal3f(0.0f);
+		return value * M_PI * radius * radius;
+	}
+
+	void pdfPhoton(const EmitterQueryRecord &lRec, float &pdfPos, float &pdfDir) const {
+		float radius = m_scene->getBoundingBox().getExtents().norm() / 2;
+		pdfPos = 1.0f / (M_PI * radius * radius);
+		pdfDir = pdf(lRec);
 	}
 
 	bool isEnvironmentEmitter() const { return true; }
@@ -57,23 +171,12 @@ public:
 	void setParent(NoriObject *object) {
 		if (object->getClassType() != EScene)
 			throw NoriException("EnvironmentalLight: must be parented to the scene!");
+		m_scene = static_cast<const Scene *>(object);
 	}
 
 	virtual void addChild(NoriObject *obj) override {
 		if (obj->getClassType() == ETexture) {
 			m_texture = static_cast<Texture *>(obj);
-			//int width = m_texture->rows();
-			//int height = m_texture->cols();
-			//Bitmap texture = m_texture->getBitmap();
-
-			//for (int i = 0; i < width; i++) {
-			//	for (int j = 0; j < height; j++) {
-			//		float weight = texture(i, j).maxCoeff();
-			//		distr.append(weight);
-			//	}
-			//}
-
-			//distr.normalize();
 		}
 		else {
 			throw NoriException("EnvironmentalLight::addChild(<%s>) cannot be done!",
@@ -99,24 +202,65 @@ public:
 
 
 
-	Vector3f getDirection(Point2f xy) const {
+	/// Bilinear lookup in a latitude-longitude texture (wraps around in longitude)
+	static Color3f lookupLatLong(const Bitmap &texture, const Point2f &uv) {
+		int rows = (int) texture.rows(), cols = (int) texture.cols();
+		float x = uv.x() * rows - 0.5f, y = uv.y() * cols - 0.5f;
+		int x0 = (int) std::floor(x), y0 = (int) std::floor(y);
+		float fx = x - x0, fy = y - y0;
+		auto at = [&](int i, int j) {
+			return texture(clamp(i, 0, rows - 1), ((j % cols) + cols) % cols);
+		};
+		return (at(x0, y0) * (1 - fy) + at(x0, y0 + 1) * fy) * (1 - fx)
+			+ (at(x0 + 1, y0) * (1 - fy) + at(x0 + 1, y0 + 1) * fy) * fx;
 	}
 
+	/**
+	* \brief Return a texel of the octahedral map, where coordinates beyond
+	* an edge continue on the adjacent part of the sphere
+	*/
+	const Color3f &texel(int row, int col) const {
+		int rows = (int) m_envmap.rows(), cols = (int) m_envmap.cols();
+		if (col < 0) {
+			col = -col - 1;
+			row = rows - 1 - row;
+		} else if (col >= cols) {
+			col = 2 * cols - 1 - col;
+			row = rows - 1 - row;
+		}
+		if (row < 0) {
+			col = cols - 1 - col;
+			row = -row - 1;
+		} else if (row >= rows) {
+			col = cols - 1 - col;
+			row = 2 * rows - 1 - row;
+		}
+		return m_envmap(clamp(row, 0, rows - 1), clamp(col, 0, cols - 1));
+	}
 
-
+	/// Solid angle density of the directions within a texel of the octahedral map
+	float texelPdf(size_t row, size_t col) const {
+		return m_rowDistr[row] * m_colDistr[row][col] * m_envmap.size() / (4 * M_PI);
+	}
 
 	std::string toString() const {
 		return tfm::format("EnvironmentalLight[radiance=%s]", m_radiance.toString());
 	}
 
 private:
+	const Scene *m_scene = nullptr;
 	Texture * m_texture = nullptr;
+	/// Radiance of the texture as an equal-area octahedral map
+	Bitmap m_envmap;
 	Color3f m_radiance;
 	float m_angle;
 	Transform m_toWorld;
 	Transform m_toLocal;
 	Mesh *m_mesh;
-	DiscretePDF distr;
+	/// Marginal distribution of the texture rows
+	DiscretePDF m_rowDistr;
+	/// Conditional distribution of the columns within every row
+	std::vector<DiscretePDF> m_colDistr;
 };
 
 NORI_REGISTER_CLASS(EnvironmentalLight, "environmental light");
@@ -34,6 +34,9 @@ NORI_NAMESPACE_BEGIN
 
 #define PANEL_HEIGHT 48
 
+/// Minimum number of milliseconds between two texture updates
+#define NORI_TEXTURE_UPLOAD_INTERVAL 100
+
 NoriScreen::NoriScreen(ImageBlock &block)
  : nanogui::Screen(block.getSize() + Vector2i(0, PANEL_HEIGHT), "Nori", false),
    m_block(block), m_renderThread(m_block)
@@ -140,17 +143,35 @@ NoriScreen::~NoriScreen() {
 }
 
 void NoriScreen::drawContents() {
-    /* Reload the partially rendered image onto the GPU */
-    m_block.lock();
-    int borderSize = m_block.getBorderSize();
-    const Vector2i &size = m_block.getSize();
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, m_texture);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, m_block.cols());
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size.x(), size.y(),
-            0, GL_RGBA, GL_FLOAT, (uint8_t *) m_block.data() +
-            (borderSize * m_block.cols() + borderSize) * sizeof(Color4f));
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    /* Upload the parts of the partially rendered image that changed onto the GPU.
+       This happens at a limited rate to keep the time spent holding the lock short */
+    m_block.lock();
+    int borderSize = m_block.getBorderSize();
+    Vector2i size = m_block.getSize();
+    if (size != m_textureSize || m_uploadTimer.elapsed() >= NORI_TEXTURE_UPLOAD_INTERVAL) {
+        m_uploadTimer.reset();
+        m_dirtyRegions.clear();
+        bool fullUpdate = m_renderThread.takeDirtyRegions(m_dirtyRegions) || size != m_textureSize;
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_block.cols());
+        if (fullUpdate) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size.x(), size.y(),
+                    0, GL_RGBA, GL_FLOAT, (uint8_t *) m_block.data() +
+                    (borderSize * m_block.cols() + borderSize) * sizeof(Color4f));
+            m_textureSize = size;
+        } else {
+            for (auto const &region : m_dirtyRegions) {
+                Vector2i regionSize = region.max - region.min;
+                glTexSubImage2D(GL_TEXTURE_2D, 0, region.min.x(), region.min.y(),
+                        regionSize.x(), regionSize.y(), GL_RGBA, GL_FLOAT, (uint8_t *) m_block.data() +
+                        ((borderSize + region.min.y()) * m_block.cols() + borderSize + region.min.x()) * sizeof(Color4f));
+            }
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
     m_block.unlock();
 
     m_progressBar->setValue(m_renderThread.getProgress());
@@ -196,6 +217,12 @@ bool NoriScreen::keyboardEvent(int key, int scancode, int action, int modifiers)
         m_renderThread.stopRendering();
         return true;
     }
+    if(action && key == GLFW_KEY_R && modifiers & GLFW_MOD_CONTROL) {
+        /* Discard the crop window and render the entire image again */
+        m_options.cropSize = Vector2i(-1, -1);
+        restartRendering();
+        return true;
+    }
 
     return nanogui::Screen::keyboardEvent(key,scancode,action,modifiers);
 }
@@ -209,7 +236,9 @@ void NoriScreen::openXML(const std::string &filename) {
 
     try {
 
-        m_renderThread.renderScene(filename);
+        m_filename = filename;
+        m_options = RenderOptions();
+        m_renderThread.renderScene(filename, m_options);
 
         m_block.lock();
         Vector2i bsize = m_block.getSize();
@@ -229,6 +258,86 @@ void NoriScreen::openXML(const std::string &filename) {
 
 }
 
+Vector2i NoriScreen::toImagePosition(const Eigen::Vector2i &p) const {
+    /* The image is drawn below the panel */
+    m_block.lock();
+    Vector2i size = m_block.getSize();
+    m_block.unlock();
+    return Vector2i(Vector2i(p.x(), p.y() - PANEL_HEIGHT).cwiseMax(0).cwiseMin(size));
+}
+
+bool NoriScreen::mouseButtonEvent(const Eigen::Vector2i &p, int button, bool down, int modifiers) {
+    if (nanogui::Screen::mouseButtonEvent(p, button, down, modifiers))
+        return true;
+    if (button != GLFW_MOUSE_BUTTON_1 || m_filename.empty())
+        return false;
+
+    if (down) {
+        if (p.y() < PANEL_HEIGHT)
+            return false;
+        m_dragging = true;
+        m_dragStart = m_dragEnd = toImagePosition(p);
+        return true;
+    }
+
+    if (!m_dragging)
+        return false;
+    m_dragging = false;
+
+    /* Ignore clicks without a noticeable drag */
+    Vector2i start(m_dragStart.cwiseMin(m_dragEnd)), end(m_dragStart.cwiseMax(m_dragEnd));
+    if ((end - start).minCoeff() < 4)
+        return true;
+
+    m_options.cropOffset = Point2i(start.x(), start.y());
+    m_options.cropSize = end - start;
+    restartRendering();
+    return true;
+}
+
+bool NoriScreen::mouseMotionEvent(const Eigen::Vector2i &p, const Eigen::Vector2i &rel, int button, int modifiers) {
+    if (m_dragging) {
+        m_dragEnd = toImagePosition(p);
+        return true;
+    }
+    return nanogui::Screen::mouseMotionEvent(p, rel, button, modifiers);
+}
+
+void NoriScreen::draw(NVGcontext *ctx) {
+    nanogui::Screen::draw(ctx);
+
+    /* Outline the crop window that is being selected or rendered */
+    Vector2i start, end;
+    if (m_dragging) {
+        start = m_dragStart.cwiseMin(m_dragEnd);
+        end = m_dragStart.cwiseMax(m_dragEnd);
+    } else if (m_options.cropSize.x() > 0 && m_options.cropSize.y() > 0) {
+        start = Vector2i(m_options.cropOffset.x(), m_options.cropOffset.y());
+        end = start + m_options.cropSize;
+    } else {
+        return;
+    }
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, start.x() + 0.5f, start.y() + PANEL_HEIGHT + 0.5f,
+            end.x() - start.x(), end.y() - start.y());
+    nvgStrokeColor(ctx, m_dragging ? nvgRGBA(255, 255, 255, 220) : nvgRGBA(255, 255, 255, 90));
+    nvgStrokeWidth(ctx, 1.0f);
+    nvgStroke(ctx);
+}
+
+void NoriScreen::restartRendering() {
+    if (m_filename.empty())
+        return;
+
+    m_renderThread.stopRendering();
+    try {
+        m_renderThread.renderScene(m_filename, m_options);
+    } catch (const std::exception &e) {
+        cerr << "Fatal error: " << e.what() << endl;
+    }
+}
+
 void NoriScreen::openEXR(const std::string &filename) {
 
     if(m_renderThread.isBusy()) {
@@ -238,6 +347,13 @@ void NoriScreen::openEXR(const std::string &filename) {
 
     Bitmap bitmap(filename);
 
+    /* Crop windows can only be selected while viewing a scene */
+    m_filename.clear();
+    m_options = RenderOptions();
+
+    /* Force a full texture upload */
+    m_textureSize = Vector2i(0, 0);
+
     m_block.lock();
     m_block.init(Vector2i(bitmap.cols(), bitmap.rows()), nullptr);
     m_block.fromBitmap(bitmap);
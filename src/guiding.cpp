@@ -0,0 +1,265 @@
+#include <nori/guiding.h>
+#include <nori/block.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+NORI_NAMESPACE_BEGIN
+
+/// Largest float below one, used to keep reused samples in [0, 1)
+static const float OneMinusEpsilon = 0.99999994f;
+
+/// Map a direction to the unit square (cylindrical coordinates)
+static Point2f dirToCanonical(const Vector3f &d) {
+    float cosTheta = std::min(std::max(d.z(), -1.f), 1.f);
+    float phi = std::atan2(d.y(), d.x());
+    if (phi < 0)
+        phi += 2 * M_PI;
+    return Point2f(
+        std::min((cosTheta + 1) * 0.5f, OneMinusEpsilon),
+        std::min(phi * INV_TWOPI, OneMinusEpsilon));
+}
+
+/// Inverse of \ref dirToCanonical()
+static Vector3f canonicalToDir(const Point2f &p) {
+    float cosTheta = 2 * p.x() - 1;
+    float sinTheta = std::sqrt(std::max(0.f, 1 - cosTheta * cosTheta));
+    float phi = 2 * M_PI * p.y();
+    return Vector3f(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+/// Quadrant of a point in the unit square; the point is rescaled to the quadrant
+static int quadrant(Point2f &p) {
+    int index = 0;
+    for (int i = 0; i < 2; ++i) {
+        if (p[i] < 0.5f) {
+            p[i] *= 2;
+        } else {
+            p[i] = p[i] * 2 - 1;
+            index |= 1 << i;
+        }
+    }
+    return index;
+}
+
+DTree::Node::Node() {
+    for (int i = 0; i < 4; ++i) {
+        sum[i].store(0.f, std::memory_order_relaxed);
+        children[i] = 0;
+    }
+}
+
+DTree::Node::Node(const Node &other) {
+    *this = other;
+}
+
+DTree::Node &DTree::Node::operator=(const Node &other) {
+    for (int i = 0; i < 4; ++i) {
+        sum[i].store(other.sum[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        children[i] = other.children[i];
+    }
+    return *this;
+}
+
+DTree::DTree() : m_nodes(1) { }
+
+void DTree::record(const Vector3f &d, float value) {
+    if (!(value > 0) || !std::isfinite(value))
+        return;
+    Point2f p = dirToCanonical(d);
+    uint32_t node = 0;
+    while (true) {
+        int q = quadrant(p);
+        atomicAdd(m_nodes[node].sum[q], value);
+        node = m_nodes[node].children[q];
+        if (node == 0)
+            break;
+    }
+}
+
+float DTree::pdf(const Vector3f &d) const {
+    Point2f p = dirToCanonical(d);
+    float pdf = INV_FOURPI;
+    uint32_t node = 0;
+    while (true) {
+        float total = m_nodes[node].getTotal();
+        /* Uniform within quadrants that did not receive any energy */
+        if (total <= 0)
+            return pdf;
+        int q = quadrant(p);
+        pdf *= 4 * m_nodes[node].sum[q].load(std::memory_order_relaxed) / total;
+        node = m_nodes[node].children[q];
+        if (node == 0 || pdf == 0)
+            return pdf;
+    }
+}
+
+Vector3f DTree::sample(Point2f sample) const {
+    Point2f origin(0.f, 0.f);
+    float size = 1.f;
+    uint32_t node = 0;
+    while (true) {
+        const Node &n = m_nodes[node];
+        float sums[4];
+        for (int i = 0; i < 4; ++i)
+            sums[i] = n.sum[i].load(std::memory_order_relaxed);
+        float total = sums[0] + sums[1] + sums[2] + sums[3];
+        if (total <= 0)
+            break;
+
+        /* Choose the column, then the quadrant within the column, and reuse the sample */
+        int q = 0;
+        float left = sums[0] + sums[2];
+        if (sample.x() < left / total) {
+            sample.x() = sample.x() * total / left;
+        } else {
+            sample.x() = (sample.x() - left / total) * total / (total - left);
+            q |= 1;
+        }
+        float column = sums[q] + sums[q | 2];
+        if (sample.y() < sums[q] / column) {
+            sample.y() = sample.y() * column / sums[q];
+        } else {
+            sample.y() = (sample.y() - sums[q] / column) * column / sums[q | 2];
+            q |= 2;
+        }
+        sample = Point2f(std::min(sample.x(), OneMinusEpsilon), std::min(sample.y(), OneMinusEpsilon));
+
+        size *= 0.5f;
+        origin += Vector2f((q & 1) ? size : 0.f, (q & 2) ? size : 0.f);
+        node = n.children[q];
+        if (node == 0)
+            break;
+    }
+    return canonicalToDir(origin + sample * size);
+}
+
+float DTree::getTotal() const {
+    return m_nodes[0].getTotal();
+}
+
+void DTree::build(const DTree &source, float threshold, int maxDepth) {
+    const uint32_t invalid = (uint32_t) -1;
+    struct Item {
+        uint32_t node, sourceNode;
+        int depth;
+    };
+
+    std::vector<Node> nodes(1);
+    nodes[0] = source.m_nodes[0];
+    for (int i = 0; i < 4; ++i)
+        nodes[0].children[i] = 0;
+
+    float total = source.getTotal();
+    std::vector<Item> stack;
+    stack.push_back(Item{0, 0, 1});
+    while (!stack.empty()) {
+        Item item = stack.back();
+        stack.pop_back();
+        if (item.depth >= maxDepth)
+            continue;
+
+        for (int q = 0; q < 4; ++q) {
+            float energy = nodes[item.node].sum[q].load(std::memory_order_relaxed);
+            if (!(total > 0) || energy <= threshold * total)
+                continue;
+
+            uint32_t sourceChild = item.sourceNode != invalid
+                ? source.m_nodes[item.sourceNode].children[q] : 0;
+            Node child;
+            if (sourceChild != 0) {
+                child = source.m_nodes[sourceChild];
+                for (int i = 0; i < 4; ++i)
+                    child.children[i] = 0;
+            } else {
+                for (int i = 0; i < 4; ++i)
+                    child.sum[i].store(energy * 0.25f, std::memory_order_relaxed);
+                sourceChild = invalid;
+            }
+
+            uint32_t index = (uint32_t) nodes.size();
+            nodes.push_back(child);
+            nodes[item.node].children[q] = index;
+            stack.push_back(Item{index, sourceChild, item.depth + 1});
+        }
+    }
+    m_nodes.swap(nodes);
+}
+
+void DTree::clear() {
+    for (Node &node : m_nodes)
+        for (int i = 0; i < 4; ++i)
+            node.sum[i].store(0.f, std::memory_order_relaxed);
+}
+
+SDTree::SDTree(const BoundingBox3f &bounds) {
+    /* Use a cube, so that the regions remain roughly cubical */
+    float size = bounds.getExtents().maxCoeff() * 1.01f;
+    Point3f center = bounds.getCenter();
+    m_bounds = BoundingBox3f(center - Vector3f(size * 0.5f), center + Vector3f(size * 0.5f));
+
+    m_nodes.push_back(Node{0, {0, 0}, 0});
+    m_regions.emplace_back(new Region());
+}
+
+SDTree::Region *SDTree::lookup(const Point3f &p) const {
+    Vector3f q = (p - m_bounds.min).cwiseQuotient(m_bounds.getExtents());
+    uint32_t node = 0;
+    while (m_nodes[node].children[0] != 0) {
+        int axis = m_nodes[node].axis;
+        float x = std::min(std::max(q[axis], 0.f), 1.f);
+        if (x < 0.5f) {
+            q[axis] = x * 2;
+            node = m_nodes[node].children[0];
+        } else {
+            q[axis] = x * 2 - 1;
+            node = m_nodes[node].children[1];
+        }
+    }
+    return m_regions[m_nodes[node].region].get();
+}
+
+void SDTree::refine(uint32_t splitThreshold, float threshold, int maxDepth) {
+    /* Split the leaves, assuming that their samples are distributed evenly
+       among the children. Nodes are appended, so the children are visited
+       (and possibly split again) by the same loop. */
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].children[0] != 0)
+            continue;
+        Region *region = m_regions[m_nodes[i].region].get();
+        uint32_t sampleCount = region->sampleCount.load();
+        if (sampleCount <= splitThreshold)
+            continue;
+
+        region->sampleCount = sampleCount / 2;
+        std::unique_ptr<Region> copy(new Region(*region));
+        int axis = (m_nodes[i].axis + 1) % 3;
+        uint32_t first = (uint32_t) m_nodes.size();
+        m_nodes.push_back(Node{axis, {0, 0}, m_nodes[i].region});
+        m_nodes.push_back(Node{axis, {0, 0}, (uint32_t) m_regions.size()});
+        m_regions.push_back(std::move(copy));
+        m_nodes[i].children[0] = first;
+        m_nodes[i].children[1] = first + 1;
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_regions.size()),
+        [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i != range.end(); ++i) {
+                Region &region = *m_regions[i];
+                if (region.building.getTotal() > 0) {
+                    region.sampling.build(region.building, threshold, maxDepth);
+                    region.building = region.sampling;
+                    region.building.clear();
+                }
+                region.sampleCount = 0;
+            }
+        });
+}
+
+std::string SDTree::toString() const {
+    size_t dTreeNodes = 0;
+    for (const auto &region : m_regions)
+        dTreeNodes += region->sampling.getNodeCount();
+    return tfm::format("SDTree[regions=%i, directional nodes=%i]", m_regions.size(), dTreeNodes);
+}
+
+NORI_NAMESPACE_END
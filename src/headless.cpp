@@ -0,0 +1,210 @@
+#include <nori/block.h>
+#include <nori/render.h>
+#include <nori/distributed.h>
+#include <nori/timer.h>
+#include <filesystem/path.h>
+#include <tbb/task_scheduler_init.h>
+#include <thread>
+#include <chrono>
+
+/* The interactive version obtains the image loader from NanoGUI,
+   which is not linked into the headless renderer */
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+/// Exit codes of the headless renderer
+enum EExitCode {
+    EExitOK = 0,
+    EExitUsage = 1,
+    EExitLoadError = 2,
+    EExitRenderError = 3
+};
+
+using namespace nori;
+
+static void help(const char *name) {
+    cout << "Syntax: " << name << " [options] <scene.xml>" << endl
+         << "        " << name << " --worker <host:port> [--threads <count>]" << endl
+         << "Options:" << endl
+         << "   -t, --threads <count>    Number of worker threads (default: all cores)" << endl
+         << "   --numa                   Pin the threads to NUMA nodes and keep tiles node-local" << endl
+         << "   -s, --spp <count>        Override the number of samples per pixel" << endl
+         << "   -r, --resolution <WxH>   Override the output resolution" << endl
+         << "   -o, --output <file>      Output file (.exr or .png, default: <scene>.exr)" << endl
+         << "   --crop <x,y,w,h>         Only render the given part of the image" << endl
+         << "   -c, --chunk <count>      Max. samples per pixel rendered per tile visit (default: 16)" << endl
+         << "   -f, --fis                Filter importance sampling instead of splatting" << endl
+         << "   -a, --adaptive           Adaptive sampling, the spp count becomes a per-pixel budget" << endl
+         << "   --min-spp <count>        Samples taken in every pixel in adaptive mode (default: 16)" << endl
+         << "   --error-threshold <err>  Relative error at which a pixel converges (default: 0.01)" << endl
+         << "   --error-target <err>     Stop once the mean relative error drops below this value" << endl
+         << "   --checkpoint <seconds>   Periodically save the render state to resume it later" << endl
+         << "   --checkpoint-file <file> Checkpoint file (default: <output>.ckpt)" << endl
+         << "   --resume                 Continue rendering from the checkpoint file" << endl
+         << "   --aovs                   Write albedo, normal, depth, IDs, sample count and" << endl
+         << "                            variance as additional layers of the EXR output" << endl
+         << "   --coordinator <port>     Distribute the tiles over worker processes that connect" << endl
+         << "                            to this port (0: any free port)" << endl
+         << "   --spawn <count>          Distribute the tiles over worker processes launched on" << endl
+         << "                            this machine (implies --coordinator 0)" << endl
+         << "   --worker <host:port>     Render tiles for a coordinator" << endl
+         << "   -h, --help               Print this message" << endl
+         << "Exit codes: 0 = success, 1 = invalid arguments," << endl
+         << "            2 = the scene could not be loaded, 3 = rendering failed" << endl;
+}
+
+int main(int argc, char **argv) {
+    RenderOptions options;
+    std::string filename, coordinatorAddress;
+    int coordinatorPort = -1, spawnCount = 0;
+
+    /* There is no display, so the film only needs to be assembled once at the end */
+    options.displayInterval = 0;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "-h" || arg == "--help") {
+                help(argv[0]);
+                return EExitOK;
+            } else if ((arg == "-t" || arg == "--threads") && hasValue) {
+                options.threadCount = toInt(argv[++i]);
+            } else if (arg == "--numa") {
+                options.numa = true;
+            } else if ((arg == "-s" || arg == "--spp") && hasValue) {
+                options.sampleCount = toInt(argv[++i]);
+            } else if ((arg == "-r" || arg == "--resolution") && hasValue) {
+                std::vector<std::string> tokens = tokenize(argv[++i], "x");
+                if (tokens.size() != 2)
+                    throw NoriException("Invalid resolution \"%s\", expected <width>x<height>", argv[i]);
+                options.resolution = Vector2i(toInt(tokens[0]), toInt(tokens[1]));
+            } else if ((arg == "-o" || arg == "--output") && hasValue) {
+                options.outputName = argv[++i];
+            } else if (arg == "--crop" && hasValue) {
+                std::vector<std::string> tokens = tokenize(argv[++i], ",");
+                if (tokens.size() != 4)
+                    throw NoriException("Invalid crop window \"%s\", expected <x>,<y>,<width>,<height>", argv[i]);
+                options.cropOffset = Point2i(toInt(tokens[0]), toInt(tokens[1]));
+                options.cropSize = Vector2i(toInt(tokens[2]), toInt(tokens[3]));
+            } else if ((arg == "-c" || arg == "--chunk") && hasValue) {
+                options.samplesPerChunk = toInt(argv[++i]);
+            } else if (arg == "-f" || arg == "--fis") {
+                options.filterImportanceSampling = true;
+            } else if (arg == "-a" || arg == "--adaptive") {
+                options.adaptive = true;
+            } else if (arg == "--min-spp" && hasValue) {
+                options.minSampleCount = toInt(argv[++i]);
+            } else if (arg == "--error-threshold" && hasValue) {
+                options.errorThreshold = toFloat(argv[++i]);
+            } else if (arg == "--error-target" && hasValue) {
+                options.errorTarget = toFloat(argv[++i]);
+            } else if (arg == "--checkpoint" && hasValue) {
+                options.checkpointInterval = toInt(argv[++i]);
+            } else if (arg == "--checkpoint-file" && hasValue) {
+                options.checkpointName = argv[++i];
+            } else if (arg == "--resume") {
+                options.resume = true;
+            } else if (arg == "--aovs") {
+                options.aovs = true;
+            } else if (arg == "--coordinator" && hasValue) {
+                coordinatorPort = toInt(argv[++i]);
+            } else if (arg == "--spawn" && hasValue) {
+                spawnCount = toInt(argv[++i]);
+                if (coordinatorPort < 0)
+                    coordinatorPort = 0;
+            } else if (arg == "--worker" && hasValue) {
+                coordinatorAddress = argv[++i];
+            } else if (arg[0] != '-' && filename.empty()) {
+                filename = arg;
+            } else {
+                throw NoriException("Invalid argument \"%s\"", arg);
+            }
+        }
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        help(argv[0]);
+        return EExitUsage;
+    }
+
+    /* Limit the number of threads used while loading the scene (e.g. BVH construction) */
+    tbb::task_scheduler_init init(options.threadCount > 0 ? options.threadCount
+        : tbb::task_scheduler_init::automatic);
+
+    if (!coordinatorAddress.empty()) {
+        size_t colon = coordinatorAddress.find_last_of(':');
+        if (colon == std::string::npos) {
+            cerr << "Error: invalid coordinator address \"" << coordinatorAddress
+                 << "\", expected <host>:<port>" << endl;
+            return EExitUsage;
+        }
+        try {
+            runRenderWorker(coordinatorAddress.substr(0, colon),
+                            toInt(coordinatorAddress.substr(colon + 1)), options.threadCount);
+        } catch (const std::exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return EExitRenderError;
+        }
+        return EExitOK;
+    }
+
+    if (filename.empty() || filesystem::path(filename).extension() != "xml") {
+        help(argv[0]);
+        return EExitUsage;
+    }
+
+    if (coordinatorPort >= 0) {
+        std::unique_ptr<RenderCoordinator> coordinator;
+        try {
+            coordinator.reset(new RenderCoordinator(filename, options, coordinatorPort));
+        } catch (const std::exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return EExitLoadError;
+        }
+
+        try {
+            cout << "Waiting for workers on port " << coordinator->getPort() << endl;
+            if (spawnCount > 0) {
+                int threadCount = options.threadCount > 0 ? options.threadCount : getCoreCount();
+                coordinator->spawnWorkers(argv[0], spawnCount, std::max(threadCount / spawnCount, 1));
+            }
+            coordinator->run();
+        } catch (const std::exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return EExitRenderError;
+        }
+        return EExitOK;
+    }
+
+    ImageBlock block(Vector2i(1, 1), nullptr);
+    RenderThread renderThread(block);
+
+    try {
+        if (!renderThread.renderScene(filename, options)) {
+            cerr << "Error: \"" << filename << "\" does not describe a scene" << endl;
+            return EExitLoadError;
+        }
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return EExitLoadError;
+    }
+
+    /* Report the progress until the render thread is done */
+    Timer timer;
+    int lastPercent = -1;
+    while (renderThread.isBusy()) {
+        int percent = (int) (renderThread.getProgress() * 100);
+        if (percent != lastPercent) {
+            double elapsed = timer.elapsed();
+            cout << "Progress: " << percent << "% (" << timer.elapsedString();
+            if (percent > 0)
+                cout << " elapsed, ~" << timeString(elapsed * (100 - percent) / percent) << " remaining";
+            cout << ")" << endl;
+            lastPercent = percent;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    return renderThread.hasFailed() ? EExitRenderError : EExitOK;
+}
@@ -0,0 +1,157 @@
+#include <nori/medium.h>
+#include <nori/volume.h>
+#include <nori/sampler.h>
+#include <nori/transform.h>
+#include <nori/warp.h>
+#include <filesystem/resolver.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Heterogeneous medium whose density is given by a grid in a volume file
+ *
+ * The extinction coefficient is <tt>scale * density</tt> and does not
+ * depend on the color channel, while the single-scattering \c albedo is
+ * constant. The grid's bounding box (as stored in the file) is mapped to
+ * the world by \c toWorld; outside of it, the medium is empty.
+ *
+ * Free paths are sampled by delta tracking, and transmittances are
+ * estimated by ratio tracking with Russian roulette. Both only step
+ * through the majorant cells of the grid (see \ref DensityGrid) that the
+ * ray passes, using each cell's own majorant, so that empty cells are
+ * skipped and thin cells take large steps.
+ */
+class HeterogeneousMedium : public Medium {
+public:
+	HeterogeneousMedium(const PropertyList &propList) {
+		filesystem::path filename =
+			getFileResolver()->resolve(propList.getString("filename"));
+		m_grid.reset(new DensityGrid(filename.str()));
+		m_scale = propList.getFloat("scale", 1.0f);
+		m_albedo = propList.getColor("albedo", Color3f(0.8f));
+		if (m_scale < 0)
+			throw NoriException("HeterogeneousMedium: the scale must be non-negative");
+
+		/* World space -> file space -> grid coordinates (voxel units) */
+		const BoundingBox3f &bbox = m_grid->getBoundingBox();
+		Eigen::Affine3f fileToGrid = Eigen::Affine3f::Identity();
+		fileToGrid.scale(m_grid->getResolution().cast<float>().cwiseQuotient(bbox.getExtents()));
+		fileToGrid.translate(-bbox.min);
+		m_worldToGrid = Transform(fileToGrid.matrix())
+			* propList.getTransform("toWorld", Transform()).inverse();
+	}
+
+	Color3f eval(const MediumQueryRecord &mRec) const {
+		return Color3f(1.0f);
+	}
+
+	float pdf(const MediumQueryRecord &mRec) const {
+		return Warp::squareToUniformSpherePdf(mRec.wo);
+	}
+
+	/// Sample the (isotropic) phase function at \c mRec.p; does not compute \c mRec.tr
+	Color3f sample(MediumQueryRecord &mRec, const Point2f &sample) const {
+		float sigmaT = density(m_worldToGrid * mRec.p);
+		mRec.sigma_t = Color3f(sigmaT);
+		mRec.sigma_s = m_albedo * sigmaT;
+		mRec.sigma_a = mRec.sigma_t - mRec.sigma_s;
+		mRec.albedo = m_albedo;
+		mRec.g = 0.0f;
+		mRec.wo = Warp::squareToUniformSphere(sample);
+		mRec.pdf = Warp::squareToUniformSpherePdf(mRec.wo);
+		mRec.pf = 1 / (4 * M_PI);
+		mRec.tr = Color3f(1.0f);
+		return Color3f(1.0f);
+	}
+
+	float sampleFreePath(const Point2f &sample) const {
+		throw NoriException("HeterogeneousMedium: free paths depend on the ray, use sampleDistance()");
+	}
+
+	float pdfFreePath(const MediumQueryRecord &mRec) const {
+		throw NoriException("HeterogeneousMedium: free paths depend on the ray, use sampleDistance()");
+	}
+
+	/// Delta tracking within every majorant cell along the ray
+	float sampleDistance(const Ray3f &ray, Sampler *sampler) const {
+		Ray3f gridRay = m_worldToGrid * ray;
+		float result = std::numeric_limits<float>::infinity();
+		m_grid->traverse(gridRay.o, gridRay.d, ray.mint, ray.maxt,
+			[&](float t0, float t1, float majorant) {
+				float sigmaMax = majorant * m_scale;
+				if (sigmaMax <= 0)
+					return true;
+				float t = t0;
+				while (true) {
+					t -= std::log(1 - sampler->next1D()) / sigmaMax;
+					if (t >= t1)
+						return true;
+					/* Real collision with probability sigma_t / majorant, null collision otherwise */
+					if (sampler->next1D() * sigmaMax < density(gridRay(t))) {
+						result = t;
+						return false;
+					}
+				}
+			});
+		return result;
+	}
+
+	/// Ratio tracking within every majorant cell along the ray
+	Color3f evalTransmittance(const Ray3f &ray, Sampler *sampler) const {
+		Ray3f gridRay = m_worldToGrid * ray;
+		float tr = 1.0f;
+		m_grid->traverse(gridRay.o, gridRay.d, ray.mint, ray.maxt,
+			[&](float t0, float t1, float majorant) {
+				float sigmaMax = majorant * m_scale;
+				if (sigmaMax <= 0)
+					return true;
+				float t = t0;
+				while (true) {
+					t -= std::log(1 - sampler->next1D()) / sigmaMax;
+					if (t >= t1)
+						return true;
+					tr *= 1 - density(gridRay(t)) / sigmaMax;
+
+					/* Russian roulette on low transmittances keeps the estimate unbiased */
+					if (tr < 0.1f) {
+						if (sampler->next1D() < 0.75f) {
+							tr = 0.0f;
+							return false;
+						}
+						tr /= 0.25f;
+					}
+				}
+			});
+		return Color3f(tr);
+	}
+
+	bool isInMedium(Point3f o) const {
+		Point3f p = m_worldToGrid * o;
+		return (p.array() >= 0).all() && (p.array() <= m_grid->getResolution().cast<float>().array()).all();
+	}
+
+	/// Return a human-readable summary
+	std::string toString() const {
+		return tfm::format(
+			"Heterogeneous Medium[\n"
+			"  grid = %s,\n"
+			"  scale = %f,\n"
+			"  albedo = %s\n"
+			"]",
+			indent(m_grid->toString()), m_scale, m_albedo.toString());
+	}
+
+private:
+	/// Extinction coefficient at a position in grid coordinates
+	float density(const Point3f &p) const {
+		return std::max(m_grid->lookup(p), 0.0f) * m_scale;
+	}
+
+	std::unique_ptr<DensityGrid> m_grid;
+	Transform m_worldToGrid;
+	float m_scale;     // extinction per unit density
+	Color3f m_albedo;  // single-scattering albedo
+};
+
+NORI_REGISTER_CLASS(HeterogeneousMedium, "heterogeneous");
+NORI_NAMESPACE_END
@@ -2,6 +2,7 @@
 #include <nori/warp.h>
 #include <nori/frame.h>
 #include <nori/mesh.h>
+#include <nori/sampler.h>
 
 NORI_NAMESPACE_BEGIN
 
@@ -56,6 +57,19 @@ public:
 		return result;
 	}
 
+	float sampleDistance(const Ray3f &ray, Sampler *sampler) const {
+		float t = sampleFreePath(sampler->next2D());
+		return t < ray.maxt ? t : std::numeric_limits<float>::infinity();
+	}
+
+	Color3f evalTransmittance(const Ray3f &ray, Sampler *sampler) const {
+		float dist = ray.maxt - ray.mint;
+		Color3f tr;
+		for (int i = 0; i < 3; ++i)
+			tr[i] = m_sigma_t[i] > 0 ? std::exp(-m_sigma_t[i] * dist) : 1.f;
+		return tr;
+	}
+
 	bool isHomogeneousMedium() const { return true; }
 
 	bool isInMedium(Point3f o) const {
@@ -18,6 +18,7 @@
 
 #include <nori/sampler.h>
 #include <nori/block.h>
+#include <nori/serialization.h>
 #include <pcg32.h>
 
 NORI_NAMESPACE_BEGIN
@@ -34,6 +35,7 @@ class Independent : public Sampler {
 public:
     Independent(const PropertyList &propList) {
         m_sampleCount = (size_t) propList.getInteger("sampleCount", 1);
+        m_seed = (uint32_t) propList.getInteger("seed", 0);
     }
 
     virtual ~Independent() { }
@@ -41,14 +43,17 @@ public:
     std::unique_ptr<Sampler> clone() const {
         std::unique_ptr<Independent> cloned(new Independent());
         cloned->m_sampleCount = m_sampleCount;
+        cloned->m_seed = m_seed;
         cloned->m_random = m_random;
         return std::move(cloned);
     }
 
     void prepare(const ImageBlock &block) {
+        /* Renders with different seeds use different random number streams
+           and can be averaged (e.g. partial renders on several machines) */
         m_random.seed(
             block.getOffset().x(),
-            block.getOffset().y()
+            block.getOffset().y() + ((uint64_t) m_seed << 32)
         );
     }
 
@@ -66,13 +71,24 @@ public:
         );
     }
 
+    void serialize(std::ostream &stream) const {
+        writeBinary(stream, m_random.state);
+        writeBinary(stream, m_random.inc);
+    }
+
+    void unserialize(std::istream &stream) {
+        readBinary(stream, m_random.state);
+        readBinary(stream, m_random.inc);
+    }
+
     virtual std::string toString() const {
-        return tfm::format("Independent[sampleCount=%i]", m_sampleCount);
+        return tfm::format("Independent[sampleCount=%i, seed=%i]", m_sampleCount, m_seed);
     }
 protected:
     Independent() { }
 
 private:
+    uint32_t m_seed = 0;
     pcg32 m_random;
 };
 
@@ -0,0 +1,233 @@
+#include <nori/lightbvh.h>
+#include <nori/emitter.h>
+#include <Eigen/Geometry>
+
+NORI_NAMESPACE_BEGIN
+
+/// Largest float below one, used to keep reused samples in [0, 1)
+static const float OneMinusEpsilon = 0.99999994f;
+
+static inline float safeSqrt(float value) {
+    return std::sqrt(std::max(0.f, value));
+}
+
+/// cos(max(0, a - b)) given the sines and cosines of a and b
+static inline float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB)
+        return 1.f;
+    return cosA * cosB + sinA * sinB;
+}
+
+/// sin(max(0, a - b)) given the sines and cosines of a and b
+static inline float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB)
+        return 0.f;
+    return sinA * cosB - cosA * sinB;
+}
+
+LightBounds LightBounds::merge(const LightBounds &a, const LightBounds &b) {
+    if (a.phi == 0)
+        return b;
+    if (b.phi == 0)
+        return a;
+
+    LightBounds result;
+    result.bounds = BoundingBox3f::merge(a.bounds, b.bounds);
+    result.phi = a.phi + b.phi;
+    result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+
+    /* Smallest cone of normals that contains both cones */
+    float thetaA = std::acos(clamp(a.cosThetaO, -1.f, 1.f));
+    float thetaB = std::acos(clamp(b.cosThetaO, -1.f, 1.f));
+    float thetaD = std::acos(clamp(a.axis.dot(b.axis), -1.f, 1.f));
+    if (std::min(thetaD + thetaB, (float) M_PI) <= thetaA) {
+        result.axis = a.axis;
+        result.cosThetaO = a.cosThetaO;
+        return result;
+    }
+    if (std::min(thetaD + thetaA, (float) M_PI) <= thetaB) {
+        result.axis = b.axis;
+        result.cosThetaO = b.cosThetaO;
+        return result;
+    }
+
+    float thetaO = (thetaA + thetaD + thetaB) / 2;
+    Vector3f rotationAxis = a.axis.cross(b.axis);
+    if (thetaO >= M_PI || rotationAxis.squaredNorm() == 0) {
+        result.axis = a.axis;
+        result.cosThetaO = -1.f;
+        return result;
+    }
+    result.axis = Eigen::AngleAxisf(thetaO - thetaA, rotationAxis.normalized()) * a.axis;
+    result.cosThetaO = std::cos(thetaO);
+    return result;
+}
+
+float LightBounds::importance(const Point3f &p) const {
+    if (phi == 0)
+        return 0.f;
+
+    /* Distance to the center, clamped so that points close to or inside
+       the bounds do not receive an arbitrarily large importance */
+    Point3f center = bounds.getCenter();
+    Vector3f toPoint = p - center;
+    float dist2 = std::max(toPoint.squaredNorm(), bounds.getExtents().norm() / 2);
+
+    /* Angle between the cone axis and the direction towards p */
+    float cosThetaW = toPoint.squaredNorm() > 0 ? axis.dot(toPoint.normalized()) : 1.f;
+    float sinThetaW = safeSqrt(1 - cosThetaW * cosThetaW);
+
+    /* Angle subtended by the bounds as seen from p */
+    float radius2 = bounds.getExtents().squaredNorm() / 4;
+    float cosThetaB = -1.f;
+    if (toPoint.squaredNorm() > radius2)
+        cosThetaB = safeSqrt(1 - radius2 / toPoint.squaredNorm());
+    float sinThetaB = safeSqrt(1 - cosThetaB * cosThetaB);
+
+    /* Smallest possible angle between an emitting normal and the direction
+       towards p: theta' = max(0, theta_w - theta_o - theta_b) */
+    float sinThetaO = safeSqrt(1 - cosThetaO * cosThetaO);
+    float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= cosThetaE)
+        return 0.f;
+
+    return std::max(0.f, phi * cosThetaP / dist2);
+}
+
+std::string LightBounds::toString() const {
+    return tfm::format("LightBounds[bounds=%s, axis=%s, cosThetaO=%f, cosThetaE=%f, phi=%f]",
+        bounds.toString(), axis.toString(), cosThetaO, cosThetaE, phi);
+}
+
+void LightBVH::build(const std::vector<Emitter *> &emitters) {
+    m_nodes.clear();
+    m_infinite.clear();
+    m_trails.assign(emitters.size(), 0);
+    m_bounded.assign(emitters.size(), false);
+
+    std::vector<std::pair<uint32_t, LightBounds>> lights;
+    for (uint32_t i = 0; i < (uint32_t) emitters.size(); ++i) {
+        LightBounds bounds;
+        if (!emitters[i]->getLightBounds(bounds)) {
+            m_infinite.push_back(i);
+        } else if (bounds.phi > 0) {
+            /* Emitters that emit nothing are never chosen */
+            m_bounded[i] = true;
+            lights.push_back(std::make_pair(i, bounds));
+        }
+    }
+
+    m_boundedCount = lights.size();
+    if (!lights.empty())
+        buildRecursive(lights, 0, lights.size(), 0, 0);
+}
+
+uint32_t LightBVH::buildRecursive(std::vector<std::pair<uint32_t, LightBounds>> &lights,
+                                  size_t begin, size_t end, uint64_t trail, int depth) {
+    uint32_t nodeIndex = (uint32_t) m_nodes.size();
+    m_nodes.push_back(Node());
+
+    if (end - begin == 1) {
+        Node &node = m_nodes[nodeIndex];
+        node.bounds = lights[begin].second;
+        node.index = lights[begin].first;
+        node.leaf = true;
+        m_trails[node.index] = trail;
+        return nodeIndex;
+    }
+
+    /* Split at the median along the axis of largest centroid extent */
+    BoundingBox3f centroids;
+    for (size_t i = begin; i < end; ++i)
+        centroids.expandBy(lights[i].second.bounds.getCenter());
+    int axis = centroids.getLargestAxis();
+    size_t mid = (begin + end) / 2;
+    std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end,
+        [axis](const std::pair<uint32_t, LightBounds> &a, const std::pair<uint32_t, LightBounds> &b) {
+            return a.second.bounds.getCenter()[axis] < b.second.bounds.getCenter()[axis];
+        });
+
+    buildRecursive(lights, begin, mid, trail, depth + 1);
+    uint32_t second = buildRecursive(lights, mid, end, trail | (1ull << depth), depth + 1);
+
+    Node &node = m_nodes[nodeIndex];
+    node.bounds = LightBounds::merge(m_nodes[nodeIndex + 1].bounds, m_nodes[second].bounds);
+    node.index = second;
+    node.leaf = false;
+    return nodeIndex;
+}
+
+int LightBVH::sample(const Point3f &p, float &sample, float &pmf) const {
+    size_t infiniteCount = m_infinite.size();
+    float pInfinite = infiniteCount / (float) (infiniteCount + (m_nodes.empty() ? 0 : 1));
+
+    if (sample < pInfinite) {
+        size_t index = std::min((size_t) (sample / pInfinite * infiniteCount), infiniteCount - 1);
+        pmf = pInfinite / infiniteCount;
+        sample = std::min(sample / pInfinite * infiniteCount - index, OneMinusEpsilon);
+        return (int) m_infinite[index];
+    }
+    if (m_nodes.empty())
+        return -1;
+
+    sample = std::min((sample - pInfinite) / (1 - pInfinite), OneMinusEpsilon);
+    pmf = 1 - pInfinite;
+    uint32_t nodeIndex = 0;
+    while (true) {
+        const Node &node = m_nodes[nodeIndex];
+        if (node.leaf)
+            return node.bounds.importance(p) > 0 ? (int) node.index : -1;
+
+        float importance0 = m_nodes[nodeIndex + 1].bounds.importance(p);
+        float importance1 = m_nodes[node.index].bounds.importance(p);
+        if (importance0 == 0 && importance1 == 0)
+            return -1;
+
+        float p0 = importance0 / (importance0 + importance1);
+        if (sample < p0) {
+            sample = std::min(sample / p0, OneMinusEpsilon);
+            pmf *= p0;
+            nodeIndex = nodeIndex + 1;
+        } else {
+            sample = std::min((sample - p0) / (1 - p0), OneMinusEpsilon);
+            pmf *= 1 - p0;
+            nodeIndex = node.index;
+        }
+    }
+}
+
+float LightBVH::pmf(const Point3f &p, int index) const {
+    size_t infiniteCount = m_infinite.size();
+    float pInfinite = infiniteCount / (float) (infiniteCount + (m_nodes.empty() ? 0 : 1));
+
+    if (!m_bounded[index]) {
+        if (std::find(m_infinite.begin(), m_infinite.end(), (uint32_t) index) == m_infinite.end())
+            return 0.f;
+        return pInfinite / infiniteCount;
+    }
+
+    float pmf = 1 - pInfinite;
+    uint64_t trail = m_trails[index];
+    uint32_t nodeIndex = 0;
+    while (!m_nodes[nodeIndex].leaf) {
+        const Node &node = m_nodes[nodeIndex];
+        float importance0 = m_nodes[nodeIndex + 1].bounds.importance(p);
+        float importance1 = m_nodes[node.index].bounds.importance(p);
+        if (importance0 == 0 && importance1 == 0)
+            return 0.f;
+
+        if (trail & 1) {
+            pmf *= importance1 / (importance0 + importance1);
+            nodeIndex = node.index;
+        } else {
+            pmf *= importance0 / (importance0 + importance1);
+            nodeIndex = nodeIndex + 1;
+        }
+        trail >>= 1;
+    }
+    return m_nodes[nodeIndex].bounds.importance(p) > 0 ? pmf : 0.f;
+}
+
+NORI_NAMESPACE_END
@@ -0,0 +1,92 @@
+#include <nori/bitmap.h>
+#include <filesystem/path.h>
+
+using namespace nori;
+
+static void help(const char *name) {
+    cout << "Syntax: " << name << " [-w <weight>] <input.exr> [[-w <weight>] <input.exr> ..] -o <output.exr>" << endl
+         << "Computes the weighted average of several renderings of the same scene," << endl
+         << "e.g. partial renders made with different sampler seeds." << endl
+         << "Options:" << endl
+         << "   -w, --weight <weight>    Weight of the next input, usually its number of" << endl
+         << "                            samples per pixel (default: 1)" << endl
+         << "   -o, --output <file>      Output file (.exr or .png)" << endl;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::pair<std::string, float>> inputs;
+    std::string outputName;
+
+    try {
+        float weight = 1.f;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "-h" || arg == "--help") {
+                help(argv[0]);
+                return 0;
+            } else if ((arg == "-w" || arg == "--weight") && hasValue) {
+                weight = toFloat(argv[++i]);
+                if (!(weight > 0))
+                    throw NoriException("Invalid weight \"%s\"", argv[i]);
+            } else if ((arg == "-o" || arg == "--output") && hasValue) {
+                outputName = argv[++i];
+            } else if (arg[0] != '-') {
+                inputs.push_back(std::make_pair(arg, weight));
+                weight = 1.f;
+            } else {
+                throw NoriException("Invalid argument \"%s\"", arg);
+            }
+        }
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        help(argv[0]);
+        return 1;
+    }
+
+    if (inputs.empty() || outputName.empty()) {
+        help(argv[0]);
+        return 1;
+    }
+
+    try {
+        Bitmap result;
+        float weightSum = 0.f;
+
+        for (auto const &input : inputs) {
+            if (filesystem::path(input.first).extension() != "exr")
+                throw NoriException("\"%s\": expected an OpenEXR file", input.first);
+
+            Bitmap bitmap(input.first);
+            if (weightSum == 0.f) {
+                result = Bitmap(Vector2i(bitmap.cols(), bitmap.rows()));
+                result.setConstant(Color3f(0.f));
+            } else if (bitmap.cols() != result.cols() || bitmap.rows() != result.rows()) {
+                throw NoriException("\"%s\" has a resolution of %ix%i, expected %ix%i", input.first,
+                    bitmap.cols(), bitmap.rows(), result.cols(), result.rows());
+            }
+
+            for (int y = 0; y < bitmap.rows(); ++y)
+                for (int x = 0; x < bitmap.cols(); ++x)
+                    result.coeffRef(y, x) += bitmap.coeff(y, x) * input.second;
+            weightSum += input.second;
+        }
+
+        for (int y = 0; y < result.rows(); ++y)
+            for (int x = 0; x < result.cols(); ++x)
+                result.coeffRef(y, x) /= weightSum;
+
+        if (filesystem::path(outputName).extension() == "png")
+            result.saveToLDR(outputName);
+        else
+            result.save(outputName);
+
+        cout << "Merged " << inputs.size() << " images into \"" << outputName << "\"" << endl;
+    } catch (const std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 2;
+    }
+
+    return 0;
+}
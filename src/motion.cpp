@@ -35,7 +35,9 @@ public:
 		/* Width and height in pixels. Default: 720p */
 		m_outputSize.x() = propList.getInteger("width", 1280);
 		m_outputSize.y() = propList.getInteger("height", 720);
-		m_invOutputSize = m_outputSize.cast<float>().cwiseInverse();
+
+		/* Optional crop window in pixels. Default: the entire image */
+		loadCropWindow(propList);
 
 		/* Specifies an optional camera-to-world transformation. Default: none */
 		m_cameraToWorld1 = propList.getTransform("toWorld", Transform());
@@ -58,6 +60,7 @@ public:
 	}
 
 	virtual void activate() {
+		m_invOutputSize = m_outputSize.cast<float>().cwiseInverse();
 		float aspect = m_outputSize.x() / (float)m_outputSize.y();
 
 		/* Project vectors in camera space onto a plane at z=1:
@@ -96,7 +99,8 @@ public:
 
 	Color3f sampleRay(Ray3f &ray,
 		const Point2f &samplePosition,
-		const Point2f &apertureSample) const {
+		const Point2f &apertureSample,
+		float time) const {
 		/* Compute the corresponding position on the
 		near plane (in local camera space) */
 		Point3f nearP = m_sampleToCamera * Point3f(
@@ -109,12 +113,13 @@ public:
 		float invZ = 1.0f / d.z();
 
 		// motion blur 
-		const Transform m_cameraToWorld = m_cameraToWorld1.animatedTransform(m_cameraToWorld2, ray.time);
+		const Transform m_cameraToWorld = m_cameraToWorld1.animatedTransform(m_cameraToWorld2, time);
 
 		ray.o = m_cameraToWorld * Point3f(0, 0, 0);
 		ray.d = m_cameraToWorld * d;
 		ray.mint = m_nearClip * invZ;
 		ray.maxt = m_farClip * invZ;
+		ray.time = time;
 		ray.update();
 
 		// PBRT p374-375: depth of field 
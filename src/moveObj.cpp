@@ -181,7 +181,6 @@ public:
 		Point3f p0 = m_V.col(i0), p1 = m_V.col(i1), p2 = m_V.col(i2);
 
 		Transform temp(m_trans2.getMatrix() * m_trans1.getMatrix().inverse());
-		float time = ((float)rand() / (RAND_MAX));
 		Transform trans_dt = Transform(Eigen::Matrix4f::Identity()).animatedTransform(temp, ray.time);
 		p0 = trans_dt * p0;
 		p1 = trans_dt * p1;
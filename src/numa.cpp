@@ -0,0 +1,90 @@
+#include <nori/numa.h>
+#include <fstream>
+
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
+NORI_NAMESPACE_BEGIN
+
+/// Parse a Linux CPU list such as "0-15,32-47"
+static std::vector<int> parseCpuList(const std::string &str) {
+    std::vector<int> cpus;
+    for (const std::string &range : tokenize(str, ",")) {
+        std::vector<int> bounds;
+        for (const std::string &value : tokenize(range, "-"))
+            bounds.push_back(toInt(value));
+        if (bounds.size() == 1)
+            cpus.push_back(bounds[0]);
+        else if (bounds.size() == 2)
+            for (int cpu = bounds[0]; cpu <= bounds[1]; ++cpu)
+                cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+NumaTopology::NumaTopology() {
+#if defined(__linux__)
+    for (int node = 0; ; ++node) {
+        std::ifstream is(tfm::format("/sys/devices/system/node/node%i/cpulist", node));
+        std::string line;
+        if (!is || !std::getline(is, line))
+            break;
+        try {
+            std::vector<int> cpus = parseCpuList(line);
+            if (!cpus.empty())
+                m_cpus.push_back(cpus);
+        } catch (const std::exception &) {
+            m_cpus.clear();
+            break;
+        }
+    }
+#endif
+
+    if (m_cpus.empty()) {
+        std::vector<int> cpus;
+        for (int i = 0; i < getCoreCount(); ++i)
+            cpus.push_back(i);
+        m_cpus.push_back(cpus);
+    }
+}
+
+std::string NumaTopology::toString() const {
+    std::string nodes;
+    for (size_t i = 0; i < m_cpus.size(); ++i)
+        nodes += tfm::format("%s%i CPUs", i > 0 ? ", " : "", m_cpus[i].size());
+    return tfm::format("NumaTopology[nodes=%i (%s)]", m_cpus.size(), nodes);
+}
+
+NumaThreadBinding::NumaThreadBinding(const NumaTopology &topology, int node) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            m_previousCpus.push_back(cpu);
+
+    CPU_ZERO(&set);
+    for (int cpu : topology.getCpus(node))
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        m_previousCpus.clear();
+#endif
+}
+
+NumaThreadBinding::~NumaThreadBinding() {
+#if defined(__linux__)
+    if (m_previousCpus.empty())
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : m_previousCpus)
+        CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+NORI_NAMESPACE_END
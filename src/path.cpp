@@ -0,0 +1,525 @@
+#include <nori/integrator.h>
+#include <nori/sampler.h>
+#include <nori/emitter.h>
+#include <nori/medium.h>
+#include <nori/bsdf.h>
+#include <nori/scene.h>
+#include <nori/camera.h>
+#include <nori/block.h>
+#include <nori/guiding.h>
+#include <nori/aov.h>
+#include <nori/timer.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+NORI_NAMESPACE_BEGIN
+
+/// Participating media supported by a path tracer variant
+enum EPathMedia {
+    /// No participating media
+    ENoMedia = 0,
+    /// A medium that fills the entire scene (see \ref Scene::getMedium())
+    ESceneMedium,
+    /// Media enclosed by the meshes they are attached to (see \ref Mesh::getMedium())
+    EMeshMedia
+};
+
+/// Russian roulette policy of a path tracer variant
+enum EPathRoulette {
+    /// Paths only end when they escape or reach the maximum depth
+    ENoRoulette = 0,
+    /// Continue with a probability proportional to the path throughput
+    EThroughputRoulette,
+    /// Continue with a fixed probability (the \c survivalProbability parameter)
+    EFixedRoulette
+};
+
+/**
+ * \brief Unidirectional path tracer whose features are selected at compile time
+ *
+ * The \c Features parameter is a policy class with the following members:
+ *
+ * - \c NEE: sample an emitter at every scattering vertex
+ * - \c MIS: combine emitter and BSDF sampling using the power heuristic
+ *   (requires \c NEE). Without it, emitters found by BSDF sampling only
+ *   contribute after specular bounces when \c NEE is enabled.
+ * - \c EnvLight: account for the environment emitter of the scene
+ * - \c Media: the kind of participating media (see \ref EPathMedia)
+ * - \c Roulette: the Russian roulette policy (see \ref EPathRoulette)
+ * - \c Guiding: sample the bounces at surfaces from a mixture of the BSDF
+ *   and a learned distribution of the incident radiance (see \ref SDTree)
+ * - \c name(): the name under which the variant is registered
+ *
+ * Every registered variant is a separate instantiation, hence the inner
+ * loop only contains the code paths that the variant actually uses.
+ * Runtime parameters are \c maxDepth (maximum number of bounces),
+ * \c rrDepth (number of bounces before Russian roulette starts) and
+ * \c survivalProbability.
+ *
+ * Variants with path guiding (Müller et al. 2017) learn the distribution
+ * of incident radiance in the preprocess. Training runs in iterations
+ * with 1, 2, 4, ... samples per pixel, whose images are discarded. Every
+ * iteration records the radiance found by its paths in the building trees
+ * of the \ref SDTree, and then refines the tree so that the next iteration
+ * samples from what was learned. Training stops once \c trainingSamples
+ * samples per pixel were traced, or before the next iteration would exceed
+ * \c trainingTime seconds (0: no time limit). During rendering, the tree is
+ * read-only, and every bounce at a surface is sampled by one-sample MIS:
+ * the BSDF is used with probability \c bsdfSamplingFraction and the
+ * tree otherwise, and the sample is weighted by the mixture density.
+ * Discrete samples of the BSDF are never guided; BSDFs are assumed to be
+ * either discrete or continuous.
+ */
+template <typename Features> class PathTracer : public Integrator {
+public:
+    static_assert(Features::NEE || !Features::MIS,
+        "Multiple importance sampling requires next event estimation");
+    static_assert(!Features::NEE || Features::Media != EMeshMedia,
+        "Shadow rays cannot pass through the boundaries of mesh media");
+
+    PathTracer(const PropertyList &propList) {
+        m_maxDepth = propList.getInteger("maxDepth", 100);
+        m_rrDepth = propList.getInteger("rrDepth", 3);
+        m_survivalProbability = propList.getFloat("survivalProbability", 0.9f);
+        if (Features::Guiding) {
+            m_trainingSamples = propList.getInteger("trainingSamples", 64);
+            m_trainingTime = propList.getFloat("trainingTime", 0.f);
+            m_bsdfSamplingFraction = propList.getFloat("bsdfSamplingFraction", 0.5f);
+            if (m_bsdfSamplingFraction <= 0 || m_bsdfSamplingFraction > 1)
+                throw NoriException("%s: bsdfSamplingFraction must be in (0, 1]", Features::name());
+        }
+    }
+
+    void preprocess(const Scene *scene) {
+        m_envEmitter = Features::EnvLight ? scene->getEnvEmitter() : nullptr;
+
+        m_medium = Features::Media == ESceneMedium ? scene->getMedium() : nullptr;
+
+        if (Features::Guiding)
+            train(scene);
+    }
+
+    Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &ray) const {
+        return trace(scene, sampler, ray, nullptr, nullptr);
+    }
+
+    Color3f LiAOV(const Scene *scene, Sampler *sampler, const Ray3f &ray, AOVRecord &aov) const {
+        return trace(scene, sampler, ray, nullptr, &aov);
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "PathTracer<%s>[\n"
+            "  maxDepth = %i,\n"
+            "  rrDepth = %i\n"
+            "]",
+            Features::name(), m_maxDepth, m_rrDepth);
+    }
+
+protected:
+    /// Surface vertices of a training path, whose incident radiance is recorded in the \ref SDTree
+    struct GuidingPath {
+        static const int MaxVertices = 32;
+
+        struct Vertex {
+            SDTree::Region *region;
+            /// Sampled direction (world space)
+            Vector3f d;
+            /// Path throughput including the sampled bounce
+            Color3f throughput;
+            /// Radiance arriving from \c d
+            Color3f radiance;
+            /// Density of \c d
+            float pdf;
+        };
+
+        Vertex vertices[MaxVertices];
+        int size = 0;
+
+        /// Add a contribution of the path to the image to the incident radiance of all vertices
+        void add(const Color3f &value) {
+            for (int i = 0; i < size; ++i) {
+                for (int c = 0; c < 3; ++c) {
+                    if (vertices[i].throughput[c] > 0)
+                        vertices[i].radiance[c] += value[c] / vertices[i].throughput[c];
+                }
+            }
+        }
+
+        /// Record the incident radiance of all vertices
+        void record() const {
+            for (int i = 0; i < size; ++i) {
+                const Vertex &v = vertices[i];
+                if (v.pdf > 0)
+                    v.region->record(v.d, v.radiance.getLuminance() / v.pdf);
+            }
+        }
+    };
+
+    /**
+     * \brief Trace a path, and record its radiance in the guiding tree when
+     * \c path is given, and the AOVs of its first surface when \c aov is given
+     */
+    Color3f trace(const Scene *scene, Sampler *sampler, const Ray3f &_ray,
+                  GuidingPath *path, AOVRecord *aov) const {
+        Color3f li(0.f), throughput(1.f);
+        Ray3f ray(_ray);
+        float time = _ray.time;
+        Intersection its;
+
+        /* Describes the sampling technique that generated 'ray', which is
+           needed to weight the emission found along it */
+        bool specular = true;
+        float dirPdf = 0.f;
+
+        for (int depth = 0; ; ++depth) {
+            bool hit = scene->rayIntersect(ray, its);
+
+            /* Participating media: sample a free path along the ray segment */
+            const Medium *medium = segmentMedium(ray, its, hit);
+            if (medium) {
+                float t = medium->sampleDistance(Ray3f(ray, ray.mint, hit ? its.t : ray.maxt), sampler);
+                if (t < std::numeric_limits<float>::infinity()) {
+                    Point3f p = ray(t);
+                    MediumQueryRecord mRec(medium, ray.o, p, Normal3f(-ray.d));
+                    medium->sample(mRec, sampler->next2D());
+                    throughput *= mRec.albedo;
+
+                    if (Features::NEE) {
+                        EmitterQueryRecord lRec(p);
+                        Color3f direct = scene->sampleDirect(lRec, sampler->next2D());
+                        if ((direct.array() != 0).any() && isVisible(scene, p, lRec, time)) {
+                            float weight = Features::MIS ? miWeight(scene->pdfDirect(lRec), mRec.pdf) : 1.f;
+                            addRadiance(li, throughput * direct * mRec.pf * transmittance(p, lRec, sampler) * weight, path);
+                        }
+                    }
+
+                    ray = Ray3f(p, mRec.wo);
+                    ray.time = time;
+                    specular = false;
+                    dirPdf = mRec.pdf;
+
+                    if (!continuePath(sampler, throughput, depth))
+                        break;
+                    continue;
+                }
+            }
+
+            if (!hit) {
+                if (Features::EnvLight && m_envEmitter) {
+                    EmitterQueryRecord lRec(m_envEmitter, ray);
+                    addRadiance(li, throughput * m_envEmitter->eval(lRec)
+                        * emissionWeight(scene, lRec, specular, dirPdf), path);
+                }
+                break;
+            }
+
+            if (its.mesh->isEmitter()) {
+                const Emitter *emitter = its.mesh->getEmitter();
+                EmitterQueryRecord lRec(emitter, ray.o, its.p, its.shFrame.n);
+                addRadiance(li, throughput * emitter->eval(lRec)
+                    * emissionWeight(scene, lRec, specular, dirPdf), path);
+            }
+
+            const BSDF *bsdf = its.mesh->getBSDF();
+            Vector3f wi = its.toLocal(-ray.d);
+            if (aov && depth == 0)
+                aov->setSurface(ray, its);
+            SDTree::Region *region = Features::Guiding && m_sdTree ? m_sdTree->lookup(its.p) : nullptr;
+
+            /* Next event estimation */
+            if (Features::NEE) {
+                EmitterQueryRecord lRec(its.p);
+                Color3f direct = scene->sampleDirect(lRec, sampler->next2D());
+                if ((direct.array() != 0).any()) {
+                    BSDFQueryRecord bRec(wi, its.toLocal(lRec.wi), ESolidAngle);
+                    bRec.uv = its.uv;
+                    bRec.p = its.p;
+                    Color3f f = bsdf->eval(bRec) * std::max(0.f, Frame::cosTheta(bRec.wo));
+                    if ((f.array() != 0).any() && isVisible(scene, its.p, lRec, time)) {
+                        float weight = Features::MIS ? miWeight(scene->pdfDirect(lRec),
+                            region ? guidedPdf(bsdf, bRec, region, its) : bsdf->pdf(bRec)) : 1.f;
+                        Color3f incident = direct * transmittance(its.p, lRec, sampler) * weight;
+                        addRadiance(li, throughput * f * incident, path);
+                        if (Features::Guiding && path)
+                            region->record(lRec.wi, incident.getLuminance());
+                    }
+                }
+            }
+
+            /* BSDF sampling */
+            BSDFQueryRecord bRec(wi);
+            bRec.uv = its.uv;
+            bRec.p = its.p;
+            Color3f weight = bsdf->sample(bRec, sampler->next2D());
+            specular = bRec.measure == EDiscrete;
+            if (aov && depth == 0)
+                aov->albedo = weight;
+            if (Features::Guiding && region && !specular) {
+                weight = sampleGuided(bsdf, bRec, region, its, weight, sampler, dirPdf);
+            } else {
+                dirPdf = Features::MIS && !specular ? bsdf->pdf(bRec) : 0.f;
+            }
+            throughput *= weight;
+
+            ray = Ray3f(its.p, its.toWorld(bRec.wo));
+            ray.time = time;
+
+            if (Features::Guiding && path && !specular && path->size < GuidingPath::MaxVertices)
+                path->vertices[path->size++] = typename GuidingPath::Vertex{
+                    region, ray.d, throughput, Color3f(0.f), dirPdf };
+
+            if (!continuePath(sampler, throughput, depth))
+                break;
+        }
+
+        if (Features::Guiding && path)
+            path->record();
+        return li;
+    }
+
+    /// Add a contribution to the radiance of a path and to the incident radiance of its guiding vertices
+    void addRadiance(Color3f &li, const Color3f &value, GuidingPath *path) const {
+        li += value;
+        if (Features::Guiding && path)
+            path->add(value);
+    }
+
+    /// Density of the mixture of BSDF and guiding distribution for the direction \c bRec.wo
+    float guidedPdf(const BSDF *bsdf, const BSDFQueryRecord &bRec,
+                    const SDTree::Region *region, const Intersection &its) const {
+        return m_bsdfSamplingFraction * bsdf->pdf(bRec)
+            + (1 - m_bsdfSamplingFraction) * region->sampling.pdf(its.toWorld(bRec.wo));
+    }
+
+    /**
+     * \brief Turn a continuous BSDF sample into a sample of the guiding mixture
+     *
+     * With probability <tt>1 - bsdfSamplingFraction</tt>, the direction of
+     * \c bRec is replaced by a sample of the guiding tree. Returns the
+     * weight of the sample with respect to the mixture density \c pdf.
+     */
+    Color3f sampleGuided(const BSDF *bsdf, BSDFQueryRecord &bRec, const SDTree::Region *region,
+                         const Intersection &its, const Color3f &bsdfWeight, Sampler *sampler,
+                         float &pdf) const {
+        /* Both samples are always drawn, so that the dimensions of the sampler stay aligned */
+        float choice = sampler->next1D();
+        Point2f sample = sampler->next2D();
+        pdf = 0.f;
+        if (choice < m_bsdfSamplingFraction) {
+            if (!(bsdfWeight.array() > 0).any())
+                return Color3f(0.f);
+        } else {
+            bRec.wo = its.toLocal(region->sampling.sample(sample));
+            bRec.measure = ESolidAngle;
+        }
+
+        pdf = guidedPdf(bsdf, bRec, region, its);
+        if (pdf <= 0)
+            return Color3f(0.f);
+        return bsdf->eval(bRec) * std::abs(Frame::cosTheta(bRec.wo)) / pdf;
+    }
+
+    /**
+     * \brief Learn the guiding tree in iterations with increasing sample counts
+     *
+     * The iterations use independent samplers with their own seed, so
+     * that the learned distribution does not correlate with the samples
+     * of the final render.
+     */
+    void train(const Scene *scene) {
+        const Camera *camera = scene->getCamera();
+        m_sdTree.reset(new SDTree(scene->getBoundingBox()));
+
+        PropertyList samplerProps;
+        samplerProps.setInteger("seed", 0x5eed);
+        std::unique_ptr<Sampler> samplerTemplate(static_cast<Sampler *>(
+            NoriObjectFactory::createInstance("independent", samplerProps)));
+
+        struct Tile {
+            Point2i offset;
+            Vector2i size;
+            std::unique_ptr<Sampler> sampler;
+        };
+        std::vector<Tile> tiles;
+        BlockGenerator blockGenerator(camera->getCropOffset(), camera->getCropSize(), NORI_BLOCK_SIZE);
+        ImageBlock tileBlock(Vector2i(NORI_BLOCK_SIZE), nullptr);
+        while (blockGenerator.next(tileBlock)) {
+            Tile tile;
+            tile.offset = tileBlock.getOffset();
+            tile.size = tileBlock.getSize();
+            tile.sampler = samplerTemplate->clone();
+            tile.sampler->prepare(tileBlock);
+            tiles.push_back(std::move(tile));
+        }
+
+        cout << "Training the path guiding tree .. ";
+        cout.flush();
+        Timer timer;
+        int trainedSamples = 0, iteration = 0;
+        double lastIterationTime = 0;
+        while (trainedSamples < m_trainingSamples) {
+            /* Stop before the next iteration (twice the samples of the last) exceeds the time budget */
+            if (iteration > 0 && m_trainingTime > 0
+                    && timer.elapsed() + 2 * lastIterationTime > m_trainingTime * 1000)
+                break;
+
+            Timer iterationTimer;
+            int spp = std::min(1 << std::min(iteration, 30), m_trainingSamples - trainedSamples);
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, tiles.size()),
+                [&](const tbb::blocked_range<size_t> &range) {
+                    for (size_t i = range.begin(); i != range.end(); ++i) {
+                        const Tile &tile = tiles[i];
+                        Sampler *sampler = tile.sampler.get();
+                        for (int y = 0; y < tile.size.y(); ++y) {
+                            for (int x = 0; x < tile.size.x(); ++x) {
+                                Point2f pixel((float) (tile.offset.x() + x), (float) (tile.offset.y() + y));
+                                for (int j = 0; j < spp; ++j) {
+                                    Point2f pixelSample = pixel + sampler->next2D();
+                                    Point2f apertureSample = sampler->next2D();
+                                    Ray3f ray;
+                                    float time = sampler->next1D();
+                                    Color3f value = camera->sampleRay(ray, pixelSample, apertureSample, time);
+                                    if ((value.array() > 0).any()) {
+                                        GuidingPath path;
+                                        trace(scene, sampler, ray, &path, nullptr);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                });
+
+            /* Regions split once they receive c * sqrt(spp) samples (c = 12000 in the paper) */
+            uint32_t splitThreshold = (uint32_t) (12000 * std::sqrt((float) spp));
+            m_sdTree->refine(splitThreshold, 0.01f, 20);
+            trainedSamples += spp;
+            ++iteration;
+            lastIterationTime = iterationTimer.elapsed();
+        }
+
+        cout << "done. (" << trainedSamples << " spp in " << iteration << " iterations, "
+             << m_sdTree->getRegionCount() << " regions, took " << timer.elapsedString() << ")" << endl;
+    }
+
+    /// Return the medium that the given ray segment passes through, if any
+    const Medium *segmentMedium(const Ray3f &ray, const Intersection &its, bool hit) const {
+        if (Features::Media == ESceneMedium)
+            return m_medium;
+        /* The segment lies inside a mesh medium when the ray leaves the mesh */
+        if (Features::Media == EMeshMedia && hit && its.mesh->isMedium()
+                && its.geoFrame.n.dot(ray.d) > 0)
+            return its.mesh->getMedium();
+        return nullptr;
+    }
+
+    /// Transmittance of the scene medium along the shadow ray from p to an emitter sample
+    Color3f transmittance(const Point3f &p, const EmitterQueryRecord &lRec, Sampler *sampler) const {
+        if (Features::Media != ESceneMedium || !m_medium)
+            return Color3f(1.f);
+        return m_medium->evalTransmittance(Ray3f(p, lRec.wi, 0.f, lRec.dist), sampler);
+    }
+
+    /// Weight of the emission found by a ray of the given sampling technique
+    float emissionWeight(const Scene *scene, const EmitterQueryRecord &lRec,
+                         bool specular, float dirPdf) const {
+        if (!Features::NEE || specular)
+            return 1.f;
+        if (!Features::MIS)
+            return 0.f;
+        return miWeight(dirPdf, scene->pdfDirect(lRec));
+    }
+
+    /// Check the maximum depth and play Russian roulette (updates the throughput)
+    bool continuePath(Sampler *sampler, Color3f &throughput, int depth) const {
+        if (depth + 1 >= m_maxDepth || !(throughput.array() > 0).any())
+            return false;
+        if (Features::Roulette == ENoRoulette || depth < m_rrDepth)
+            return true;
+
+        float survival = Features::Roulette == EThroughputRoulette
+            ? std::min(throughput.maxCoeff(), 0.99f) : m_survivalProbability;
+        if (sampler->next1D() >= survival)
+            return false;
+        throughput /= survival;
+        return true;
+    }
+
+    /// Is the emitter sample unoccluded as seen from p?
+    bool isVisible(const Scene *scene, const Point3f &p, const EmitterQueryRecord &lRec, float time) const {
+        Ray3f shadowRay(p, lRec.wi, Epsilon, lRec.dist - Epsilon);
+        shadowRay.time = time;
+        return !scene->rayIntersect(shadowRay);
+    }
+
+    inline float miWeight(float pdfA, float pdfB) const {
+        pdfA *= pdfA; pdfB *= pdfB;
+        return pdfA > 0 ? pdfA / (pdfA + pdfB) : 0.f;
+    }
+
+    int m_maxDepth;
+    int m_rrDepth;
+    float m_survivalProbability;
+    const Emitter *m_envEmitter = nullptr;
+    const Medium *m_medium = nullptr;
+    int m_trainingSamples = 0;
+    float m_trainingTime = 0.f;
+    float m_bsdfSamplingFraction = 1.f;
+    std::unique_ptr<SDTree> m_sdTree;
+};
+
+/// Brute force path tracing using BSDF sampling only
+struct PathMATS {
+    static const bool NEE = false, MIS = false, EnvLight = true, Guiding = false;
+    static const EPathMedia Media = ENoMedia;
+    static const EPathRoulette Roulette = EThroughputRoulette;
+    static const char *name() { return "path_mats"; }
+};
+
+/// Emitter sampling, emitters found by BSDF sampling only count after specular bounces
+struct PathNEE {
+    static const bool NEE = true, MIS = false, EnvLight = true, Guiding = false;
+    static const EPathMedia Media = ENoMedia;
+    static const EPathRoulette Roulette = EFixedRoulette;
+    static const char *name() { return "path_nee"; }
+};
+
+/// Emitter and BSDF sampling combined using multiple importance sampling
+struct PathMIS {
+    static const bool NEE = true, MIS = true, EnvLight = true, Guiding = false;
+    static const EPathMedia Media = ENoMedia;
+    static const EPathRoulette Roulette = EThroughputRoulette;
+    static const char *name() { return "path_mis"; }
+};
+
+/// Like \ref PathMIS, with bounces guided by a learned distribution of the incident radiance
+struct PathGuided {
+    static const bool NEE = true, MIS = true, EnvLight = true, Guiding = true;
+    static const EPathMedia Media = ENoMedia;
+    static const EPathRoulette Roulette = EThroughputRoulette;
+    static const char *name() { return "path_guided"; }
+};
+
+/// Like \ref PathMIS, within a (homogeneous or heterogeneous) medium that fills the scene
+struct PathVolumetric {
+    static const bool NEE = true, MIS = true, EnvLight = true, Guiding = false;
+    static const EPathMedia Media = ESceneMedium;
+    static const EPathRoulette Roulette = EThroughputRoulette;
+    static const char *name() { return "path_vol"; }
+};
+
+/// BSDF sampling with media enclosed by meshes
+struct PathVolumetric2 {
+    static const bool NEE = false, MIS = false, EnvLight = true, Guiding = false;
+    static const EPathMedia Media = EMeshMedia;
+    static const EPathRoulette Roulette = EThroughputRoulette;
+    static const char *name() { return "path_vol2"; }
+};
+
+NORI_REGISTER_TEMPLATED_CLASS(PathTracer, PathMATS, "path_mats");
+NORI_REGISTER_TEMPLATED_CLASS(PathTracer, PathNEE, "path_nee");
+NORI_REGISTER_TEMPLATED_CLASS(PathTracer, PathMIS, "path_mis");
+NORI_REGISTER_TEMPLATED_CLASS(PathTracer, PathGuided, "path_guided");
+NORI_REGISTER_TEMPLATED_CLASS(PathTracer, PathVolumetric, "path_vol");
+NORI_REGISTER_TEMPLATED_CLASS(PathTracer, PathVolumetric2, "path_vol2");
+NORI_NAMESPACE_END
@@ -0,0 +1,254 @@
+#include <nori/integrator.h>
+#include <nori/sampler.h>
+#include <nori/emitter.h>
+#include <nori/bsdf.h>
+#include <nori/scene.h>
+#include <numeric>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Wavefront path tracer with multiple importance sampling
+ *
+ * Instead of tracing one path at a time, this integrator receives all
+ * camera rays of an image block and advances the whole set of paths in
+ * stages, each of which is a tight loop over the paths still in flight:
+ *
+ * 1. Extension: intersect the current rays of all paths with the scene
+ * 2. Emission: add the emitted radiance of the surfaces (or the
+ *    environment) found by the extension rays and retire escaped paths
+ * 3. Material: shade the surface interactions grouped by BSDF, which
+ *    queues a shadow ray towards a sampled emitter position and samples
+ *    the direction of the next extension ray
+ * 4. Shadow: trace the queued shadow rays and add the contributions of
+ *    the unoccluded ones
+ *
+ * The path state is kept in a structure of arrays, and the list of
+ * active paths is compacted after every stage. Emitter and BSDF samples
+ * are combined using the power heuristic, and paths are terminated by
+ * Russian roulette after \c rrDepth bounces.
+ */
+class WavefrontPathTracer : public Integrator {
+public:
+    WavefrontPathTracer(const PropertyList &propList) {
+        /* Maximum number of bounces (-1: unlimited) */
+        m_maxDepth = propList.getInteger("maxDepth", -1);
+        /* Number of bounces before Russian roulette starts */
+        m_rrDepth = propList.getInteger("rrDepth", 5);
+    }
+
+    bool isWavefront() const { return true; }
+
+    Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &ray) const {
+        /* A single path is never interleaved with others, so the
+           sampler can simply continue the current pixel sample */
+        CameraRaySample sample;
+        sample.ray = ray;
+        sample.pixel = Point2i(0, 0);
+        sample.sampleIndex = 0;
+        sample.dimension = sampler->getDimension();
+
+        Color3f result;
+        trace(scene, sampler, &sample, &result, 1, false);
+        return result;
+    }
+
+    void LiWavefront(const Scene *scene, Sampler *sampler, const CameraRaySample *rays,
+                     Color3f *result, size_t count) const {
+        trace(scene, sampler, rays, result, count, true);
+    }
+
+    std::string toString() const {
+        return tfm::format("WavefrontPathTracer[maxDepth=%i, rrDepth=%i]", m_maxDepth, m_rrDepth);
+    }
+
+protected:
+    /// State of all paths in flight, stored as a structure of arrays
+    struct PathStates {
+        /// Current extension ray
+        std::vector<Ray3f> ray;
+        /// Surface interaction found by the extension ray (\c mesh is \c nullptr on a miss)
+        std::vector<Intersection> its;
+        /// Product of the BSDF sampling weights along the path
+        std::vector<Color3f> throughput;
+        /// Radiance gathered so far
+        std::vector<Color3f> radiance;
+        /// Solid angle density of the BSDF sample that generated the extension ray
+        std::vector<float> bsdfPdf;
+        /// Was the extension ray sampled from a discrete BSDF component?
+        std::vector<uint8_t> specular;
+        /// Pixel sample of the path and the next component to request from it
+        std::vector<Point2i> pixel;
+        std::vector<uint32_t> sampleIndex;
+        std::vector<uint32_t> dimension;
+
+        void resize(size_t count) {
+            ray.resize(count);
+            its.resize(count);
+            throughput.resize(count);
+            radiance.resize(count);
+            bsdfPdf.resize(count);
+            specular.resize(count);
+            pixel.resize(count);
+            sampleIndex.resize(count);
+            dimension.resize(count);
+        }
+    };
+
+    /// Shadow ray queued by the material stage
+    struct ShadowRay {
+        Ray3f ray;
+        /// Radiance that reaches the path if the ray is unoccluded
+        Color3f contribution;
+        /// Index of the path that queued the ray
+        uint32_t path;
+    };
+
+    void trace(const Scene *scene, Sampler *sampler, const CameraRaySample *rays,
+               Color3f *result, size_t count, bool interleaved) const {
+        PathStates paths;
+        paths.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            paths.ray[i] = rays[i].ray;
+            paths.throughput[i] = Color3f(1.f);
+            paths.radiance[i] = Color3f(0.f);
+            paths.bsdfPdf[i] = 0.f;
+            paths.specular[i] = true;
+            paths.pixel[i] = rays[i].pixel;
+            paths.sampleIndex[i] = rays[i].sampleIndex;
+            paths.dimension[i] = rays[i].dimension;
+        }
+
+        std::vector<uint32_t> active(count);
+        std::iota(active.begin(), active.end(), 0u);
+        std::vector<ShadowRay> shadowRays;
+        shadowRays.reserve(count);
+
+        for (int depth = 0; !active.empty(); ++depth) {
+            /* Extension stage */
+            for (uint32_t i : active) {
+                if (!scene->rayIntersect(paths.ray[i], paths.its[i]))
+                    paths.its[i].mesh = nullptr;
+            }
+
+            /* Emission stage */
+            size_t activeCount = 0;
+            for (uint32_t i : active) {
+                const Intersection &its = paths.its[i];
+                const Ray3f &ray = paths.ray[i];
+
+                if (!its.mesh) {
+                    if (scene->hasEnvEmitter())
+                        addEmission(scene, paths, i, EmitterQueryRecord(scene->getEnvEmitter(), ray));
+                    continue;
+                }
+                if (its.mesh->isEmitter())
+                    addEmission(scene, paths, i,
+                        EmitterQueryRecord(its.mesh->getEmitter(), ray.o, its.p, its.shFrame.n));
+
+                if (m_maxDepth >= 0 && depth >= m_maxDepth)
+                    continue;
+                active[activeCount++] = i;
+            }
+            active.resize(activeCount);
+
+            /* Material stage: group the surface interactions by BSDF, so that
+               every material is shaded in one go */
+            std::sort(active.begin(), active.end(), [&](uint32_t a, uint32_t b) {
+                const BSDF *bsdfA = paths.its[a].mesh->getBSDF();
+                const BSDF *bsdfB = paths.its[b].mesh->getBSDF();
+                if (bsdfA != bsdfB)
+                    return std::less<const BSDF *>()(bsdfA, bsdfB);
+                return a < b;
+            });
+
+            shadowRays.clear();
+            activeCount = 0;
+            for (uint32_t i : active) {
+                const Intersection &its = paths.its[i];
+                const BSDF *bsdf = its.mesh->getBSDF();
+                Vector3f wi = its.toLocal(-paths.ray[i].d);
+                float time = paths.ray[i].time;
+
+                if (interleaved) {
+                    sampler->startPixelSample(paths.pixel[i], paths.sampleIndex[i]);
+                    sampler->setDimension(paths.dimension[i]);
+                }
+
+                /* Next event estimation: queue a shadow ray towards a point on an emitter */
+                EmitterQueryRecord lRec(its.p);
+                Color3f direct = scene->sampleDirect(lRec, sampler->next2D());
+                if ((direct.array() != 0).any()) {
+                    BSDFQueryRecord bRec(wi, its.toLocal(lRec.wi), ESolidAngle);
+                    bRec.uv = its.uv;
+                    bRec.p = its.p;
+                    Color3f f = bsdf->eval(bRec) * std::max(0.f, Frame::cosTheta(bRec.wo));
+                    if ((f.array() != 0).any()) {
+                        ShadowRay shadow;
+                        shadow.ray = Ray3f(its.p, lRec.wi, Epsilon, lRec.dist - Epsilon);
+                        shadow.ray.time = time;
+                        shadow.contribution = paths.throughput[i] * direct * f
+                            * miWeight(scene->pdfDirect(lRec), bsdf->pdf(bRec));
+                        shadow.path = i;
+                        shadowRays.push_back(shadow);
+                    }
+                }
+
+                /* Sample the direction of the extension ray */
+                BSDFQueryRecord bRec(wi);
+                bRec.uv = its.uv;
+                bRec.p = its.p;
+                Color3f &throughput = paths.throughput[i];
+                throughput *= bsdf->sample(bRec, sampler->next2D());
+                paths.specular[i] = bRec.measure == EDiscrete;
+                paths.bsdfPdf[i] = paths.specular[i] ? 0.f : bsdf->pdf(bRec);
+
+                bool alive = (throughput.array() > 0).any();
+                if (alive && depth >= m_rrDepth) {
+                    float q = std::min(throughput.maxCoeff(), 0.99f);
+                    if (sampler->next1D() < q)
+                        throughput /= q;
+                    else
+                        alive = false;
+                }
+                paths.dimension[i] = sampler->getDimension();
+
+                if (!alive)
+                    continue;
+                paths.ray[i] = Ray3f(its.p, its.toWorld(bRec.wo));
+                paths.ray[i].time = time;
+                active[activeCount++] = i;
+            }
+            active.resize(activeCount);
+
+            /* Shadow stage */
+            for (const ShadowRay &shadow : shadowRays) {
+                if (!scene->rayIntersect(shadow.ray))
+                    paths.radiance[shadow.path] += shadow.contribution;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            result[i] = paths.radiance[i];
+    }
+
+    /// Add the radiance of an emitter found by the extension ray of a path
+    void addEmission(const Scene *scene, PathStates &paths, uint32_t i,
+                     const EmitterQueryRecord &lRec) const {
+        float weight = 1.f;
+        if (!paths.specular[i])
+            weight = miWeight(paths.bsdfPdf[i], scene->pdfDirect(lRec));
+        paths.radiance[i] += paths.throughput[i] * lRec.emitter->eval(lRec) * weight;
+    }
+
+    inline float miWeight(float pdfA, float pdfB) const {
+        pdfA *= pdfA; pdfB *= pdfB;
+        return pdfA > 0 ? pdfA / (pdfA + pdfB) : 0.f;
+    }
+
+    int m_maxDepth;
+    int m_rrDepth;
+};
+
+NORI_REGISTER_CLASS(WavefrontPathTracer, "path_wavefront");
+NORI_NAMESPACE_END
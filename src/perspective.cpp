@@ -35,7 +35,9 @@ public:
         /* Width and height in pixels. Default: 720p */
         m_outputSize.x() = propList.getInteger("width", 1280);
         m_outputSize.y() = propList.getInteger("height", 720);
-        m_invOutputSize = m_outputSize.cast<float>().cwiseInverse();
+
+        /* Optional crop window in pixels. Default: the entire image */
+        loadCropWindow(propList);
 
         /* Specifies an optional camera-to-world transformation. Default: none */
         m_cameraToWorld = propList.getTransform("toWorld", Transform());
@@ -57,6 +59,7 @@ public:
     }
 
     virtual void activate() {
+        m_invOutputSize = m_outputSize.cast<float>().cwiseInverse();
         float aspect = m_outputSize.x() / (float) m_outputSize.y();
 
         /* Project vectors in camera space onto a plane at z=1:
@@ -84,6 +87,16 @@ public:
         m_sampleToCamera = Transform( 
             Eigen::DiagonalMatrix<float, 3>(Vector3f(0.5f, -0.5f * aspect, 1.0f)) *
             Eigen::Translation<float, 3>(1.0f, -1.0f/aspect, 0.0f) * perspective).inverse();
+        m_cameraToSample = m_sampleToCamera.inverse();
+        m_worldToCamera = m_cameraToWorld.inverse();
+
+        /* Area of the film projected onto the plane at z=1, which normalizes the importance */
+        Point3f pMin = m_sampleToCamera * Point3f(0.0f, 0.0f, 0.0f);
+        Point3f pMax = m_sampleToCamera * Point3f(1.0f, 1.0f, 0.0f);
+        pMin /= pMin.z();
+        pMax /= pMax.z();
+        m_filmArea = std::abs((pMax.x() - pMin.x()) * (pMax.y() - pMin.y()));
+        m_apertureArea = m_apertureRadius > 0 ? (float) M_PI * m_apertureRadius * m_apertureRadius : 1.0f;
 
         /* If no reconstruction filter was assigned, instantiate a Gaussian filter */
         if (!m_rfilter) {
@@ -95,7 +108,8 @@ public:
 
     Color3f sampleRay(Ray3f &ray,
             const Point2f &samplePosition,
-            const Point2f &apertureSample) const {
+            const Point2f &apertureSample,
+            float time) const {
         /* Compute the corresponding position on the 
            near plane (in local camera space) */
         Point3f nearP = m_sampleToCamera * Point3f(
@@ -111,6 +125,7 @@ public:
         ray.d = m_cameraToWorld * d;
         ray.mint = m_nearClip * invZ;
         ray.maxt = m_farClip * invZ;
+        ray.time = time;
         ray.update();
 
 		// PBRT p374-375
@@ -128,6 +143,39 @@ public:
         return Color3f(1.0f);
     }
 
+    Color3f sampleDirection(CameraQueryRecord &cRec, const Point2f &sample) const {
+        Point2f pLens = m_apertureRadius * Warp::squareToUniformDisk(sample);
+        cRec.p = m_cameraToWorld * Point3f(pLens.x(), pLens.y(), 0.0f);
+        cRec.wi = cRec.p - cRec.ref;
+        cRec.dist = cRec.wi.norm();
+        cRec.wi /= cRec.dist;
+
+        /* Importance of the ray from the aperture towards the reference point */
+        Vector3f d = (m_worldToCamera * Vector3f(-cRec.wi)).normalized();
+        float cosTheta = d.z();
+        if (cosTheta <= 0 || !project(Point3f(pLens.x(), pLens.y(), 0.0f), d, cRec.pixel)) {
+            cRec.pdf = 0.0f;
+            return Color3f(0.0f);
+        }
+        float cos2Theta = cosTheta * cosTheta;
+        float importance = 1.0f / (m_filmArea * m_apertureArea * cos2Theta * cos2Theta);
+
+        /* Convert the density from the area of the aperture to solid angles at 'ref' */
+        cRec.pdf = cRec.dist * cRec.dist / (cosTheta * m_apertureArea);
+        return Color3f(importance / cRec.pdf);
+    }
+
+    void pdf(const Ray3f &ray, float &pdfPos, float &pdfDir) const {
+        pdfPos = pdfDir = 0.0f;
+        Vector3f d = (m_worldToCamera * ray.d).normalized();
+        float cosTheta = d.z();
+        Point2f pixel;
+        if (cosTheta <= 0 || !project(m_worldToCamera * ray.o, d, pixel))
+            return;
+        pdfPos = 1.0f / m_apertureArea;
+        pdfDir = 1.0f / (m_filmArea * cosTheta * cosTheta * cosTheta);
+    }
+
     virtual void addChild(NoriObject *obj) {
         switch (obj->getClassType()) {
             case EReconstructionFilter:
@@ -165,9 +213,30 @@ public:
         );
     }
 private:
+    /**
+     * \brief Find the position on the film that generates rays from the
+     * given point on the aperture in the given direction (both in camera space)
+     *
+     * \return \c false if that position lies outside of the film
+     */
+    bool project(const Point3f &pLens, const Vector3f &d, Point2f &pixel) const {
+        /* Follow the ray to the focal plane, and project that point through the center of the lens */
+        Point3f pFocus = pLens + d * ((m_apertureRadius > 0 ? m_focalDistance : 1.0f) / d.z());
+        Point3f sample = m_cameraToSample * pFocus;
+        pixel = Point2f(sample.x() * m_outputSize.x(), sample.y() * m_outputSize.y());
+        return pixel.x() >= 0 && pixel.y() >= 0 && pixel.x() < m_outputSize.x()
+            && pixel.y() < m_outputSize.y();
+    }
+
     Vector2f m_invOutputSize;
     Transform m_sampleToCamera;
+    Transform m_cameraToSample;
     Transform m_cameraToWorld;
+    Transform m_worldToCamera;
+    /// Area of the film at unit distance from the center of the lens
+    float m_filmArea;
+    /// Area of the aperture (1 for a pinhole camera)
+    float m_apertureArea;
     float m_apertureRadius;
     float m_focalDistance;
     float m_fov;
@@ -0,0 +1,32 @@
+#include <nori/photon.h>
+#include <nori/scene.h>
+#include <nori/emitter.h>
+
+NORI_NAMESPACE_BEGIN
+
+PhotonEmission::PhotonEmission(const Scene *scene) {
+    float radius = scene->getBoundingBox().getExtents().norm() / 2;
+    for (const Emitter *emitter : scene->getLights()) {
+        float weight = emitter->power().getLuminance();
+        if (emitter->isEnvironmentEmitter())
+            weight *= M_PI * radius * radius;
+        if (weight > 0) {
+            m_index[emitter] = m_emitters.size();
+            m_emitters.push_back(emitter);
+            m_distr.append(weight);
+        }
+    }
+    if (m_emitters.empty())
+        throw NoriException("PhotonEmission: the scene does not contain any emitters with nonzero power!");
+    m_distr.normalize();
+}
+
+Color3f PhotonEmission::sample(Ray3f &ray, float sample, const Point2f &sample1,
+                               const Point2f &sample2) const {
+    float pmf;
+    Normal3f n;
+    const Emitter *emitter = sampleEmitter(sample, pmf);
+    return emitter->samplePhoton(ray, n, sample1, sample2) / pmf;
+}
+
+NORI_NAMESPACE_END
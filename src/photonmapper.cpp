@@ -0,0 +1,365 @@
+#include <nori/integrator.h>
+#include <nori/sampler.h>
+#include <nori/emitter.h>
+#include <nori/bsdf.h>
+#include <nori/scene.h>
+#include <nori/photon.h>
+#include <nori/timer.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <pcg32.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Photon mapping with a final gather (Jensen 1996)
+ *
+ * In a preprocess, photon paths are traced from the emitters in parallel.
+ * Their hits on diffuse surfaces are stored in two kd-trees: the global
+ * map receives all of them, and the caustic map those that only passed
+ * through specular (discrete) surfaces before.
+ *
+ * Camera paths follow non-diffuse surfaces until they reach a diffuse
+ * one. There, the radiance is the sum of
+ * - direct illumination, using emitter sampling,
+ * - caustics, a density estimate of the caustic map,
+ * - indirect illumination, a final gather of \c gatherRays BSDF samples.
+ *   They also pass through non-diffuse surfaces, and at the first diffuse
+ *   surface they reach, a density estimate of the global map is used.
+ *
+ * With <tt>gatherRays = 0</tt>, the global map is instead visualized at
+ * the first diffuse surface, which is fast but blurry.
+ *
+ * Parameters:
+ * - \c photonCount: number of photons in the global map
+ * - \c causticPhotonCount: number of photons in the caustic map
+ * - \c photonRadius and \c causticRadius: radii of the density estimates.
+ *   The default is derived from the scene size.
+ */
+class PhotonMapper : public Integrator {
+public:
+    PhotonMapper(const PropertyList &propList) {
+        m_photonCount = (size_t) propList.getInteger("photonCount", 1000000);
+        m_causticPhotonCount = (size_t) propList.getInteger("causticPhotonCount", (int) m_photonCount);
+        m_photonRadius = propList.getFloat("photonRadius", 0.0f);
+        m_causticRadius = propList.getFloat("causticRadius", 0.0f);
+        m_gatherRays = propList.getInteger("gatherRays", 16);
+        /* Maximum number of bounces of photon and camera paths */
+        m_maxDepth = propList.getInteger("maxDepth", 32);
+        /* Number of bounces before Russian roulette starts on photon paths */
+        m_rrDepth = propList.getInteger("rrDepth", 3);
+        m_seed = (uint32_t) propList.getInteger("seed", 0);
+    }
+
+    void preprocess(const Scene *scene) {
+        if (m_photonRadius == 0)
+            m_photonRadius = scene->getBoundingBox().getExtents().norm() / 500.0f;
+        if (m_causticRadius == 0)
+            m_causticRadius = m_photonRadius;
+
+        cout << "Tracing photons .. ";
+        cout.flush();
+        Timer timer;
+
+        PhotonEmission emission(scene);
+        m_globalMap.reset(new PhotonMap());
+        m_causticMap.reset(new PhotonMap());
+        m_globalMap->reserve(m_photonCount);
+        m_causticMap->reserve(m_causticPhotonCount);
+
+        /* Trace rounds of photon batches until the maps are full. A map stops
+           accepting photons after the round that fills it, and its photons
+           are normalized by the number of paths traced up to then. */
+        const size_t batchCount = 4 * (size_t) std::max(1, getCoreCount());
+        bool globalOpen = m_photonCount > 0;
+        bool causticOpen = m_causticPhotonCount > 0 && m_gatherRays > 0;
+        size_t globalPaths = 0, causticPaths = 0, paths = 0;
+        uint64_t batchIndex = 0;
+        while (globalOpen || causticOpen) {
+            std::vector<PhotonBatch> batches(batchCount);
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, batchCount),
+                [&](const tbb::blocked_range<size_t> &range) {
+                    for (size_t i = range.begin(); i != range.end(); ++i)
+                        tracePhotons(scene, emission, batchIndex + i, globalOpen, causticOpen, batches[i]);
+                });
+            batchIndex += batchCount;
+            paths += batchCount * PhotonBatch::Size;
+
+            size_t globalSize = m_globalMap->size(), causticSize = m_causticMap->size();
+            for (const PhotonBatch &batch : batches) {
+                for (const Photon &photon : batch.global)
+                    m_globalMap->push_back(photon);
+                for (const Photon &photon : batch.caustic)
+                    m_causticMap->push_back(photon);
+            }
+
+            /* Maps that do not receive any photons during a whole round
+               (e.g. the caustic map of a scene without specular surfaces)
+               are closed as well */
+            if (globalOpen) {
+                globalPaths = paths;
+                globalOpen = m_globalMap->size() < m_photonCount && m_globalMap->size() > globalSize;
+            }
+            if (causticOpen) {
+                causticPaths = paths;
+                causticOpen = m_causticMap->size() < m_causticPhotonCount && m_causticMap->size() > causticSize;
+            }
+        }
+
+        normalize(*m_globalMap, globalPaths);
+        normalize(*m_causticMap, causticPaths);
+        if (m_globalMap->size() > 0)
+            m_globalMap->build();
+        if (m_causticMap->size() > 0)
+            m_causticMap->build();
+
+        cout << "done. (" << m_globalMap->size() << " global and " << m_causticMap->size()
+             << " caustic photons from " << paths << " paths, took " << timer.elapsedString() << ")" << endl;
+    }
+
+    Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &_ray) const {
+        Color3f li(0.0f), throughput(1.0f);
+        Ray3f ray(_ray);
+
+        /* Follow non-diffuse surfaces until reaching a diffuse one */
+        for (int depth = 0; depth < m_maxDepth; ++depth) {
+            Intersection its;
+            if (!scene->rayIntersect(ray, its)) {
+                if (scene->hasEnvEmitter()) {
+                    EmitterQueryRecord lRec(scene->getEnvEmitter(), ray);
+                    li += throughput * scene->getEnvEmitter()->eval(lRec);
+                }
+                break;
+            }
+
+            if (its.mesh->isEmitter()) {
+                const Emitter *emitter = its.mesh->getEmitter();
+                EmitterQueryRecord lRec(emitter, ray.o, its.p, its.shFrame.n);
+                li += throughput * emitter->eval(lRec);
+            }
+
+            const BSDF *bsdf = its.mesh->getBSDF();
+            Vector3f wi = its.toLocal(-ray.d);
+            if (bsdf->isDiffuse()) {
+                li += throughput * shade(scene, sampler, its, wi, ray.time);
+                break;
+            }
+
+            BSDFQueryRecord bRec(wi);
+            bRec.uv = its.uv;
+            bRec.p = its.p;
+            throughput *= bsdf->sample(bRec, sampler->next2D());
+            if ((throughput.array() == 0).all())
+                break;
+
+            float time = ray.time;
+            ray = Ray3f(its.p, its.toWorld(bRec.wo));
+            ray.time = time;
+        }
+        return li;
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "PhotonMapper[\n"
+            "  photonCount = %i,\n"
+            "  causticPhotonCount = %i,\n"
+            "  photonRadius = %f,\n"
+            "  causticRadius = %f,\n"
+            "  gatherRays = %i,\n"
+            "  maxDepth = %i\n"
+            "]",
+            m_photonCount, m_causticPhotonCount, m_photonRadius,
+            m_causticRadius, m_gatherRays, m_maxDepth);
+    }
+
+protected:
+    /// Photons stored by a batch of photon paths
+    struct PhotonBatch {
+        /// Number of photon paths per batch
+        static const size_t Size = 4096;
+
+        std::vector<Photon> global;
+        std::vector<Photon> caustic;
+    };
+
+    /// Trace the photon paths of a batch, which use their own random number stream
+    void tracePhotons(const Scene *scene, const PhotonEmission &emission, uint64_t batchIndex,
+                      bool storeGlobal, bool storeCaustic, PhotonBatch &batch) const {
+        pcg32 random;
+        random.seed(batchIndex, m_seed);
+
+        for (size_t i = 0; i < PhotonBatch::Size; ++i) {
+            Ray3f ray;
+            float emitterSample = random.nextFloat();
+            Point2f positionSample(random.nextFloat(), random.nextFloat());
+            Point2f directionSample(random.nextFloat(), random.nextFloat());
+            Color3f power = emission.sample(ray, emitterSample, positionSample, directionSample);
+            float time = random.nextFloat();
+            ray.time = time;
+
+            /* Did the path only pass through specular surfaces so far? */
+            bool specular = true;
+            for (int depth = 0; depth < m_maxDepth && (power.array() > 0).any(); ++depth) {
+                Intersection its;
+                if (!scene->rayIntersect(ray, its))
+                    break;
+
+                const BSDF *bsdf = its.mesh->getBSDF();
+                if (bsdf->isDiffuse()) {
+                    Photon photon(its.p, PhotonData(-ray.d, power));
+                    if (storeGlobal)
+                        batch.global.push_back(photon);
+                    if (storeCaustic && specular && depth > 0)
+                        batch.caustic.push_back(photon);
+                }
+
+                BSDFQueryRecord bRec(its.toLocal(-ray.d));
+                bRec.uv = its.uv;
+                bRec.p = its.p;
+                Color3f f = bsdf->sample(bRec, Point2f(random.nextFloat(), random.nextFloat()));
+                specular &= bRec.measure == EDiscrete;
+
+                /* Russian roulette keeps the power of the photons roughly constant */
+                if (depth >= m_rrDepth) {
+                    float q = std::min(f.maxCoeff(), 0.99f);
+                    if (random.nextFloat() >= q)
+                        break;
+                    f /= q;
+                }
+                power *= f;
+                ray = Ray3f(its.p, its.toWorld(bRec.wo));
+                ray.time = time;
+            }
+        }
+    }
+
+    /// Divide the power of the photons by the number of emitted paths
+    static void normalize(PhotonMap &map, size_t paths) {
+        for (size_t i = 0; i < map.size(); ++i)
+            map[i].getData().power /= (float) paths;
+    }
+
+    /// Radiance leaving a diffuse surface towards \c wi (in local coordinates)
+    Color3f shade(const Scene *scene, Sampler *sampler, const Intersection &its,
+                  const Vector3f &wi, float time) const {
+        if (m_gatherRays == 0)
+            return estimate(*m_globalMap, m_photonRadius, its, wi);
+
+        Color3f result = direct(scene, sampler, its, wi, time)
+            + estimate(*m_causticMap, m_causticRadius, its, wi);
+
+        Color3f indirect(0.0f);
+        for (int i = 0; i < m_gatherRays; ++i)
+            indirect += gather(scene, sampler, its, wi, time);
+        return result + indirect / (float) m_gatherRays;
+    }
+
+    /// Direct illumination using emitter sampling
+    Color3f direct(const Scene *scene, Sampler *sampler, const Intersection &its,
+                   const Vector3f &wi, float time) const {
+        EmitterQueryRecord lRec(its.p);
+        Color3f value = scene->sampleDirect(lRec, sampler->next2D());
+        if ((value.array() == 0).all())
+            return Color3f(0.0f);
+
+        BSDFQueryRecord bRec(wi, its.toLocal(lRec.wi), ESolidAngle);
+        bRec.uv = its.uv;
+        bRec.p = its.p;
+        Color3f f = its.mesh->getBSDF()->eval(bRec) * std::max(0.0f, Frame::cosTheta(bRec.wo));
+        if ((f.array() == 0).all())
+            return Color3f(0.0f);
+
+        Ray3f shadowRay(its.p, lRec.wi, Epsilon, lRec.dist - Epsilon);
+        shadowRay.time = time;
+        return scene->rayIntersect(shadowRay) ? Color3f(0.0f) : value * f;
+    }
+
+    /**
+     * \brief Indirect illumination along one BSDF sample of the final gather
+     *
+     * Emission that the gather ray reaches directly or through specular
+     * surfaces is already accounted for by emitter sampling and the
+     * caustic map, so it only counts after a glossy bounce.
+     */
+    Color3f gather(const Scene *scene, Sampler *sampler, const Intersection &origin,
+                   const Vector3f &wi, float time) const {
+        BSDFQueryRecord bRec(wi);
+        bRec.uv = origin.uv;
+        bRec.p = origin.p;
+        Color3f throughput = origin.mesh->getBSDF()->sample(bRec, sampler->next2D());
+        Ray3f ray(origin.p, origin.toWorld(bRec.wo));
+        ray.time = time;
+
+        Color3f result(0.0f);
+        bool glossy = false;
+        for (int depth = 0; depth < m_maxDepth && (throughput.array() > 0).any(); ++depth) {
+            Intersection its;
+            if (!scene->rayIntersect(ray, its)) {
+                if (glossy && scene->hasEnvEmitter()) {
+                    EmitterQueryRecord lRec(scene->getEnvEmitter(), ray);
+                    result += throughput * scene->getEnvEmitter()->eval(lRec);
+                }
+                break;
+            }
+
+            if (glossy && its.mesh->isEmitter()) {
+                const Emitter *emitter = its.mesh->getEmitter();
+                EmitterQueryRecord lRec(emitter, ray.o, its.p, its.shFrame.n);
+                result += throughput * emitter->eval(lRec);
+            }
+
+            const BSDF *bsdf = its.mesh->getBSDF();
+            Vector3f wo = its.toLocal(-ray.d);
+            if (bsdf->isDiffuse()) {
+                result += throughput * estimate(*m_globalMap, m_photonRadius, its, wo);
+                break;
+            }
+
+            BSDFQueryRecord next(wo);
+            next.uv = its.uv;
+            next.p = its.p;
+            throughput *= bsdf->sample(next, sampler->next2D());
+            glossy |= next.measure != EDiscrete;
+            ray = Ray3f(its.p, its.toWorld(next.wo));
+            ray.time = time;
+        }
+        return result;
+    }
+
+    /// Density estimate of the radiance leaving a surface towards \c wi
+    Color3f estimate(const PhotonMap &map, float radius, const Intersection &its,
+                     const Vector3f &wi) const {
+        if (map.size() == 0)
+            return Color3f(0.0f);
+
+        std::vector<uint32_t> results;
+        map.search(its.p, radius, results);
+
+        const BSDF *bsdf = its.mesh->getBSDF();
+        Color3f sum(0.0f);
+        for (uint32_t index : results) {
+            const PhotonData &photon = map[index].getData();
+            BSDFQueryRecord bRec(wi, its.toLocal(photon.direction), ESolidAngle);
+            bRec.uv = its.uv;
+            bRec.p = its.p;
+            if (Frame::cosTheta(bRec.wo) > 0)
+                sum += bsdf->eval(bRec) * photon.power;
+        }
+        return sum / (M_PI * radius * radius);
+    }
+
+    size_t m_photonCount;
+    size_t m_causticPhotonCount;
+    float m_photonRadius;
+    float m_causticRadius;
+    int m_gatherRays;
+    int m_maxDepth;
+    int m_rrDepth;
+    uint32_t m_seed;
+    std::unique_ptr<PhotonMap> m_globalMap;
+    std::unique_ptr<PhotonMap> m_causticMap;
+};
+
+NORI_REGISTER_CLASS(PhotonMapper, "photonmapper");
+NORI_NAMESPACE_END
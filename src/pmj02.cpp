@@ -0,0 +1,256 @@
+#include <nori/sampler.h>
+#include <nori/block.h>
+#include <nori/qmc.h>
+#include <nori/serialization.h>
+#include <pcg32.h>
+
+NORI_NAMESPACE_BEGIN
+
+/// Side length of the tileable blue-noise mask
+#define NORI_BLUE_NOISE_RESOLUTION 64
+
+/**
+ * \brief Tileable blue-noise dither mask
+ *
+ * The mask is generated once using the void-and-cluster algorithm by
+ * Ulichney ("The void-and-cluster method for dither array generation",
+ * 1993) and stores a rank (i.e. a value in <tt>[0, N)</tt>, with
+ * <tt>N = res*res</tt>) per texel. Thresholding the mask at any level
+ * produces a point set without low-frequency structure.
+ */
+class BlueNoiseMask {
+public:
+    static const BlueNoiseMask &get() {
+        static BlueNoiseMask mask;
+        return mask;
+    }
+
+    /// Return the rank stored at a position of the (periodically extended) mask
+    uint32_t rank(int x, int y) const {
+        const int res = NORI_BLUE_NOISE_RESOLUTION;
+        x %= res; if (x < 0) x += res;
+        y %= res; if (y < 0) y += res;
+        return m_rank[y * res + x];
+    }
+
+private:
+    BlueNoiseMask() {
+        const int res = NORI_BLUE_NOISE_RESOLUTION, n = res * res;
+        const float sigma = 1.5f;
+
+        /* Tabulate the toroidally wrapped Gaussian energy kernel */
+        std::vector<float> kernel(n);
+        for (int y = 0; y < res; ++y) {
+            for (int x = 0; x < res; ++x) {
+                int dx = std::min(x, res - x), dy = std::min(y, res - y);
+                kernel[y * res + x] = std::exp(-(dx*dx + dy*dy) / (2 * sigma * sigma));
+            }
+        }
+
+        std::vector<bool> pattern(n, false);
+        std::vector<float> energy(n, 0.f);
+
+        auto splat = [&](int i, float sign) {
+            int ix = i % res, iy = i / res;
+            for (int y = 0; y < res; ++y) {
+                int ky = (y - iy + res) % res;
+                for (int x = 0; x < res; ++x)
+                    energy[y * res + x] += sign * kernel[ky * res + (x - ix + res) % res];
+            }
+        };
+
+        /* Tightest cluster (max. energy among ones) or largest void (min. energy among zeros) */
+        auto find = [&](bool cluster) {
+            int best = -1;
+            for (int i = 0; i < n; ++i) {
+                if (pattern[i] != cluster)
+                    continue;
+                if (best < 0 || (cluster ? energy[i] > energy[best] : energy[i] < energy[best]))
+                    best = i;
+            }
+            return best;
+        };
+
+        /* Random initial binary pattern with ~10% of the pixels set */
+        pcg32 random;
+        int ones = 0;
+        while (ones < n / 10) {
+            int i = (int) random.nextUInt((uint32_t) n);
+            if (pattern[i])
+                continue;
+            pattern[i] = true;
+            splat(i, 1.f);
+            ones++;
+        }
+
+        /* Relax it by moving points from the tightest cluster into the largest void */
+        for (int it = 0; it < n; ++it) {
+            int c = find(true);
+            pattern[c] = false;
+            splat(c, -1.f);
+            int v = find(false);
+            pattern[v] = true;
+            splat(v, 1.f);
+            if (v == c)
+                break;
+        }
+
+        m_rank.resize(n);
+        std::vector<bool> initial = pattern;
+        std::vector<float> initialEnergy = energy;
+
+        /* Phase 1: rank the initial points by removing tightest clusters */
+        for (int rank = ones - 1; rank >= 0; --rank) {
+            int c = find(true);
+            pattern[c] = false;
+            splat(c, -1.f);
+            m_rank[c] = (uint32_t) rank;
+        }
+
+        /* Phase 2 and 3: fill the largest voids until the mask is complete */
+        pattern = initial;
+        energy = initialEnergy;
+        for (int rank = ones; rank < n; ++rank) {
+            int v = find(false);
+            pattern[v] = true;
+            splat(v, 1.f);
+            m_rank[v] = (uint32_t) rank;
+        }
+    }
+
+    std::vector<uint32_t> m_rank;
+};
+
+/**
+ * \brief Progressive multi-jittered (0,2) sampler with blue-noise
+ * pixel decorrelation
+ *
+ * Every 1D or 2D sample request is served by its own pmj02 sequence
+ * (Christensen et al., "Progressive Multi-Jittered Sample Sequences", 2018).
+ * Any prefix of such a sequence is stratified in 1D and with respect to all
+ * 2D elementary intervals of a power-of-two sample count, which makes this
+ * sampler a good match for progressive and time-budgeted renders that stop
+ * at arbitrary sample counts. The sequences are produced by the stochastic
+ * construction of Helmer et al. ("Stochastic Generation of (t, s) Sample
+ * Sequences", 2021), which is equivalent to the Owen-scrambled
+ * (0,2)-sequence provided by \ref qmc::sobol2D().
+ *
+ * All pixels share the same sequence per dimension, which is decorrelated
+ * across pixels by a per-pixel digital (XOR) shift taken from a blue-noise
+ * mask. Digital shifts map elementary intervals onto elementary intervals,
+ * hence the stratification of each pixel's samples is preserved, while the
+ * residual error is distributed as blue noise in screen space.
+ */
+class PMJ02 : public Sampler {
+public:
+    PMJ02(const PropertyList &propList) {
+        m_sampleCount = (size_t) propList.getInteger("sampleCount", 1);
+        m_seed = (uint32_t) propList.getInteger("seed", 0);
+        m_mask = &BlueNoiseMask::get();
+    }
+
+    virtual ~PMJ02() { }
+
+    std::unique_ptr<Sampler> clone() const {
+        std::unique_ptr<PMJ02> cloned(new PMJ02());
+        cloned->m_sampleCount = m_sampleCount;
+        cloned->m_seed = m_seed;
+        cloned->m_mask = m_mask;
+        cloned->m_pixel = m_pixel;
+        cloned->m_sampleIndex = m_sampleIndex;
+        cloned->m_dimension = m_dimension;
+        return std::move(cloned);
+    }
+
+    void prepare(const ImageBlock &block) {
+        m_pixel = block.getOffset();
+        m_sampleIndex = 0;
+        m_dimension = 0;
+    }
+
+    void generate() {
+        m_sampleIndex = 0;
+        m_dimension = 0;
+    }
+
+    void advance() {
+        m_sampleIndex++;
+        m_dimension = 0;
+    }
+
+    void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) {
+        m_pixel = pixel;
+        m_sampleIndex = sampleIndex;
+        m_dimension = 0;
+    }
+
+    uint32_t getDimension() const {
+        return m_dimension;
+    }
+
+    void setDimension(uint32_t dimension) {
+        m_dimension = dimension;
+    }
+
+    float next1D() {
+        uint32_t dim = m_dimension++;
+        uint32_t x, y;
+        qmc::sobol2D(m_sampleIndex, qmc::hashCombine(m_seed, dim), x, y);
+        return qmc::toFloat(x ^ pixelShift(2 * dim));
+    }
+
+    Point2f next2D() {
+        uint32_t dim = m_dimension++;
+        uint32_t x, y;
+        qmc::sobol2D(m_sampleIndex, qmc::hashCombine(m_seed, dim), x, y);
+        return Point2f(
+            qmc::toFloat(x ^ pixelShift(2 * dim)),
+            qmc::toFloat(y ^ pixelShift(2 * dim + 1))
+        );
+    }
+
+    void serialize(std::ostream &stream) const {
+        writeBinary(stream, m_pixel);
+        writeBinary(stream, m_sampleIndex);
+        writeBinary(stream, m_dimension);
+    }
+
+    void unserialize(std::istream &stream) {
+        readBinary(stream, m_pixel);
+        readBinary(stream, m_sampleIndex);
+        readBinary(stream, m_dimension);
+    }
+
+    virtual std::string toString() const {
+        return tfm::format("PMJ02[sampleCount=%i, seed=%i]", m_sampleCount, m_seed);
+    }
+protected:
+    PMJ02() { }
+
+    /**
+     * \brief Digital shift of the current pixel for a given component
+     *
+     * The blue-noise rank provides the most significant bits, and each
+     * component uses a different toroidal offset into the mask so that the
+     * shifts of different dimensions are uncorrelated.
+     */
+    uint32_t pixelShift(uint32_t component) const {
+        const int res = NORI_BLUE_NOISE_RESOLUTION;
+        uint32_t h = qmc::hashCombine(m_seed, component);
+        uint32_t rank = m_mask->rank(m_pixel.x() + (int) (h % res),
+                                     m_pixel.y() + (int) ((h / res) % res));
+        /* The mask has res*res = 2^12 levels; fill the remaining bits randomly */
+        uint32_t low = qmc::hashCombine(h, qmc::hashCombine(m_pixel.x(), m_pixel.y()));
+        return (rank << 20) | (low & 0xFFFFFu);
+    }
+
+private:
+    uint32_t m_seed = 0;
+    const BlueNoiseMask *m_mask = nullptr;
+    Point2i m_pixel = Point2i(0, 0);
+    uint32_t m_sampleIndex = 0;
+    uint32_t m_dimension = 0;
+};
+
+NORI_REGISTER_CLASS(PMJ02, "pmj02");
+NORI_NAMESPACE_END
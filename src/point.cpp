@@ -1,4 +1,6 @@
 #include <nori/emitter.h>
+#include <nori/lightbvh.h>
+#include <nori/warp.h>
 
 NORI_NAMESPACE_BEGIN
 
@@ -36,6 +38,35 @@ public:
 		return 1.0f;
 	}
 
+	/// Uniformly distributed direction
+	Color3f samplePhoton(Ray3f &ray, Normal3f &n, const Point2f &sample1, const Point2f &sample2) const {
+		ray = Ray3f(m_position, Warp::squareToUniformSphere(sample2));
+		n = Normal3f(0.0f);
+		return m_power;
+	}
+
+	void pdfPhoton(const EmitterQueryRecord &lRec, float &pdfPos, float &pdfDir) const {
+		pdfPos = 1.0f;
+		pdfDir = INV_FOURPI;
+	}
+
+	bool isPointEmitter() const { return true; }
+
+	/// The \c power parameter is the flux emitted into all directions
+	Color3f power() const {
+		return m_power;
+	}
+
+	/// Emits into all directions from a single point
+	bool getLightBounds(LightBounds &bounds) const {
+		bounds.bounds = BoundingBox3f(m_position);
+		bounds.axis = Vector3f(0.0f, 0.0f, 1.0f);
+		bounds.cosThetaO = -1.0f;
+		bounds.cosThetaE = 0.0f;
+		bounds.phi = power().getLuminance();
+		return true;
+	}
+
 	/// Return a human-readable summary
 	std::string toString() const {
 		return tfm::format(
@@ -25,20 +25,36 @@
 #include <nori/bitmap.h>
 #include <nori/sampler.h>
 #include <nori/integrator.h>
-#include <nori/gui.h>
+#include <nori/rfilter.h>
+#include <nori/serialization.h>
+#include <nori/numa.h>
 #include <tbb/parallel_for.h>
 #include <tbb/blocked_range.h>
 #include <filesystem/resolver.h>
-#include <tbb/concurrent_vector.h>
+#include <tbb/concurrent_queue.h>
+#include <tbb/task_scheduler_init.h>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <condition_variable>
+#include <mutex>
+#include <chrono>
 
 
+/// Identifies render checkpoint files ("CKPT")
+#define NORI_CHECKPOINT_MAGIC 0x54504B43
+
+/// Version of the checkpoint file format
+#define NORI_CHECKPOINT_VERSION 2
+
 NORI_NAMESPACE_BEGIN
 
 RenderThread::RenderThread(ImageBlock & block) :
-        m_block(block)
+        m_block(block), m_backBuffer(Vector2i(0, 0), nullptr)
 {
     m_render_status = 0;
     m_progress = 1.f;
+    m_failed = false;
 }
 RenderThread::~RenderThread() {
     stopRendering();
@@ -69,37 +85,144 @@ float RenderThread::getProgress() {
     else return 1.f;
 }
 
-static void renderBlock(const Scene *scene, Sampler *sampler, ImageBlock &block) {
+/**
+ * Sample a camera ray for a pixel sample (the sampler must already be
+ * positioned at it). Returns the importance weight of the ray, along with
+ * the position of the sample on the film and its filter weight.
+ */
+static Color3f sampleCameraRay(const Camera *camera, Sampler *sampler, const Point2i &pixel,
+                               const ReconstructionFilter *fisFilter, Ray3f &ray,
+                               Point2f &pixelSample, float &filterWeight) {
+    pixelSample = Point2f((float) pixel.x(), (float) pixel.y()) + sampler->next2D();
+    Point2f apertureSample = sampler->next2D();
+
+    filterWeight = 1.0f;
+    if (fisFilter) {
+        /* Draw the offset from the pixel center from the filter */
+        float weightX, weightY;
+        float dx = fisFilter->sample(pixelSample.x() - pixel.x(), weightX);
+        float dy = fisFilter->sample(pixelSample.y() - pixel.y(), weightY);
+        pixelSample = Point2f(pixel.x() + 0.5f + dx, pixel.y() + 0.5f + dy);
+        filterWeight = weightX * weightY;
+    }
+
+    /* Sample a ray from the camera */
+    float time = sampler->next1D();
+    return camera->sampleRay(ray, pixelSample, apertureSample, time);
+}
+
+void renderBlock(const Scene *scene, Sampler *sampler, ImageBlock &block,
+                 uint32_t sampleIndex, PixelStatistics *statistics,
+                 const ReconstructionFilter *fisFilter, const AOVBlocks *aovs) {
     const Camera *camera = scene->getCamera();
     const Integrator *integrator = scene->getIntegrator();
 
     Point2i offset = block.getOffset();
     Vector2i size  = block.getSize();
 
-    /* Clear the block contents */
-    block.clear();
+    /* Store the value (and AOVs) of a pixel sample in the image block */
+    auto put = [&](ImageBlock &target, const Point2i &pixel, const Point2f &pixelSample,
+                   const Color3f &value, float filterWeight) {
+        if (fisFilter)
+            target.putPixel(pixel, value, filterWeight);
+        else
+            target.put(pixelSample, value);
+    };
+    auto store = [&](const Point2i &pixel, const Point2f &pixelSample,
+                     const Color3f &value, float filterWeight, const AOVRecord &aov) {
+        put(block, pixel, pixelSample, value, filterWeight);
+
+        if (statistics && value.isValid())
+            statistics->put(pixel, value.getLuminance());
+
+        if (aovs) {
+            Color3f layers[EFilteredAOVCount];
+            layers[EAlbedoAOV] = aov.albedo.isValid() ? aov.albedo : Color3f(0.f);
+            layers[ENormalAOV] = Color3f((aov.normal.x() + 1) * 0.5f, (aov.normal.y() + 1) * 0.5f,
+                                         (aov.normal.z() + 1) * 0.5f);
+            layers[EDepthAOV] = Color3f(aov.depth, 0.f, 0.f);
+            for (int i = 0; i < EFilteredAOVCount; ++i)
+                put(*aovs->filtered[i], pixel, pixelSample, layers[i], filterWeight);
+            if (sampleIndex == 0)
+                aovs->ids->put(pixel, aov);
+        }
+    };
+
+    if (integrator->isWavefront()) {
+        /* Generate the camera rays of all pixels first and trace them together */
+        std::vector<CameraRaySample> rays;
+        std::vector<Color3f> weights;
+        std::vector<Point2f> pixelSamples;
+        std::vector<float> filterWeights;
+        rays.reserve(size.x() * size.y());
+
+        for (int y=0; y<size.y(); ++y) {
+            for (int x=0; x<size.x(); ++x) {
+                Point2i pixel(x + offset.x(), y + offset.y());
+                if (statistics && !statistics->isActive(pixel))
+                    continue;
+
+                sampler->startPixelSample(pixel, sampleIndex);
+
+                CameraRaySample sample;
+                Point2f pixelSample;
+                float filterWeight;
+                weights.push_back(sampleCameraRay(camera, sampler, pixel, fisFilter,
+                                                  sample.ray, pixelSample, filterWeight));
+                sample.pixel = pixel;
+                sample.sampleIndex = sampleIndex;
+                sample.dimension = sampler->getDimension();
+                rays.push_back(sample);
+                pixelSamples.push_back(pixelSample);
+                filterWeights.push_back(filterWeight);
+            }
+        }
+
+        std::vector<Color3f> radiance(rays.size());
+        integrator->LiWavefront(scene, sampler, rays.data(), radiance.data(), rays.size());
+
+        for (size_t i = 0; i < rays.size(); ++i) {
+            /* The AOVs require another intersection of the camera ray */
+            AOVRecord aov;
+            if (aovs) {
+                sampler->startPixelSample(rays[i].pixel, sampleIndex);
+                sampler->setDimension(rays[i].dimension);
+                aov.trace(scene, rays[i].ray, sampler->next2D());
+            }
+            store(rays[i].pixel, pixelSamples[i], weights[i] * radiance[i], filterWeights[i], aov);
+        }
+        return;
+    }
 
     /* For each pixel and pixel sample sample */
     for (int y=0; y<size.y(); ++y) {
         for (int x=0; x<size.x(); ++x) {
-            Point2f pixelSample = Point2f((float) (x + offset.x()), (float) (y + offset.y())) + sampler->next2D();
-            Point2f apertureSample = sampler->next2D();
+            Point2i pixel(x + offset.x(), y + offset.y());
+            if (statistics && !statistics->isActive(pixel))
+                continue;
+
+            sampler->startPixelSample(pixel, sampleIndex);
 
-            /* Sample a ray from the camera */
             Ray3f ray;
-            Color3f value = camera->sampleRay(ray, pixelSample, apertureSample);
+            Point2f pixelSample;
+            float filterWeight;
+            Color3f value = sampleCameraRay(camera, sampler, pixel, fisFilter,
+                                            ray, pixelSample, filterWeight);
 
             /* Compute the incident radiance */
-            value *= integrator->Li(scene, sampler, ray);
+            AOVRecord aov;
+            if (aovs)
+                value *= integrator->LiAOV(scene, sampler, ray, aov);
+            else
+                value *= integrator->Li(scene, sampler, ray);
 
             /* Store in the image block */
-            block.put(pixelSample, value);
+            store(pixel, pixelSample, value, filterWeight, aov);
         }
     }
 }
 
-void RenderThread::renderScene(const std::string & filename) {
-
+Scene *loadScene(const std::string &filename, const RenderOptions &options) {
     filesystem::path path(filename);
 
     /* Add the parent directory of the scene file to the
@@ -109,107 +232,774 @@ void RenderThread::renderScene(const std::string & filename) {
 
     NoriObject* root = loadFromXML(filename);
 
-    // When the XML root object is a scene, start rendering it ..
-    if (root->getClassType() == NoriObject::EScene) {
-        m_scene = static_cast<Scene *>(root);
+    if (root->getClassType() != NoriObject::EScene) {
+        delete root;
+        return nullptr;
+    }
+
+    Scene *scene = static_cast<Scene *>(root);
+
+    /* Apply the command line overrides */
+    if (options.sampleCount > 0)
+        scene->getSampler()->setSampleCount((size_t) options.sampleCount);
+    if (options.resolution.x() > 0 && options.resolution.y() > 0)
+        scene->getCamera()->setOutputSize(options.resolution);
+    if (options.cropSize.x() > 0 && options.cropSize.y() > 0)
+        scene->getCamera()->setCropWindow(options.cropOffset, options.cropSize);
+
+    scene->getIntegrator()->preprocess(scene);
+    return scene;
+}
+
+std::string getOutputName(const std::string &filename, const RenderOptions &options) {
+    if (!options.outputName.empty())
+        return options.outputName;
+
+    std::string outputName = filename;
+    size_t lastdot = outputName.find_last_of(".");
+    if (lastdot != std::string::npos)
+        outputName.erase(lastdot, std::string::npos);
+    return outputName + ".exr";
+}
+
+void saveImage(const ImageBlock &block, const std::string &filename, const AOVImages *aovs) {
+    /* Turn the image block into a properly normalized bitmap */
+    block.lock();
+    std::unique_ptr<Bitmap> bitmap(block.toBitmap());
+    block.unlock();
+
+    /* Save using the OpenEXR format, or as a PNG file if requested */
+    filesystem::path path(filename);
+    if (path.extension() == "png")
+        bitmap->saveToLDR(filename);
+    else if (aovs)
+        aovs->save(*bitmap, filename);
+    else
+        bitmap->save(filename);
+}
+
+bool RenderThread::renderScene(const std::string & filename, const RenderOptions & options) {
+    if (options.aovs && filesystem::path(getOutputName(filename, options)).extension() == "png")
+        throw NoriException("AOVs can only be written to OpenEXR files");
 
+    m_scene = loadScene(filename, options);
+
+    // When the XML root object is a scene, start rendering it ..
+    if (m_scene) {
+        m_options = options;
         const Camera *camera_ = m_scene->getCamera();
-        m_scene->getIntegrator()->preprocess(m_scene);
 
-        /* Allocate memory for the entire output image and clear it */
-        m_block.init(camera_->getOutputSize(), camera_->getReconstructionFilter());
+        /* Allocate memory for the entire output image and clear it. With filter
+           importance sampling, there is no splatting and hence no border region */
+        m_block.lock();
+        m_block.init(camera_->getOutputSize(), options.filterImportanceSampling
+            ? nullptr : camera_->getReconstructionFilter());
         m_block.clear();
+        m_dirtyRegions.clear();
+        m_fullUpdate = true;
+        m_block.unlock();
+
+        /* Per-pixel statistics for adaptive sampling and AOVs */
+        if (options.adaptive || options.aovs)
+            m_statistics.init(camera_->getOutputSize());
 
         /* Determine the filename of the output bitmap */
-        std::string outputName = filename;
-        size_t lastdot = outputName.find_last_of(".");
-        if (lastdot != std::string::npos)
-            outputName.erase(lastdot, std::string::npos);
-        outputName += ".exr";
+        std::string outputName = getOutputName(filename, options);
+
+        m_checkpointName = options.checkpointName;
+        if (m_checkpointName.empty()) {
+            m_checkpointName = outputName;
+            size_t lastdot = m_checkpointName.find_last_of(".");
+            if (lastdot != std::string::npos)
+                m_checkpointName.erase(lastdot, std::string::npos);
+            m_checkpointName += ".ckpt";
+        }
 
         /* Do the following in parallel and asynchronously */
         m_render_status = 1;
+        m_failed = false;
         m_render_thread = std::thread([this,outputName] {
-            const Camera *camera = m_scene->getCamera();
-            Vector2i outputSize = camera->getOutputSize();
+            try {
+                /* The TBB scheduler is configured per thread */
+                tbb::task_scheduler_init init(m_options.threadCount > 0 ? m_options.threadCount
+                    : tbb::task_scheduler_init::automatic);
 
-            /* Create a block generator (i.e. a work scheduler) */
-            BlockGenerator blockGenerator(outputSize, NORI_BLOCK_SIZE);
+                cout << "Rendering .. ";
+                cout.flush();
+                Timer timer;
 
-            cout << "Rendering .. ";
-            cout.flush();
-            Timer timer;
+                render();
 
-            auto numSamples = m_scene->getSampler()->getSampleCount();
-            auto numBlocks = blockGenerator.getBlockCount();
+                cout << "done. (took " << timer.elapsedString() << ")" << endl;
 
-            tbb::concurrent_vector< std::unique_ptr<Sampler> > samplers;
-            samplers.resize(numBlocks);
+                saveImage(m_block, outputName, m_options.aovs ? &m_aovImages : nullptr);
+            } catch (const std::exception &e) {
+                cerr << "Error: " << e.what() << endl;
+                m_failed = true;
+            }
 
-            for (uint32_t k = 0; k < numSamples ; ++k) {
-                m_progress = k/float(numSamples);
-                if(m_render_status == 2)
-                    break;
+            delete m_scene;
+            m_scene = nullptr;
 
-                tbb::blocked_range<int> range(0, numBlocks);
+            m_render_status = 3;
+        });
 
-                auto map = [&](const tbb::blocked_range<int> &range) {
-                    // Allocate memory for a small image block to be rendered by the current thread
-                    ImageBlock block(Vector2i(NORI_BLOCK_SIZE),
-                                     camera->getReconstructionFilter());
+        return true;
+    }
+    else {
+        return false;
+    }
 
-                    for (int i = range.begin(); i < range.end(); ++i) {
-                        // Request an image block from the block generator
-                        blockGenerator.next(block);
+}
 
-                        // Get block id to continue using the same sampler
-                        auto blockId = block.getBlockId();
-                        if(k == 0) { // Initialize the sampler for the first sample
-                            std::unique_ptr<Sampler> sampler(m_scene->getSampler()->clone());
-                            sampler->prepare(block);
-                            samplers.at(blockId) = std::move(sampler);
-                        }
+bool RenderThread::takeDirtyRegions(std::vector<BoundingBox2i> &regions) {
+    bool fullUpdate = m_fullUpdate;
+    if (!fullUpdate)
+        regions.insert(regions.end(), m_dirtyRegions.begin(), m_dirtyRegions.end());
+    m_dirtyRegions.clear();
+    m_fullUpdate = false;
+    return fullUpdate;
+}
+
+void RenderThread::publish(bool full) {
+    Vector2i outputSize = m_backBuffer.getSize();
+    int borderSize = m_backBuffer.getBorderSize();
+    std::vector<uint32_t> dirtyTiles;
+    m_film.takeDirtyTiles(dirtyTiles);
+
+    /* Splats can change any pixel of the image */
+    if (m_splatting)
+        full = true;
+
+    if (full) {
+        m_film.develop(m_backBuffer);
+        if (m_splatting && m_pixelSamples > 0)
+            m_splats.develop(m_backBuffer, outputSize.x() * outputSize.y() / (float) m_pixelSamples);
+
+        m_block.lock();
+        static_cast<ImageBlock::Base &>(m_block) = m_backBuffer;
+        m_dirtyRegions.clear();
+        m_fullUpdate = true;
+        m_block.unlock();
+        return;
+    }
+
+    /* The back buffer stays in sync with the film, hence only the
+       footprints of the tiles that changed need to be assembled again */
+    std::vector<BoundingBox2i> regions;
+    for (uint32_t id : dirtyTiles) {
+        regions.push_back(m_film.getTileFootprint(id, outputSize));
+        m_film.develop(m_backBuffer, regions.back());
+    }
+
+    /* Only copying the changed regions happens under the lock
+       that the GUI holds while uploading the image */
+    m_block.lock();
+    for (auto const &region : regions) {
+        Vector2i size = region.max - region.min;
+        m_block.block(region.min.y() + borderSize, region.min.x() + borderSize, size.y(), size.x()) =
+            m_backBuffer.block(region.min.y() + borderSize, region.min.x() + borderSize, size.y(), size.x());
+    }
+    if (!m_fullUpdate) {
+        m_dirtyRegions.insert(m_dirtyRegions.end(), regions.begin(), regions.end());
+        /* Nobody is collecting the changes, fall back to a full update */
+        if (m_dirtyRegions.size() > m_film.getTileCount()) {
+            m_dirtyRegions.clear();
+            m_fullUpdate = true;
+        }
+    }
+    m_block.unlock();
+}
 
-                        // Render all contained pixels
-                        renderBlock(m_scene, samplers.at(blockId).get(), block);
+/// State of an image tile during rendering
+struct RenderTile {
+    Point2i offset;
+    Vector2i size;
+    uint32_t id;
+
+    /// Sampler that is reused for all samples of this tile
+    std::unique_ptr<Sampler> sampler;
+
+    /// Number of samples per pixel rendered so far
+    uint32_t sampleCount = 0;
+
+    /// Sum of the relative errors of the tile's pixels (adaptive sampling)
+    std::atomic<float> errorSum;
+
+    /// Has the tile received all of its samples?
+    bool finished = false;
+
+    /// NUMA node that preferably renders this tile
+    int node = 0;
+
+    /// Has the film memory of the tile been moved to its rendering node?
+    bool localized = false;
+
+    /// Protects the committed state and the published region of the film
+    tbb::mutex mutex;
+
+    /// Serialized tile state matching the most recently published region of the film
+    std::string state;
+};
+
+/**
+ * Serialize the state of a tile that is required to continue rendering it:
+ * the number of samples taken so far, the sampler state, and (for adaptive
+ * sampling) the statistics of its pixels
+ */
+static std::string serializeTile(const RenderTile &tile, const PixelStatistics *statistics) {
+    std::ostringstream stream;
+    writeBinary(stream, tile.sampleCount);
+    writeBinary(stream, (float) tile.errorSum);
+    writeBinary(stream, (uint8_t) tile.finished);
+    tile.sampler->serialize(stream);
+    if (statistics)
+        statistics->serialize(tile.offset, tile.size, stream);
+    return stream.str();
+}
 
-                        // The image block has been processed. Now add it to the "big" block that represents the entire image
-                        m_block.put(block);
+/**
+ * Encode everything that a checkpoint must agree on with the current
+ * render. A checkpoint is only resumed when its header is identical.
+ */
+static std::string checkpointHeader(const Scene *scene, const RenderOptions &options,
+                                    uint32_t tileCount) {
+    const Sampler *sampler = scene->getSampler();
+    const Camera *camera = scene->getCamera();
+    Vector2i outputSize = camera->getOutputSize();
+    Point2i cropOffset = camera->getCropOffset();
+    Vector2i cropSize = camera->getCropSize();
+    std::string samplerName = sampler->toString();
+
+    std::ostringstream stream;
+    writeBinary(stream, (uint32_t) NORI_CHECKPOINT_MAGIC);
+    writeBinary(stream, (uint32_t) NORI_CHECKPOINT_VERSION);
+    writeBinary(stream, outputSize.x());
+    writeBinary(stream, outputSize.y());
+    writeBinary(stream, cropOffset.x());
+    writeBinary(stream, cropOffset.y());
+    writeBinary(stream, cropSize.x());
+    writeBinary(stream, cropSize.y());
+    writeBinary(stream, tileCount);
+    writeBinary(stream, (uint32_t) sampler->getSampleCount());
+    writeBinary(stream, (uint32_t) samplerName.length());
+    writeBinary(stream, samplerName.data(), samplerName.length());
+    writeBinary(stream, (uint8_t) options.filterImportanceSampling);
+    writeBinary(stream, (uint8_t) options.adaptive);
+    if (options.adaptive) {
+        writeBinary(stream, options.minSampleCount);
+        writeBinary(stream, options.errorThreshold);
+    }
+    return stream.str();
+}
+
+void RenderThread::saveCheckpoint(const std::vector<std::unique_ptr<RenderTile>> &tiles) {
+    /* Write to a temporary file first, so that an interruption
+       never leaves behind a corrupted checkpoint */
+    std::string tempName = m_checkpointName + ".tmp";
+    std::ofstream stream(tempName, std::ios::out | std::ios::binary);
+    if (!stream)
+        throw NoriException("Unable to create the checkpoint file \"%s\"", tempName);
+
+    std::string header = checkpointHeader(m_scene, m_options, (uint32_t) tiles.size());
+    writeBinary(stream, header.data(), header.length());
+
+    /* Each tile is written together with its published film region, which
+       both correspond to the same (most recently committed) chunk */
+    for (auto const &tile : tiles) {
+        tbb::mutex::scoped_lock lock(tile->mutex);
+        writeBinary(stream, tile->id);
+        writeBinary(stream, (uint32_t) tile->state.length());
+        writeBinary(stream, tile->state.data(), tile->state.length());
+        m_film.writeTile(tile->id, stream);
+    }
+
+    stream.close();
+    if (!stream)
+        throw NoriException("Unable to write the checkpoint file \"%s\"", tempName);
+    if (std::rename(tempName.c_str(), m_checkpointName.c_str()) != 0)
+        throw NoriException("Unable to replace the checkpoint file \"%s\"", m_checkpointName);
+}
+
+void RenderThread::loadCheckpoint(std::vector<std::unique_ptr<RenderTile>> &tiles) {
+    std::ifstream stream(m_checkpointName, std::ios::in | std::ios::binary);
+    if (!stream)
+        throw NoriException("Unable to open the checkpoint file \"%s\"", m_checkpointName);
+
+    std::string header = checkpointHeader(m_scene, m_options, (uint32_t) tiles.size());
+    std::string storedHeader(header.length(), '\0');
+    readBinary(stream, &storedHeader[0], storedHeader.length());
+    if (storedHeader != header)
+        throw NoriException("The checkpoint file \"%s\" was created for a different "
+                            "scene or with different render settings", m_checkpointName);
+
+    std::vector<RenderTile *> tilesById(tiles.size(), nullptr);
+    for (auto const &tile : tiles)
+        tilesById[tile->id] = tile.get();
+
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        uint32_t id, length;
+        readBinary(stream, id);
+        readBinary(stream, length);
+        if (id >= tiles.size())
+            throw NoriException("The checkpoint file \"%s\" is corrupted", m_checkpointName);
+        RenderTile &tile = *tilesById[id];
+
+        tile.state.resize(length);
+        readBinary(stream, &tile.state[0], length);
+
+        std::istringstream state(tile.state);
+        float errorSum;
+        uint8_t finished;
+        readBinary(state, tile.sampleCount);
+        readBinary(state, errorSum);
+        readBinary(state, finished);
+        tile.errorSum = errorSum;
+        tile.finished = finished != 0;
+        tile.sampler->unserialize(state);
+        if (m_options.adaptive)
+            m_statistics.unserialize(tile.offset, tile.size, state);
+
+        m_film.readTile(id, stream);
+    }
+}
+
+void RenderThread::developAOVs() {
+    Vector2i outputSize = m_backBuffer.getSize();
+    int borderSize = m_backBuffer.getBorderSize();
+    Bitmap *layers[EFilteredAOVCount] = { &m_aovImages.albedo, &m_aovImages.normal, &m_aovImages.depth };
+
+    for (int i = 0; i < EFilteredAOVCount; ++i) {
+        TiledFilm &film = m_aovFilms[i];
+        for (uint32_t id = 0; id < film.getTileCount(); ++id)
+            film.commitTile(id);
+        /* Develop into the back buffer, which matches the film's size and filter */
+        film.develop(m_backBuffer);
+
+        Bitmap &layer = *layers[i];
+        layer = Bitmap(outputSize);
+        for (int y = 0; y < outputSize.y(); ++y) {
+            for (int x = 0; x < outputSize.x(); ++x) {
+                const Color4f &pixel = m_backBuffer.coeff(y + borderSize, x + borderSize);
+                Color3f value = pixel.divideByFilterWeight();
+                if (i == ENormalAOV && pixel.w() != 0)
+                    value = value * 2.f - Color3f(1.f);
+                layer.coeffRef(y, x) = value;
+            }
+        }
+    }
+
+    m_aovImages.ids = Bitmap(outputSize);
+    m_aovImages.sampleCount = Bitmap(outputSize);
+    m_aovImages.variance = Bitmap(outputSize);
+    for (int y = 0; y < outputSize.y(); ++y) {
+        for (int x = 0; x < outputSize.x(); ++x) {
+            Point2i pixel(x, y);
+            uint32_t count = m_statistics.getSampleCount(pixel);
+            m_aovImages.ids.coeffRef(y, x) = Color3f((float) m_ids.getMeshId(pixel),
+                                                     (float) m_ids.getPrimitiveId(pixel), 0.f);
+            m_aovImages.sampleCount.coeffRef(y, x) = Color3f((float) count);
+            m_aovImages.variance.coeffRef(y, x) = Color3f(count > 0
+                ? m_statistics.getVariance(pixel) / count : 0.f);
+        }
+    }
+}
+
+void RenderThread::renderPreview(const std::vector<std::unique_ptr<RenderTile>> &tiles) {
+    const Camera *camera = m_scene->getCamera();
+    const Integrator *integrator = m_scene->getIntegrator();
+    int borderSize = m_backBuffer.getBorderSize();
+
+    /* Every level takes one sample per cell of scale x scale pixels and fills
+       the whole cell with it. The cells never cross tile boundaries, so that
+       the tiles can be processed in parallel */
+    for (int scale = 8; scale > 1 && m_render_status != 2; scale /= 2) {
+        m_backBuffer.clear();
+
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, tiles.size()),
+            [&](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i != range.end(); ++i) {
+                    const RenderTile &tile = *tiles[i];
+
+                    /* Use a separate sampler, the tile's own sampler must not be advanced */
+                    std::unique_ptr<Sampler> sampler(m_scene->getSampler()->clone());
+                    sampler->prepare(m_film.getTile(tile.id));
+
+                    for (int y = 0; y < tile.size.y(); y += scale) {
+                        for (int x = 0; x < tile.size.x(); x += scale) {
+                            Point2i cell(tile.offset.x() + x, tile.offset.y() + y);
+                            Vector2i cellSize = (tile.size - Vector2i(x, y)).cwiseMin(Vector2i::Constant(scale));
+
+                            sampler->startPixelSample(cell, 0);
+                            Point2f sample = sampler->next2D();
+                            Point2f pixelSample(cell.x() + sample.x() * cellSize.x(),
+                                                cell.y() + sample.y() * cellSize.y());
+                            Point2f apertureSample = sampler->next2D();
+
+                            Ray3f ray;
+                            float time = sampler->next1D();
+                            Color3f value = camera->sampleRay(ray, pixelSample, apertureSample, time);
+                            value *= integrator->Li(m_scene, sampler.get(), ray);
+                            if (!value.isValid())
+                                value = Color3f(0.f);
+
+                            Color4f color(value);
+                            for (int cy = 0; cy < cellSize.y(); ++cy)
+                                for (int cx = 0; cx < cellSize.x(); ++cx)
+                                    m_backBuffer.coeffRef(borderSize + cell.y() + cy,
+                                                          borderSize + cell.x() + cx) = color;
+                        }
                     }
-                };
+                }
+            });
+
+        m_block.lock();
+        m_block.swap(m_backBuffer);
+        m_dirtyRegions.clear();
+        m_fullUpdate = true;
+        m_block.unlock();
+    }
+}
+
+void RenderThread::renderProgressive() {
+    if (m_options.adaptive || m_options.checkpointInterval > 0 || m_options.resume || m_options.aovs)
+        throw NoriException("Progressive integrators support neither adaptive sampling, checkpoints nor AOVs");
+
+    Integrator *integrator = m_scene->getIntegrator();
+    const Camera *camera = m_scene->getCamera();
+    uint32_t numPasses = (uint32_t) m_scene->getSampler()->getSampleCount();
+    m_backBuffer.init(camera->getOutputSize(), m_options.filterImportanceSampling
+        ? nullptr : camera->getReconstructionFilter());
 
-                /// Uncomment the following line for single threaded rendering
-                //map(range);
+    for (uint32_t pass = 0; pass < numPasses && m_render_status != 2; ++pass) {
+        m_backBuffer.clear();
+        integrator->renderPass(m_scene, pass, m_backBuffer);
 
-                /// Default: parallel rendering
-                tbb::parallel_for(range, map);
+        m_block.lock();
+        m_block.swap(m_backBuffer);
+        m_dirtyRegions.clear();
+        m_fullUpdate = true;
+        m_block.unlock();
+
+        m_progress = (pass + 1) / (float) numPasses;
+    }
+}
+
+void RenderThread::render() {
+    /* Progressive integrators render the entire image in every pass */
+    if (m_scene->getIntegrator()->isProgressive()) {
+        renderProgressive();
+        return;
+    }
+
+    const Camera *camera = m_scene->getCamera();
+    Vector2i outputSize = camera->getOutputSize();
+    Point2i cropOffset = camera->getCropOffset();
+    Vector2i cropSize = camera->getCropSize();
+    uint32_t numSamples = (uint32_t) m_scene->getSampler()->getSampleCount();
+
+    bool adaptive = m_options.adaptive;
+    uint32_t minSampleCount = (uint32_t) std::max(m_options.minSampleCount, 2);
+    uint32_t samplesPerChunk = (uint32_t) std::max(m_options.samplesPerChunk, 1);
+
+    /* Every tile accumulates into its own region of the film, and the
+       image shown by the GUI is assembled from periodic snapshots */
+    const ReconstructionFilter *fisFilter = nullptr, *splatFilter = camera->getReconstructionFilter();
+    if (m_options.filterImportanceSampling)
+        std::swap(fisFilter, splatFilter);
+    m_film.init(cropOffset, cropSize, splatFilter, NORI_BLOCK_SIZE);
+    m_backBuffer.init(outputSize, splatFilter);
+
+    /* Contributions of light paths to arbitrary pixels go into a separate film */
+    Integrator *integrator = m_scene->getIntegrator();
+    m_splatting = integrator->isSplatting();
+    m_pixelSamples = 0;
+    if (m_splatting) {
+        if (adaptive || m_options.checkpointInterval > 0 || m_options.resume || m_options.aovs)
+            throw NoriException("Splatting integrators support neither adaptive sampling, checkpoints nor AOVs");
+        m_splats.init(outputSize);
+    }
 
-                blockGenerator.reset();
+    /* The AOVs are only assembled once at the end, and not part of checkpoints */
+    bool aovs = m_options.aovs;
+    if (aovs) {
+        if (m_options.checkpointInterval > 0 || m_options.resume)
+            throw NoriException("AOVs cannot be combined with checkpoints");
+        for (auto &film : m_aovFilms)
+            film.init(cropOffset, cropSize, splatFilter, NORI_BLOCK_SIZE);
+        m_ids.init(outputSize);
+    }
+
+    /* Split the crop window into tiles (in a spiral order, so that the center is
+       rendered first) and create a sampler for each of them */
+    BlockGenerator blockGenerator(cropOffset, cropSize, NORI_BLOCK_SIZE);
+    ImageBlock tileBlock(Vector2i(NORI_BLOCK_SIZE), nullptr);
+    std::vector<std::unique_ptr<RenderTile>> tiles;
+    while (blockGenerator.next(tileBlock)) {
+        std::unique_ptr<RenderTile> tile(new RenderTile());
+        tile->offset = tileBlock.getOffset();
+        tile->size = tileBlock.getSize();
+        tile->id = tileBlock.getBlockId();
+        tile->sampler = m_scene->getSampler()->clone();
+        tile->sampler->prepare(tileBlock);
+        tile->errorSum = (float) (tile->size.x() * tile->size.y());
+        tiles.push_back(std::move(tile));
+    }
+
+    bool checkpoints = m_options.checkpointInterval > 0;
+    PixelStatistics *statistics = adaptive ? &m_statistics : nullptr;
+    if (m_options.resume) {
+        loadCheckpoint(tiles);
+        cout << "resuming from \"" << m_checkpointName << "\" .. ";
+        cout.flush();
+    } else if (checkpoints) {
+        for (auto const &tile : tiles)
+            tile->state = serializeTile(*tile, statistics);
+    }
+
+    /* Show a quick low-resolution version of the image first */
+    bool preview = m_options.preview && m_options.displayInterval > 0 && !m_options.resume;
+    if (preview)
+        renderPreview(tiles);
+
+    /* The preview does not include any splats */
+    if (m_splatting)
+        integrator->setSplatFilm(&m_splats);
+
+    size_t numPixels = (size_t) cropSize.x() * cropSize.y();
+    uint64_t totalWork = (uint64_t) tiles.size() * numSamples;
+    std::atomic<uint64_t> workDone(0);
+    std::atomic<size_t> tilesLeft(0);
+    std::atomic<size_t> tilesWithoutSamples(preview ? tiles.size() : 0);
+    std::atomic<bool> converged(false);
+
+    /* With NUMA-aware scheduling, every node owns a horizontal band of tiles
+       and the workers of each node are pinned to its CPUs */
+    std::unique_ptr<NumaTopology> topology;
+    int nodeCount = 1;
+    if (m_options.numa) {
+        topology.reset(new NumaTopology());
+        nodeCount = topology->getNodeCount();
+        cout << topology->toString() << " .. ";
+        cout.flush();
+    }
+    int numRows = (cropSize.y() + NORI_BLOCK_SIZE - 1) / NORI_BLOCK_SIZE;
+    for (auto const &tile : tiles) {
+        int row = (tile->offset.y() - cropOffset.y()) / NORI_BLOCK_SIZE;
+        tile->node = row * nodeCount / numRows;
+    }
+
+    /* Queue all tiles that still need samples on their nodes */
+    std::vector<tbb::concurrent_queue<RenderTile *>> queues(nodeCount);
+    std::vector<std::atomic<uint64_t>> nodeSamples(nodeCount);
+    for (auto &samples : nodeSamples)
+        samples = 0;
+    for (auto const &tile : tiles) {
+        if (tile->finished) {
+            workDone += numSamples;
+        } else {
+            workDone += tile->sampleCount;
+            ++tilesLeft;
+            queues[tile->node].push(tile.get());
+        }
+    }
+    m_progress = workDone / (float) totalWork;
+
+    Timer timer;
+    std::atomic<double> lastSnapshot(0), lastCheckpoint(0);
+    std::atomic<bool> publishing(false), checkpointing(false);
+    bool fullPublish = true; // The back buffer is not yet in sync with the film
+
+    /* Workers without a tile sleep until a tile is requeued or the render ends */
+    std::mutex idleMutex;
+    std::condition_variable idleCondition;
+    auto hasQueuedTiles = [&]() {
+        for (auto const &queue : queues)
+            if (!queue.empty())
+                return true;
+        return false;
+    };
+    auto wakeIdleWorkers = [&](bool all) {
+        /* Locking orders this with the check of a worker that is about to sleep */
+        { std::lock_guard<std::mutex> lock(idleMutex); }
+        if (all)
+            idleCondition.notify_all();
+        else
+            idleCondition.notify_one();
+    };
+
+    /* Each worker repeatedly takes a tile from the queue, renders a chunk of
+       samples for it into the tile's region of the film. Unfinished tiles go back
+       to the end of the queue, hence idle workers always pick up whatever
+       tile is next and the image as a whole is refined progressively
+       without any barrier between sample passes. The chunks start with a
+       single sample per pixel for a quick first preview and then grow.
+       Workers prefer the tiles of their own NUMA node and only help out
+       with the tiles of other nodes when their own queue is empty. */
+    auto worker = [&](int node) {
+        RenderTile *tile;
+
+        while (tilesLeft > 0 && m_render_status != 2 && !converged) {
+            bool found = queues[node].try_pop(tile);
+            for (int i = 1; i < nodeCount && !found; ++i)
+                found = queues[(node + i) % nodeCount].try_pop(tile);
+            if (!found) {
+                /* All remaining tiles are being processed by other workers. The
+                   timeout only serves to notice a cancellation from the GUI. */
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idleCondition.wait_for(lock, std::chrono::milliseconds(100), [&]() {
+                    return tilesLeft == 0 || converged || hasQueuedTiles();
+                });
+                continue;
             }
 
-            cout << "done. (took " << timer.elapsedString() << ")" << endl;
+            /* Move the tile's film memory to the node that renders it */
+            if (topology && !tile->localized && tile->node == node) {
+                m_film.localizeTile(tile->id);
+                if (aovs) {
+                    for (auto &film : m_aovFilms)
+                        film.localizeTile(tile->id);
+                }
+                tile->localized = true;
+            }
 
-            /* Now turn the rendered image block into
-               a properly normalized bitmap */
-            m_block.lock();
-            std::unique_ptr<Bitmap> bitmap(m_block.toBitmap());
-            m_block.unlock();
+            /* The tile's region of the film is owned by this worker until the tile is requeued */
+            ImageBlock &block = m_film.getTile(tile->id);
+            AOVBlocks aovBlocks;
+            if (aovs) {
+                for (int i = 0; i < EFilteredAOVCount; ++i)
+                    aovBlocks.filtered[i] = &m_aovFilms[i].getTile(tile->id);
+                aovBlocks.ids = &m_ids;
+            }
 
-            /* Save using the OpenEXR format */
-            bitmap->save(outputName);
+            uint32_t chunk = std::min(std::max(tile->sampleCount, 1u), samplesPerChunk);
+            chunk = std::min(chunk, numSamples - tile->sampleCount);
+            for (uint32_t i = 0; i < chunk; ++i)
+                renderBlock(m_scene, tile->sampler.get(), block, tile->sampleCount + i,
+                            adaptive || aovs ? &m_statistics : nullptr, fisFilter,
+                            aovs ? &aovBlocks : nullptr);
+            tile->sampleCount += chunk;
+            nodeSamples[node] += (uint64_t) chunk * tile->size.x() * tile->size.y();
+            m_pixelSamples += (uint64_t) chunk * tile->size.x() * tile->size.y();
+
+            bool finished = tile->sampleCount >= numSamples;
+
+            /* Adaptive sampling: retire converged pixels and check the stopping criteria */
+            if (adaptive && tile->sampleCount >= minSampleCount) {
+                float errorSum;
+                size_t active = m_statistics.update(tile->offset, tile->size,
+                    m_options.errorThreshold, errorSum);
+                tile->errorSum = errorSum;
+                if (active == 0)
+                    finished = true;
+            }
+            tile->finished = finished;
+
+            /* Make the new samples visible to snapshots of the film and checkpoints */
+            if (checkpoints) {
+                std::string state = serializeTile(*tile, statistics);
+                tbb::mutex::scoped_lock lock(tile->mutex);
+                m_film.commitTile(tile->id);
+                tile->state.swap(state);
+            } else {
+                m_film.commitTile(tile->id);
+            }
 
-            delete m_scene;
-            m_scene = nullptr;
+            if (adaptive && m_options.errorTarget > 0) {
+                double totalError = 0;
+                for (auto const &t : tiles)
+                    totalError += t->errorSum;
+                if (totalError / numPixels <= m_options.errorTarget && !converged.exchange(true))
+                    wakeIdleWorkers(true);
+            }
 
-            m_render_status = 3;
-        });
+            /* The preview stays on screen until every tile has received a first sample */
+            if (preview && tile->sampleCount == chunk)
+                --tilesWithoutSamples;
+
+            if (finished) {
+                workDone += numSamples - (tile->sampleCount - chunk);
+                if (--tilesLeft == 0)
+                    wakeIdleWorkers(true);
+            } else {
+                workDone += chunk;
+                queues[tile->node].push(tile);
+                wakeIdleWorkers(false);
+            }
+            m_progress = workDone / (float) totalWork;
+
+            /* Periodically publish a snapshot for display, using at most one worker at a time */
+            double now = timer.elapsed();
+            if (m_options.displayInterval > 0 && now - lastSnapshot >= m_options.displayInterval
+                    && tilesWithoutSamples == 0 && !publishing.exchange(true)) {
+                lastSnapshot = now;
+                publish(fullPublish);
+                fullPublish = false;
+                publishing = false;
+            }
 
+            /* Periodically save the state of all tiles to disk */
+            if (checkpoints && now - lastCheckpoint >= m_options.checkpointInterval * 1000.0
+                    && !checkpointing.exchange(true)) {
+                lastCheckpoint = now;
+                try {
+                    saveCheckpoint(tiles);
+                } catch (const std::exception &e) {
+                    cerr << "Warning: " << e.what() << endl;
+                }
+                checkpointing = false;
+            }
+        }
+    };
+
+    /// Uncomment the following line for single threaded rendering
+    //worker(0);
+
+    /// Default: parallel rendering with one persistent worker per thread
+    int workerCount = m_options.threadCount > 0 ? m_options.threadCount
+        : tbb::task_scheduler_init::default_num_threads();
+    tbb::parallel_for(tbb::blocked_range<int>(0, workerCount, 1),
+        [&](const tbb::blocked_range<int> &range) {
+            int node = range.begin() * nodeCount / workerCount;
+            std::unique_ptr<NumaThreadBinding> binding;
+            if (topology)
+                binding.reset(new NumaThreadBinding(*topology, node));
+            worker(node);
+        },
+        tbb::simple_partitioner());
+
+    publish(true);
+    integrator->setSplatFilm(nullptr);
+    if (aovs)
+        developAOVs();
+
+    /* Keep the checkpoint of an interrupted render, and discard it once the image is complete */
+    if (checkpoints) {
+        if (m_render_status == 2)
+            saveCheckpoint(tiles);
+        else
+            std::remove(m_checkpointName.c_str());
     }
-    else {
-        delete root;
+
+    /* Pixels that converged early stop taking samples, even though their tile continues */
+    if (adaptive) {
+        uint64_t pixelSamples = 0;
+        for (int y = cropOffset.y(); y < cropOffset.y() + cropSize.y(); ++y)
+            for (int x = cropOffset.x(); x < cropOffset.x() + cropSize.x(); ++x)
+                pixelSamples += m_statistics.getSampleCount(Point2i(x, y));
+        cout << "used " << (int) (100 * pixelSamples / ((double) numPixels * numSamples))
+             << "% of the sample budget .. ";
     }
 
+    if (topology) {
+        double seconds = std::max(timer.elapsed() / 1000.0, 1e-3);
+        cout << "throughput per node:";
+        for (int i = 0; i < nodeCount; ++i)
+            cout << tfm::format(" %i: %.2f Msamples/s%s", i, nodeSamples[i] / seconds * 1e-6,
+                                i + 1 < nodeCount ? "," : "");
+        cout << " .. ";
+    }
 }
 
 
-NORI_NAMESPACE_END
\ No newline at end of file
+NORI_NAMESPACE_END
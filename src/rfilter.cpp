@@ -20,6 +20,33 @@
 
 NORI_NAMESPACE_BEGIN
 
+void ReconstructionFilter::activate() {
+    /* Tabulate the magnitude of the filter over [-radius, radius] by
+       averaging a few evaluations per bin */
+    const int subsamples = 4;
+    int bins = 2 * std::max(1, (int) std::ceil(m_radius * NORI_FILTER_SAMPLING_RESOLUTION));
+    float binWidth = 2 * m_radius / bins;
+
+    m_distr.clear();
+    m_distr.reserve(bins);
+    for (int i=0; i<bins; ++i) {
+        float sum = 0.0f;
+        for (int j=0; j<subsamples; ++j)
+            sum += std::abs(eval(-m_radius + (i + (j + 0.5f) / subsamples) * binWidth));
+        m_distr.append(sum / subsamples);
+    }
+    m_distr.normalize();
+}
+
+float ReconstructionFilter::sample(float sample, float &weight) const {
+    float pdf;
+    size_t bin = m_distr.sampleReuse(sample, pdf);
+    float binWidth = 2 * m_radius / m_distr.size();
+    float x = -m_radius + (bin + sample) * binWidth;
+    weight = pdf > 0 ? eval(x) * binWidth / pdf : 0.0f;
+    return x;
+}
+
 /**
  * Windowed Gaussian filter with configurable extent
  * and standard deviation. Often produces pleasing 
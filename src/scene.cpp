@@ -23,15 +23,27 @@
 #include <nori/camera.h>
 #include <nori/emitter.h>
 #include <nori/medium.h>
+#include <nori/lightbvh.h>
 
 NORI_NAMESPACE_BEGIN
 
-Scene::Scene(const PropertyList &) {
+Scene::Scene(const PropertyList &propList) {
     m_bvh = new BVH();
+
+    std::string lightSampling = propList.getString("lightSampling", "bvh");
+    if (lightSampling == "uniform")
+        m_lightSampling = EUniformLightSampling;
+    else if (lightSampling == "power")
+        m_lightSampling = EPowerLightSampling;
+    else if (lightSampling == "bvh")
+        m_lightSampling = EBVHLightSampling;
+    else
+        throw NoriException("Scene: unknown light sampling strategy \"%s\"!", lightSampling);
 }
 
 Scene::~Scene() {
     delete m_bvh;
+    delete m_lightBVH;
     delete m_sampler;
     delete m_camera;
     delete m_integrator;
@@ -53,10 +65,32 @@ void Scene::activate() {
     }
 
 
-	for (Emitter *emitter : getLights()) {
-			distr.append(1);
-	}
-	distr.normalize();
+    /* Environment emitters report integrated radiance, which turns into
+       power when it passes through the cross section of the scene */
+    float radius = getBoundingBox().getExtents().norm() / 2;
+    for (Emitter *emitter : getLights()) {
+        float weight = 1.0f;
+        if (m_lightSampling == EPowerLightSampling) {
+            weight = emitter->power().getLuminance();
+            if (emitter->isEnvironmentEmitter())
+                weight *= M_PI * radius * radius;
+        }
+        distr.append(std::max(0.0f, weight));
+    }
+    if (distr.normalize() == 0 && !m_emitters.empty()) {
+        /* No emitter reports any power: fall back to uniform selection */
+        distr.clear();
+        for (size_t i = 0; i < m_emitters.size(); ++i)
+            distr.append(1.0f);
+        distr.normalize();
+    }
+
+    for (uint32_t i = 0; i < (uint32_t) m_emitters.size(); ++i)
+        m_emitterIndex[m_emitters[i]] = i;
+    if (m_lightSampling == EBVHLightSampling) {
+        m_lightBVH = new LightBVH();
+        m_lightBVH->build(m_emitters);
+    }
 
 
     cout << endl;
@@ -67,14 +101,36 @@ void Scene::activate() {
 Color3f Scene::sampleDirect(EmitterQueryRecord &lRec, const Point2f &_sample) const {
     //throw NoriException("Scene::sampleDirect is not yet implemented!");
 	Point2f s = _sample;
-	size_t index = distr.sampleReuse(s.x());
+    if (m_lightBVH) {
+        float pmf;
+        int index = m_lightBVH->sample(lRec.ref, s.x(), pmf);
+        if (index < 0) {
+            /* No emitter can illuminate the reference point */
+            lRec.emitter = nullptr;
+            lRec.p = lRec.ref;
+            lRec.wi = Vector3f(0.0f, 0.0f, 1.0f);
+            lRec.dist = 0.0f;
+            lRec.pdf = 0.0f;
+            return Color3f(0.0f);
+        }
+        lRec.emitter = m_emitters[index];
+        return m_emitters[index]->sample(lRec, s) / pmf;
+    }
+
+    float pmf;
+	size_t index = distr.sampleReuse(s.x(), pmf);
 	lRec.emitter = m_emitters[index];
-	return m_emitters[index]->sample(lRec, s) * distr.getSum();
+	return m_emitters[index]->sample(lRec, s) / pmf;
 }
 
 float Scene::pdfDirect(const EmitterQueryRecord &lRec) const {
     //throw NoriException("Scene::pdfDirect is not yet implemented!");
-	return lRec.emitter->pdf(lRec) / distr.getSum();
+    if (!lRec.emitter)
+        return 0.0f;
+    uint32_t index = m_emitterIndex.at(lRec.emitter);
+    if (m_lightBVH)
+        return lRec.emitter->pdf(lRec) * m_lightBVH->pmf(lRec.ref, (int) index);
+	return lRec.emitter->pdf(lRec) * distr[index];
 }
 
 void Scene::addChild(NoriObject *obj) {
@@ -151,6 +207,7 @@ std::string Scene::toString() const {
         "  integrator = %s,\n"
         "  sampler = %s\n"
         "  camera = %s,\n"
+        "  lightSampling = %s,\n"
         "  meshes = {\n"
         "  %s  }\n"
         "  emitters = {\n"
@@ -159,6 +216,8 @@ std::string Scene::toString() const {
         indent(m_integrator->toString()),
         indent(m_sampler->toString()),
         indent(m_camera->toString()),
+        m_lightSampling == EBVHLightSampling ? "bvh" :
+            (m_lightSampling == EPowerLightSampling ? "power" : "uniform"),
         indent(meshes, 2),
         indent(lights,2)
     );
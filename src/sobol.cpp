@@ -0,0 +1,114 @@
+#include <nori/sampler.h>
+#include <nori/block.h>
+#include <nori/qmc.h>
+#include <nori/serialization.h>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Sobol sampler with per-pixel Owen scrambling
+ *
+ * Generates pixel samples from the (0,2)-sequence formed by the first two
+ * dimensions of the Sobol sequence. Every request for a 1D or 2D component
+ * (pixel position, lens position, time, light and BSDF samples, ...) is
+ * served by its own shuffled and Owen-scrambled copy of the sequence
+ * ("padding"), so that each pair of dimensions stays well stratified over
+ * the samples of a pixel. The scrambling seeds are hashed from the pixel
+ * position, which decorrelates neighboring pixels.
+ *
+ * The sample points only depend on the pixel, the sample index and the
+ * dimension, hence the renderer must announce each pixel sample using
+ * \ref startPixelSample(). Stratification is best for power-of-two
+ * sample counts.
+ */
+class Sobol : public Sampler {
+public:
+    Sobol(const PropertyList &propList) {
+        m_sampleCount = (size_t) propList.getInteger("sampleCount", 1);
+        m_seed = (uint32_t) propList.getInteger("seed", 0);
+    }
+
+    virtual ~Sobol() { }
+
+    std::unique_ptr<Sampler> clone() const {
+        std::unique_ptr<Sobol> cloned(new Sobol());
+        cloned->m_sampleCount = m_sampleCount;
+        cloned->m_seed = m_seed;
+        cloned->m_pixelSeed = m_pixelSeed;
+        cloned->m_sampleIndex = m_sampleIndex;
+        cloned->m_dimension = m_dimension;
+        return std::move(cloned);
+    }
+
+    void prepare(const ImageBlock &block) {
+        m_pixelSeed = qmc::hashCombine(m_seed,
+            qmc::hashCombine(block.getOffset().x(), block.getOffset().y()));
+        m_sampleIndex = 0;
+        m_dimension = 0;
+    }
+
+    void generate() {
+        m_sampleIndex = 0;
+        m_dimension = 0;
+    }
+
+    void advance() {
+        m_sampleIndex++;
+        m_dimension = 0;
+    }
+
+    void startPixelSample(const Point2i &pixel, uint32_t sampleIndex) {
+        m_pixelSeed = qmc::hashCombine(m_seed,
+            qmc::hashCombine(pixel.x(), pixel.y()));
+        m_sampleIndex = sampleIndex;
+        m_dimension = 0;
+    }
+
+    uint32_t getDimension() const {
+        return m_dimension;
+    }
+
+    void setDimension(uint32_t dimension) {
+        m_dimension = dimension;
+    }
+
+    float next1D() {
+        return qmc::sobol1D(m_sampleIndex, nextDimensionSeed());
+    }
+
+    Point2f next2D() {
+        return qmc::sobol2D(m_sampleIndex, nextDimensionSeed());
+    }
+
+    void serialize(std::ostream &stream) const {
+        writeBinary(stream, m_pixelSeed);
+        writeBinary(stream, m_sampleIndex);
+        writeBinary(stream, m_dimension);
+    }
+
+    void unserialize(std::istream &stream) {
+        readBinary(stream, m_pixelSeed);
+        readBinary(stream, m_sampleIndex);
+        readBinary(stream, m_dimension);
+    }
+
+    virtual std::string toString() const {
+        return tfm::format("Sobol[sampleCount=%i, seed=%i]", m_sampleCount, m_seed);
+    }
+protected:
+    Sobol() { }
+
+    /// Scrambling seed of the next dimension of the current pixel sample
+    uint32_t nextDimensionSeed() {
+        return qmc::hashCombine(m_pixelSeed, m_dimension++);
+    }
+
+private:
+    uint32_t m_seed = 0;
+    uint32_t m_pixelSeed = 0;
+    uint32_t m_sampleIndex = 0;
+    uint32_t m_dimension = 0;
+};
+
+NORI_REGISTER_CLASS(Sobol, "sobol");
+NORI_NAMESPACE_END
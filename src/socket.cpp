@@ -0,0 +1,160 @@
+#include <nori/socket.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#if defined(MSG_NOSIGNAL)
+#  define NORI_SEND_FLAGS MSG_NOSIGNAL
+#else
+#  define NORI_SEND_FLAGS 0
+#endif
+
+NORI_NAMESPACE_BEGIN
+
+/// Upper bound on the message size, which protects against corrupted length prefixes
+#define NORI_MAX_MESSAGE_SIZE (1ull << 32)
+
+Socket &Socket::operator=(Socket &&other) {
+    if (this != &other) {
+        close();
+        m_fd = other.m_fd;
+        other.m_fd = -1;
+    }
+    return *this;
+}
+
+Socket Socket::listen(int port) {
+    Socket result(::socket(AF_INET, SOCK_STREAM, 0));
+    if (!result.isValid())
+        throw NoriException("Socket::listen(): unable to create a socket: %s", strerror(errno));
+
+    int enable = 1;
+    setsockopt(result.m_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t) port);
+
+    if (::bind(result.m_fd, (sockaddr *) &address, sizeof(address)) != 0)
+        throw NoriException("Socket::listen(): unable to bind to port %i: %s", port, strerror(errno));
+    if (::listen(result.m_fd, SOMAXCONN) != 0)
+        throw NoriException("Socket::listen(): %s", strerror(errno));
+    return result;
+}
+
+Socket Socket::connect(const std::string &host, int port) {
+    addrinfo hints, *info = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int rv = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &info);
+    if (rv != 0)
+        throw NoriException("Socket::connect(): unable to resolve \"%s\": %s", host, gai_strerror(rv));
+
+    Socket result;
+    for (addrinfo *ai = info; ai && !result.isValid(); ai = ai->ai_next) {
+        Socket candidate(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+        if (candidate.isValid() && ::connect(candidate.m_fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            result = std::move(candidate);
+    }
+    freeaddrinfo(info);
+
+    if (!result.isValid())
+        throw NoriException("Socket::connect(): unable to connect to %s:%i", host, port);
+
+    /* Messages are small and latency-bound, so send them right away */
+    int enable = 1;
+    setsockopt(result.m_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return result;
+}
+
+Socket Socket::accept(int timeout) {
+    pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int rv = ::poll(&pfd, 1, timeout);
+    if (rv < 0 && errno != EINTR)
+        throw NoriException("Socket::accept(): %s", strerror(errno));
+    if (rv <= 0)
+        return Socket();
+
+    Socket result(::accept(m_fd, nullptr, nullptr));
+    if (!result.isValid())
+        throw NoriException("Socket::accept(): %s", strerror(errno));
+
+    int enable = 1;
+    setsockopt(result.m_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return result;
+}
+
+void Socket::sendMessage(const std::string &message) {
+    uint64_t size = (uint64_t) message.size();
+    send(&size, sizeof(size));
+    send(message.data(), message.size());
+}
+
+std::string Socket::receiveMessage() {
+    uint64_t size;
+    receive(&size, sizeof(size));
+    if (size > NORI_MAX_MESSAGE_SIZE)
+        throw NoriException("Socket::receiveMessage(): invalid message size");
+    std::string message((size_t) size, '\0');
+    receive(&message[0], (size_t) size);
+    return message;
+}
+
+int Socket::getPort() const {
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (getsockname(m_fd, (sockaddr *) &address, &length) != 0)
+        throw NoriException("Socket::getPort(): %s", strerror(errno));
+    return ntohs(address.sin_port);
+}
+
+void Socket::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void Socket::send(const void *data, size_t size) {
+    const char *ptr = (const char *) data;
+    while (size > 0) {
+        ssize_t sent = ::send(m_fd, ptr, size, NORI_SEND_FLAGS);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            throw NoriException("Socket::send(): %s", strerror(errno));
+        ptr += sent;
+        size -= (size_t) sent;
+    }
+}
+
+void Socket::receive(void *data, size_t size) {
+    char *ptr = (char *) data;
+    while (size > 0) {
+        ssize_t received = ::recv(m_fd, ptr, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received == 0)
+            throw NoriException("Socket::receive(): the connection was closed");
+        if (received < 0)
+            throw NoriException("Socket::receive(): %s", strerror(errno));
+        ptr += received;
+        size -= (size_t) received;
+    }
+}
+
+NORI_NAMESPACE_END
@@ -0,0 +1,424 @@
+#include <nori/integrator.h>
+#include <nori/sampler.h>
+#include <nori/emitter.h>
+#include <nori/camera.h>
+#include <nori/bsdf.h>
+#include <nori/scene.h>
+#include <nori/block.h>
+#include <nori/photon.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <pcg32.h>
+#include <atomic>
+
+NORI_NAMESPACE_BEGIN
+
+/**
+ * \brief Stochastic progressive photon mapping (Hachisuka and Jensen 2009)
+ *
+ * Every pass of this progressive integrator consists of
+ * 1. a camera pass, which follows a camera path through every pixel
+ *    until it reaches a diffuse surface. Along the way, it adds emission
+ *    and direct illumination (emitter sampling) to the pixel, and it
+ *    records the diffuse surface interaction as the pixel's visible point.
+ * 2. a photon pass, which traces \c photonsPerPass photon paths and
+ *    accumulates their contributions at all visible points within the
+ *    pixels' radii. The visible points are found through a spatial hash
+ *    grid, and the statistics are accumulated with lock-free atomic adds.
+ * 3. an update of the pixels, which reduces the radius of every pixel
+ *    that received photons based on its own photon count (\c alpha sets
+ *    the fraction of new photons that are kept).
+ *
+ * Memory does not grow with the number of photons, and the estimate
+ * converges to the correct solution as the number of passes (the sample
+ * count of the sampler) increases.
+ */
+class SPPM : public Integrator {
+public:
+    SPPM(const PropertyList &propList) {
+        /* Photon paths per pass (default: one per pixel) */
+        m_photonsPerPass = propList.getInteger("photonsPerPass", -1);
+        /* Initial radius of the pixels (default: derived from the scene size) */
+        m_initialRadius = propList.getFloat("radius", 0.0f);
+        m_alpha = propList.getFloat("alpha", 2.0f / 3.0f);
+        /* Maximum number of bounces of camera and photon paths */
+        m_maxDepth = propList.getInteger("maxDepth", 5);
+        /* Number of bounces before Russian roulette starts on photon paths */
+        m_rrDepth = propList.getInteger("rrDepth", 3);
+        m_seed = (uint32_t) propList.getInteger("seed", 0);
+    }
+
+    bool isProgressive() const { return true; }
+
+    void preprocess(const Scene *scene) {
+        const Camera *camera = scene->getCamera();
+        m_cropOffset = camera->getCropOffset();
+        m_cropSize = camera->getCropSize();
+        size_t pixelCount = (size_t) m_cropSize.x() * m_cropSize.y();
+        if (m_photonsPerPass <= 0)
+            m_photonsPerPass = (int) pixelCount;
+        if (m_initialRadius <= 0)
+            m_initialRadius = scene->getBoundingBox().getExtents().norm() / 100.0f;
+
+        m_pixels.reset(new Pixel[pixelCount]);
+        for (size_t i = 0; i < pixelCount; ++i)
+            m_pixels[i].radius = m_initialRadius;
+
+        /* A visible point overlaps at most 2x2x2 cells, since the cells are
+           at least as large as the diameter of every pixel */
+        m_grid.reset(new std::atomic<GridNode *>[pixelCount]);
+        m_gridNodes.resize(8 * pixelCount);
+
+        /* The camera samplers persist across passes, like the tile samplers
+           of the regular renderer */
+        m_tiles.clear();
+        BlockGenerator blockGenerator(m_cropOffset, m_cropSize, NORI_BLOCK_SIZE);
+        ImageBlock tileBlock(Vector2i(NORI_BLOCK_SIZE), nullptr);
+        while (blockGenerator.next(tileBlock)) {
+            CameraTile tile;
+            tile.offset = tileBlock.getOffset();
+            tile.size = tileBlock.getSize();
+            tile.sampler = scene->getSampler()->clone();
+            tile.sampler->prepare(tileBlock);
+            m_tiles.push_back(std::move(tile));
+        }
+
+        m_emission.reset(new PhotonEmission(scene));
+    }
+
+    Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &ray) const {
+        throw NoriException("SPPM::Li(): this integrator only supports progressive rendering");
+    }
+
+    void renderPass(const Scene *scene, uint32_t pass, ImageBlock &block) {
+        size_t pixelCount = (size_t) m_cropSize.x() * m_cropSize.y();
+
+        /* 1. Camera pass */
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m_tiles.size()),
+            [&](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i != range.end(); ++i) {
+                    CameraTile &tile = m_tiles[i];
+                    for (int y = 0; y < tile.size.y(); ++y) {
+                        for (int x = 0; x < tile.size.x(); ++x) {
+                            Point2i pixel(tile.offset.x() + x, tile.offset.y() + y);
+                            tile.sampler->startPixelSample(pixel, pass);
+                            tracePixel(scene, tile.sampler.get(), pixel, getPixel(pixel));
+                        }
+                    }
+                }
+            });
+
+        /* 2. Photon pass */
+        buildGrid();
+        const size_t batchSize = 4096;
+        size_t batchCount = ((size_t) m_photonsPerPass + batchSize - 1) / batchSize;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, batchCount),
+            [&](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i != range.end(); ++i) {
+                    size_t begin = i * batchSize;
+                    size_t end = std::min(begin + batchSize, (size_t) m_photonsPerPass);
+                    tracePhotons(scene, (uint64_t) pass * batchCount + i, end - begin);
+                }
+            });
+
+        /* 3. Per-pixel radius reduction, and the current estimate of the image */
+        uint32_t passCount = pass + 1;
+        int borderSize = block.getBorderSize();
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, pixelCount),
+            [&](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i != range.end(); ++i) {
+                    Pixel &pixel = m_pixels[i];
+                    int photonCount = pixel.photonCount;
+                    if (photonCount > 0) {
+                        float N = pixel.N + m_alpha * photonCount;
+                        float radius = pixel.radius * std::sqrt(N / (pixel.N + photonCount));
+                        Color3f phi(pixel.phi[0], pixel.phi[1], pixel.phi[2]);
+                        pixel.tau = (pixel.tau + phi) * (radius * radius) / (pixel.radius * pixel.radius);
+                        pixel.N = N;
+                        pixel.radius = radius;
+                        pixel.photonCount = 0;
+                        for (int c = 0; c < 3; ++c)
+                            pixel.phi[c] = 0.0f;
+                    }
+
+                    Color3f value = pixel.Ld / (float) passCount + pixel.tau
+                        / ((float) passCount * m_photonsPerPass * M_PI * pixel.radius * pixel.radius);
+                    if (!value.isValid())
+                        value = Color3f(0.0f);
+
+                    int x = m_cropOffset.x() + (int) (i % m_cropSize.x());
+                    int y = m_cropOffset.y() + (int) (i / m_cropSize.x());
+                    block.coeffRef(borderSize + y, borderSize + x) = Color4f(value);
+                }
+            });
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "SPPM[\n"
+            "  photonsPerPass = %i,\n"
+            "  radius = %f,\n"
+            "  alpha = %f,\n"
+            "  maxDepth = %i\n"
+            "]",
+            m_photonsPerPass, m_initialRadius, m_alpha, m_maxDepth);
+    }
+
+protected:
+    /// Diffuse surface interaction seen through a pixel in the current pass
+    struct VisiblePoint {
+        Intersection its;
+        /// Direction towards the camera (local coordinates)
+        Vector3f wi;
+        /// Throughput of the camera path up to the visible point
+        Color3f beta;
+        bool valid = false;
+    };
+
+    /// Statistics of a pixel
+    struct Pixel {
+        /// Current radius of the density estimate
+        float radius = 0.0f;
+        /// Sum of the directly visible emission and direct illumination over all passes
+        Color3f Ld = Color3f(0.0f);
+        VisiblePoint vp;
+        /// Photon contributions of the current pass (updated by the photon pass)
+        std::atomic<float> phi[3];
+        std::atomic<int> photonCount;
+        /// Accumulated photon count (after radius reduction)
+        float N = 0.0f;
+        /// Accumulated flux within the current radius
+        Color3f tau = Color3f(0.0f);
+
+        Pixel() : photonCount(0) {
+            for (int c = 0; c < 3; ++c)
+                phi[c] = 0.0f;
+        }
+    };
+
+    /// Entry of the list of pixels whose visible point overlaps a grid cell
+    struct GridNode {
+        Pixel *pixel;
+        GridNode *next;
+    };
+
+    /// Block of pixels with the sampler used for its camera paths
+    struct CameraTile {
+        Point2i offset;
+        Vector2i size;
+        std::unique_ptr<Sampler> sampler;
+    };
+
+    Pixel &getPixel(const Point2i &pixel) {
+        return m_pixels[(size_t) (pixel.y() - m_cropOffset.y()) * m_cropSize.x()
+            + (pixel.x() - m_cropOffset.x())];
+    }
+
+    /// Camera pass of a pixel
+    void tracePixel(const Scene *scene, Sampler *sampler, const Point2i &pixel, Pixel &state) const {
+        Point2f pixelSample = Point2f((float) pixel.x(), (float) pixel.y()) + sampler->next2D();
+        Point2f apertureSample = sampler->next2D();
+        Ray3f ray;
+        float time = sampler->next1D();
+        Color3f beta = scene->getCamera()->sampleRay(ray, pixelSample, apertureSample, time);
+
+        state.vp.valid = false;
+        bool specular = true;
+        for (int depth = 0; depth < m_maxDepth; ++depth) {
+            Intersection its;
+            if (!scene->rayIntersect(ray, its)) {
+                if (specular && scene->hasEnvEmitter()) {
+                    EmitterQueryRecord lRec(scene->getEnvEmitter(), ray);
+                    state.Ld += beta * scene->getEnvEmitter()->eval(lRec);
+                }
+                break;
+            }
+
+            /* Emission only counts where emitter sampling cannot find it */
+            if (specular && its.mesh->isEmitter()) {
+                const Emitter *emitter = its.mesh->getEmitter();
+                EmitterQueryRecord lRec(emitter, ray.o, its.p, its.shFrame.n);
+                state.Ld += beta * emitter->eval(lRec);
+            }
+
+            const BSDF *bsdf = its.mesh->getBSDF();
+            Vector3f wi = its.toLocal(-ray.d);
+            state.Ld += beta * direct(scene, sampler, its, wi, time);
+
+            if (bsdf->isDiffuse()) {
+                state.vp.its = its;
+                state.vp.wi = wi;
+                state.vp.beta = beta;
+                state.vp.valid = true;
+                break;
+            }
+
+            BSDFQueryRecord bRec(wi);
+            bRec.uv = its.uv;
+            bRec.p = its.p;
+            beta *= bsdf->sample(bRec, sampler->next2D());
+            specular = bRec.measure == EDiscrete;
+            if ((beta.array() == 0).all())
+                break;
+
+            ray = Ray3f(its.p, its.toWorld(bRec.wo));
+            ray.time = time;
+        }
+    }
+
+    /// Direct illumination using emitter sampling
+    Color3f direct(const Scene *scene, Sampler *sampler, const Intersection &its,
+                   const Vector3f &wi, float time) const {
+        EmitterQueryRecord lRec(its.p);
+        Color3f value = scene->sampleDirect(lRec, sampler->next2D());
+        if ((value.array() == 0).all())
+            return Color3f(0.0f);
+
+        BSDFQueryRecord bRec(wi, its.toLocal(lRec.wi), ESolidAngle);
+        bRec.uv = its.uv;
+        bRec.p = its.p;
+        Color3f f = its.mesh->getBSDF()->eval(bRec) * std::max(0.0f, Frame::cosTheta(bRec.wo));
+        if ((f.array() == 0).all())
+            return Color3f(0.0f);
+
+        Ray3f shadowRay(its.p, lRec.wi, Epsilon, lRec.dist - Epsilon);
+        shadowRay.time = time;
+        return scene->rayIntersect(shadowRay) ? Color3f(0.0f) : value * f;
+    }
+
+    /// Insert the visible points of all pixels into the hash grid
+    void buildGrid() {
+        size_t pixelCount = (size_t) m_cropSize.x() * m_cropSize.y();
+
+        m_gridBounds.reset();
+        float maxRadius = 0.0f;
+        for (size_t i = 0; i < pixelCount; ++i) {
+            const Pixel &pixel = m_pixels[i];
+            if (!pixel.vp.valid)
+                continue;
+            m_gridBounds.expandBy(pixel.vp.its.p - Vector3f(pixel.radius));
+            m_gridBounds.expandBy(pixel.vp.its.p + Vector3f(pixel.radius));
+            maxRadius = std::max(maxRadius, pixel.radius);
+        }
+        m_cellSize = 2 * maxRadius;
+
+        for (size_t i = 0; i < pixelCount; ++i)
+            m_grid[i] = nullptr;
+        std::atomic<size_t> nodeCount(0);
+
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, pixelCount),
+            [&](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i != range.end(); ++i) {
+                    Pixel &pixel = m_pixels[i];
+                    if (!pixel.vp.valid || (pixel.vp.beta.array() == 0).all())
+                        continue;
+
+                    Point3i min = getCell(pixel.vp.its.p - Vector3f(pixel.radius));
+                    Point3i max = getCell(pixel.vp.its.p + Vector3f(pixel.radius));
+                    for (int z = min.z(); z <= max.z(); ++z)
+                        for (int y = min.y(); y <= max.y(); ++y)
+                            for (int x = min.x(); x <= max.x(); ++x) {
+                                GridNode &node = m_gridNodes[nodeCount++];
+                                std::atomic<GridNode *> &head = m_grid[hash(Point3i(x, y, z))];
+                                node.pixel = &pixel;
+                                node.next = head.load(std::memory_order_relaxed);
+                                while (!head.compare_exchange_weak(node.next, &node))
+                                    ;
+                            }
+                }
+            });
+    }
+
+    Point3i getCell(const Point3f &p) const {
+        Vector3f cell = (p - m_gridBounds.min) / m_cellSize;
+        return Point3i((int) std::floor(cell.x()), (int) std::floor(cell.y()), (int) std::floor(cell.z()));
+    }
+
+    size_t hash(const Point3i &cell) const {
+        return (size_t) (((uint32_t) cell.x() * 73856093u) ^ ((uint32_t) cell.y() * 19349663u)
+            ^ ((uint32_t) cell.z() * 83492791u)) % ((size_t) m_cropSize.x() * m_cropSize.y());
+    }
+
+    /// Trace a batch of photon paths and splat them into the visible points
+    void tracePhotons(const Scene *scene, uint64_t batchIndex, size_t count) {
+        pcg32 random;
+        random.seed(batchIndex, m_seed);
+
+        for (size_t i = 0; i < count; ++i) {
+            Ray3f ray;
+            float emitterSample = random.nextFloat();
+            Point2f positionSample(random.nextFloat(), random.nextFloat());
+            Point2f directionSample(random.nextFloat(), random.nextFloat());
+            Color3f power = m_emission->sample(ray, emitterSample, positionSample, directionSample);
+            float time = random.nextFloat();
+            ray.time = time;
+
+            for (int depth = 0; depth < m_maxDepth && (power.array() > 0).any(); ++depth) {
+                Intersection its;
+                if (!scene->rayIntersect(ray, its))
+                    break;
+
+                /* Direct illumination is handled by the camera pass */
+                const BSDF *bsdf = its.mesh->getBSDF();
+                if (depth > 0 && bsdf->isDiffuse() && m_gridBounds.contains(its.p))
+                    splat(its.p, -ray.d, power);
+
+                BSDFQueryRecord bRec(its.toLocal(-ray.d));
+                bRec.uv = its.uv;
+                bRec.p = its.p;
+                Color3f f = bsdf->sample(bRec, Point2f(random.nextFloat(), random.nextFloat()));
+                if (depth >= m_rrDepth) {
+                    float q = std::min(f.maxCoeff(), 0.99f);
+                    if (random.nextFloat() >= q)
+                        break;
+                    f /= q;
+                }
+                power *= f;
+                ray = Ray3f(its.p, its.toWorld(bRec.wo));
+                ray.time = time;
+            }
+        }
+    }
+
+    /// Add a photon to all visible points whose radius contains it
+    void splat(const Point3f &p, const Vector3f &direction, const Color3f &power) {
+        for (GridNode *node = m_grid[hash(getCell(p))]; node; node = node->next) {
+            Pixel &pixel = *node->pixel;
+            const VisiblePoint &vp = pixel.vp;
+            if ((vp.its.p - p).squaredNorm() > pixel.radius * pixel.radius)
+                continue;
+
+            BSDFQueryRecord bRec(vp.wi, vp.its.toLocal(direction), ESolidAngle);
+            bRec.uv = vp.its.uv;
+            bRec.p = vp.its.p;
+            if (Frame::cosTheta(bRec.wo) <= 0)
+                continue;
+            Color3f phi = vp.beta * vp.its.mesh->getBSDF()->eval(bRec) * power;
+            for (int c = 0; c < 3; ++c)
+                atomicAdd(pixel.phi[c], phi[c]);
+            ++pixel.photonCount;
+        }
+    }
+
+    int m_photonsPerPass;
+    float m_initialRadius;
+    float m_alpha;
+    int m_maxDepth;
+    int m_rrDepth;
+    uint32_t m_seed;
+
+    Point2i m_cropOffset;
+    Vector2i m_cropSize;
+    std::unique_ptr<Pixel[]> m_pixels;
+    std::vector<CameraTile> m_tiles;
+    std::unique_ptr<PhotonEmission> m_emission;
+
+    /* Spatial hash grid over the visible points of the current pass */
+    BoundingBox3f m_gridBounds;
+    float m_cellSize = 0.0f;
+    std::unique_ptr<std::atomic<GridNode *>[]> m_grid;
+    std::vector<GridNode> m_gridNodes;
+};
+
+NORI_REGISTER_CLASS(SPPM, "sppm");
+NORI_NAMESPACE_END
@@ -169,7 +169,8 @@ public:
                     Ray3f ray;
                     Point2f pixelSample = (sampler->next2D().array()
                         * camera->getOutputSize().cast<float>().array()).matrix();
-                    Color3f value = camera->sampleRay(ray, pixelSample, sampler->next2D());
+                    Point2f apertureSample = sampler->next2D();
+                    Color3f value = camera->sampleRay(ray, pixelSample, apertureSample, sampler->next1D());
 
                     /* Compute the incident radiance */
                     value *= integrator->Li(scene, sampler, ray);
@@ -0,0 +1,224 @@
+#include <nori/volume.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <cstring>
+#include <cerrno>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+NORI_NAMESPACE_BEGIN
+
+MappedFile::MappedFile(const std::string &filename) {
+#if defined(_WIN32)
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+        throw NoriException("Unable to open \"%s\"", filename);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+        CloseHandle(m_file);
+        throw NoriException("Unable to determine the size of \"%s\"", filename);
+    }
+    m_size = (size_t) size.QuadPart;
+    if (m_size > 0) {
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping)
+            m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!m_data) {
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            throw NoriException("Unable to map \"%s\" into memory", filename);
+        }
+    }
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw NoriException("Unable to open \"%s\": %s", filename, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw NoriException("Unable to determine the size of \"%s\"", filename);
+    }
+    m_size = (size_t) st.st_size;
+    if (m_size > 0) {
+        void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw NoriException("Unable to map \"%s\" into memory: %s", filename, strerror(errno));
+        }
+        m_data = static_cast<const char *>(data);
+    }
+    /* The mapping remains valid after closing the descriptor */
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#if defined(_WIN32)
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+#endif
+}
+
+namespace {
+
+/// Sequential reader for the header of a volume file
+class VolumeHeaderReader {
+public:
+    VolumeHeaderReader(const MappedFile &file, const std::string &filename)
+        : m_file(file), m_filename(filename) { }
+
+    template <typename T> T read() {
+        T value;
+        std::memcpy(&value, skip(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    /// Return a pointer to the next \c size bytes, and skip them
+    const char *skip(size_t size) {
+        if (size > m_file.getSize() - m_offset)
+            throw NoriException("\"%s\": unexpected end of file", m_filename);
+        const char *ptr = m_file.getData() + m_offset;
+        m_offset += size;
+        return ptr;
+    }
+
+    Vector3i readResolution() {
+        Vector3i res;
+        for (int i = 0; i < 3; ++i)
+            res[i] = read<int32_t>();
+        if ((res.array() <= 0).any())
+            throw NoriException("\"%s\": invalid resolution", m_filename);
+        return res;
+    }
+
+    BoundingBox3f readBoundingBox() {
+        Point3f min, max;
+        for (int i = 0; i < 3; ++i)
+            min[i] = read<float>();
+        for (int i = 0; i < 3; ++i)
+            max[i] = read<float>();
+        if (!(min.array() < max.array()).all())
+            throw NoriException("\"%s\": invalid bounding box", m_filename);
+        return BoundingBox3f(min, max);
+    }
+
+private:
+    const MappedFile &m_file;
+    const std::string &m_filename;
+    size_t m_offset = 0;
+};
+
+}
+
+DensityGrid::DensityGrid(const std::string &filename)
+    : m_filename(filename), m_file(new MappedFile(filename)) {
+    VolumeHeaderReader reader(*m_file, filename);
+    const char *magic = reader.skip(4);
+
+    if (std::memcmp(magic, "VOL\x03", 4) == 0) {
+        if (reader.read<int32_t>() != 1)
+            throw NoriException("\"%s\": only float32 volumes are supported", filename);
+        m_res = reader.readResolution();
+        if (reader.read<int32_t>() != 1)
+            throw NoriException("\"%s\": expected a single-channel volume", filename);
+        m_bbox = reader.readBoundingBox();
+        size_t count = (size_t) m_res.x() * m_res.y() * m_res.z();
+        m_voxels = reinterpret_cast<const float *>(reader.skip(count * sizeof(float)));
+    } else if (std::memcmp(magic, "NVB\x01", 4) == 0) {
+        m_res = reader.readResolution();
+        m_brickSize = reader.read<int32_t>();
+        if (m_brickSize <= 0)
+            throw NoriException("\"%s\": invalid brick size", filename);
+        m_bbox = reader.readBoundingBox();
+        int32_t brickCount = reader.read<int32_t>();
+        if (brickCount < 0)
+            throw NoriException("\"%s\": invalid brick count", filename);
+
+        for (int i = 0; i < 3; ++i)
+            m_brickRes[i] = (m_res[i] + m_brickSize - 1) / m_brickSize;
+        size_t indexCount = (size_t) m_brickRes.x() * m_brickRes.y() * m_brickRes.z();
+        m_brickIndex = reinterpret_cast<const int32_t *>(reader.skip(indexCount * sizeof(int32_t)));
+        for (size_t i = 0; i < indexCount; ++i) {
+            if (m_brickIndex[i] < -1 || m_brickIndex[i] >= brickCount)
+                throw NoriException("\"%s\": invalid brick index %i", filename, m_brickIndex[i]);
+        }
+        size_t brickVoxels = (size_t) m_brickSize * m_brickSize * m_brickSize;
+        m_voxels = reinterpret_cast<const float *>(reader.skip(brickCount * brickVoxels * sizeof(float)));
+    } else {
+        throw NoriException("\"%s\": not a volume file", filename);
+    }
+
+    computeMajorants();
+}
+
+void DensityGrid::computeMajorants() {
+    const int size = MajorantCellSize;
+    for (int i = 0; i < 3; ++i)
+        m_cellRes[i] = (m_res[i] + size - 1) / size;
+    m_majorants.resize((size_t) m_cellRes.x() * m_cellRes.y() * m_cellRes.z());
+
+    /* Interpolated densities within a cell depend on the voxels of the
+       cell and on the adjacent layer of voxels around it */
+    tbb::parallel_for(tbb::blocked_range<int>(0, m_cellRes.z()),
+        [&](const tbb::blocked_range<int> &range) {
+            for (int cz = range.begin(); cz != range.end(); ++cz) {
+                for (int cy = 0; cy < m_cellRes.y(); ++cy) {
+                    for (int cx = 0; cx < m_cellRes.x(); ++cx) {
+                        float majorant = 0.f;
+                        for (int z = cz * size - 1; z <= (cz + 1) * size; ++z)
+                            for (int y = cy * size - 1; y <= (cy + 1) * size; ++y)
+                                for (int x = cx * size - 1; x <= (cx + 1) * size; ++x)
+                                    majorant = std::max(majorant, voxel(x, y, z));
+                        m_majorants[((size_t) cz * m_cellRes.y() + cy) * m_cellRes.x() + cx] = majorant;
+                    }
+                }
+            }
+        });
+
+    m_maxDensity = 0.f;
+    for (float majorant : m_majorants)
+        m_maxDensity = std::max(m_maxDensity, majorant);
+}
+
+float DensityGrid::lookup(const Point3f &p) const {
+    /* Voxel centers lie at half-integer coordinates */
+    float fx = p.x() - 0.5f, fy = p.y() - 0.5f, fz = p.z() - 0.5f;
+    int x = (int) std::floor(fx), y = (int) std::floor(fy), z = (int) std::floor(fz);
+    float wx = fx - x, wy = fy - y, wz = fz - z;
+
+    float d00 = (1 - wx) * voxel(x, y, z) + wx * voxel(x + 1, y, z);
+    float d10 = (1 - wx) * voxel(x, y + 1, z) + wx * voxel(x + 1, y + 1, z);
+    float d01 = (1 - wx) * voxel(x, y, z + 1) + wx * voxel(x + 1, y, z + 1);
+    float d11 = (1 - wx) * voxel(x, y + 1, z + 1) + wx * voxel(x + 1, y + 1, z + 1);
+    return (1 - wz) * ((1 - wy) * d00 + wy * d10) + wz * ((1 - wy) * d01 + wy * d11);
+}
+
+std::string DensityGrid::toString() const {
+    return tfm::format(
+        "DensityGrid[\n"
+        "  filename = \"%s\",\n"
+        "  format = %s,\n"
+        "  resolution = %ix%ix%i,\n"
+        "  bbox = %s,\n"
+        "  maxDensity = %f\n"
+        "]",
+        m_filename, m_brickIndex ? tfm::format("bricks of %i^3 voxels", m_brickSize) : "dense",
+        m_res.x(), m_res.y(), m_res.z(), m_bbox.toString(), m_maxDensity);
+}
+
+NORI_NAMESPACE_END
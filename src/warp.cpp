@@ -235,5 +235,45 @@ float Warp::squareToHenyeyGreensteinPdf(const Vector3f& v, float g) {
 	return pdf;
 }
 
+Vector3f Warp::squareToEqualAreaSphere(const Point2f &sample) {
+	float u = 2 * sample.x() - 1, v = 2 * sample.y() - 1;
+	float up = std::abs(u), vp = std::abs(v);
+
+	/* Signed distance from the diagonal that separates the hemispheres */
+	float signedDistance = 1 - (up + vp);
+	float r = 1 - std::abs(signedDistance);
+	float phi = (r == 0 ? 1 : (vp - up) / r + 1) * M_PI / 4;
+
+	float z = std::copysign(1 - r * r, signedDistance);
+	float scale = r * std::sqrt(std::max(0.0f, 2 - r * r));
+	return Vector3f(std::copysign(std::cos(phi), u) * scale,
+		std::copysign(std::sin(phi), v) * scale, z);
+}
+
+Point2f Warp::equalAreaSphereToSquare(const Vector3f &d) {
+	float x = std::abs(d.x()), y = std::abs(d.y()), z = std::abs(d.z());
+	float r = std::sqrt(std::max(0.0f, 1 - z));
+
+	/* Polynomial approximation of atan(b) * 2 / pi on [0, 1] */
+	float a = std::max(x, y), b = std::min(x, y);
+	b = a == 0 ? 0 : b / a;
+	float phi = 0.406758566246788489601959989e-5f + b * (0.636226545274016134946890922156f
+		+ b * (0.61572017898280213493197203466e-2f + b * (-0.247333733281268944196501420480f
+		+ b * (0.881770664775316294736387951347e-1f + b * (0.419038818029165735901852432784e-1f
+		+ b * -0.251390972343483509333252996350e-1f)))));
+	if (x < y)
+		phi = 1 - phi;
+
+	float v = phi * r, u = r - v;
+	if (d.z() < 0) {
+		std::swap(u, v);
+		u = 1 - u;
+		v = 1 - v;
+	}
+	u = std::copysign(u, d.x());
+	v = std::copysign(v, d.y());
+	return Point2f(0.5f * (u + 1), 0.5f * (v + 1));
+}
+
 
 NORI_NAMESPACE_END